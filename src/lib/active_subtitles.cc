@@ -51,9 +51,12 @@ ActiveSubtitles::get_burnt (DCPTime time, bool always_burn_subtitles) const
 			continue;
 		}
 
-		BOOST_FOREACH (Period j, i->second) {
-			if (j.from <= time && (!j.to || j.to.get() > time)) {
-				ps.push_back (j.subs);
+		/* Periods are kept in order of their from time, so we can stop
+		   looking as soon as we reach one which starts after `time'.
+		*/
+		for (list<Period>::const_iterator j = i->second.begin(); j != i->second.end() && j->from <= time; ++j) {
+			if (!j->to || j->to.get() > time) {
+				ps.push_back (j->subs);
 			}
 		}
 	}
@@ -67,19 +70,23 @@ ActiveSubtitles::get_burnt (DCPTime time, bool always_burn_subtitles) const
 void
 ActiveSubtitles::clear_before (DCPTime time)
 {
-	Map updated;
-	for (Map::const_iterator i = _data.begin(); i != _data.end(); ++i) {
-		list<Period> as;
-		BOOST_FOREACH (Period j, i->second) {
-			if (!j.to || j.to.get() >= time) {
-				as.push_back (j);
+	Map::iterator i = _data.begin ();
+	while (i != _data.end()) {
+		list<Period>::iterator j = i->second.begin ();
+		while (j != i->second.end()) {
+			if (j->to && j->to.get() < time) {
+				j = i->second.erase (j);
+			} else {
+				++j;
 			}
 		}
-		if (!as.empty ()) {
-			updated[i->first] = as;
+
+		if (i->second.empty ()) {
+			_data.erase (i++);
+		} else {
+			++i;
 		}
 	}
-	_data = updated;
 }
 
 /** Add a new subtitle with a from time.
@@ -90,10 +97,22 @@ ActiveSubtitles::clear_before (DCPTime time)
 void
 ActiveSubtitles::add_from (weak_ptr<Piece> piece, PlayerSubtitles ps, DCPTime from)
 {
-	if (_data.find(piece) == _data.end()) {
-		_data[piece] = list<Period>();
+	list<Period>& periods = _data[piece];
+
+	/* Keep the list sorted by from time; subtitles almost always arrive in order
+	   so search backwards from the end for the insertion point.
+	*/
+	list<Period>::iterator i = periods.end ();
+	while (i != periods.begin()) {
+		list<Period>::iterator j = i;
+		--j;
+		if (j->from <= from) {
+			break;
+		}
+		i = j;
 	}
-	_data[piece].push_back (Period (ps, from));
+
+	periods.insert (i, Period (ps, from));
 }
 
 /** Add the to time for the last subtitle added from a piece.
@@ -106,13 +125,26 @@ ActiveSubtitles::add_to (weak_ptr<Piece> piece, DCPTime to)
 {
 	DCPOMATIC_ASSERT (_data.find(piece) != _data.end());
 
-	_data[piece].back().to = to;
+	/* Find the latest subtitle from this piece which is still open, or the
+	   last one if they are all closed.
+	*/
+	list<Period>& periods = _data[piece];
+	list<Period>::reverse_iterator p = periods.rbegin ();
+	while (p != periods.rend() && p->to) {
+		++p;
+	}
+
+	if (p == periods.rend()) {
+		p = periods.rbegin ();
+	}
+
+	p->to = to;
 
-	BOOST_FOREACH (SubtitleString& i, _data[piece].back().subs.text) {
+	BOOST_FOREACH (SubtitleString& i, p->subs.text) {
 		i.set_out (dcp::Time(to.seconds(), 1000));
 	}
 
-	return make_pair (_data[piece].back().subs, _data[piece].back().from);
+	return make_pair (p->subs, p->from);
 }
 
 /** @param piece A piece.
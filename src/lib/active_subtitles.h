@@ -59,6 +59,7 @@ private:
 		boost::optional<DCPTime> to;
 	};
 
+	/** Periods for each piece, kept sorted by their from time */
 	typedef std::map<boost::weak_ptr<Piece>, std::list<Period> > Map;
 
 	Map _data;
@@ -29,6 +29,7 @@
 #include "filter.h"
 #include "audio_filter_graph.h"
 #include "config.h"
+#include "exceptions.h"
 extern "C" {
 #include <libavutil/channel_layout.h>
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
@@ -36,7 +37,12 @@ extern "C" {
 #endif
 }
 #include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 #include <iostream>
+#include <cmath>
 
 #include "i18n.h"
 
@@ -46,31 +52,49 @@ using std::max;
 using std::min;
 using std::cout;
 using boost::shared_ptr;
+using boost::optional;
 using boost::dynamic_pointer_cast;
 
+/** Shortest piece of audio, in seconds, that is worth analysing in its own segment */
+#define ANALYSE_AUDIO_MIN_SEGMENT_SECONDS 120
+/** Time, in seconds, that each segment's player starts before the segment so that
+ *  any filtering and resampling has settled by the time we start to analyse.
+ */
+#define ANALYSE_AUDIO_PREROLL_SECONDS 2
+/** Sample level below which we clamp, as we may struggle to serialise and recover
+ *  inf or -inf (this is 140dB down).
+ */
+#define ANALYSE_AUDIO_FLOOR 10e-7f
+
 int const AnalyseAudioJob::_num_points = 1024;
 
+AnalyseAudioJob::Segment::Segment (int channels, Frame from_, optional<Frame> to_)
+	: from (from_)
+	, to (to_)
+	, done (0)
+	, finished (false)
+	, current (channels)
+	, current_sum (channels, 0)
+	, points (channels)
+	, sample_peak (channels, 0)
+	, sample_peak_frame (channels, 0)
+{
+
+}
+
 AnalyseAudioJob::AnalyseAudioJob (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist)
 	: Job (film)
 	, _playlist (playlist)
-	, _done (0)
 	, _samples_per_point (1)
-	, _current (0)
-	, _sample_peak (new float[film->audio_channels()])
-	, _sample_peak_frame (new Frame[film->audio_channels()])
-#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	, _ebur128 (new AudioFilterGraph (film->audio_frame_rate(), film->audio_channels()))
-#endif
+	, _ebur128_in_segment (false)
+	, _ebur128_done (0)
+	, _stop (false)
+	, _progress_from (0)
+	, _progress_to (1)
 {
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
 	_filters.push_back (new Filter ("ebur128", "ebur128", "audio", "ebur128=peak=true"));
-	_ebur128->setup (_filters);
 #endif
-
-	for (int i = 0; i < film->audio_channels(); ++i) {
-		_sample_peak[i] = 0;
-		_sample_peak_frame[i] = 0;
-	}
 }
 
 AnalyseAudioJob::~AnalyseAudioJob ()
@@ -78,9 +102,6 @@ AnalyseAudioJob::~AnalyseAudioJob ()
 	BOOST_FOREACH (Filter const * i, _filters) {
 		delete const_cast<Filter*> (i);
 	}
-	delete[] _current;
-	delete[] _sample_peak;
-	delete[] _sample_peak_frame;
 }
 
 string
@@ -95,43 +116,321 @@ AnalyseAudioJob::json_name () const
 	return N_("analyse_audio");
 }
 
-void
-AnalyseAudioJob::run ()
+shared_ptr<Player>
+AnalyseAudioJob::make_player () const
 {
-	shared_ptr<Player> player (new Player (_film, _playlist));
+	shared_ptr<Player> player (new Player (_film, _analysing));
 	player->set_ignore_video ();
 	player->set_ignore_subtitle ();
 	player->set_fast ();
 	player->set_play_referenced ();
-	player->Audio.connect (bind (&AnalyseAudioJob::analyse, this, _1, _2));
+	return player;
+}
+
+void
+AnalyseAudioJob::run ()
+{
+	if (!compose ()) {
+		analyse_playlist (_playlist, _film->audio_analysis_path (_playlist));
+	}
+
+	set_progress (1);
+	set_state (FINISHED_OK);
+}
+
+/** Try to make the analysis of our playlist from analyses of each of its pieces of content,
+ *  analysing any content that does not already have one.  This is only possible if
+ *  the playlist has more than one piece of audio content and none of them overlap.
+ *
+ *  The result is not exactly what a full analysis would give: each playlist point is
+ *  made from the content points that overlap it, and the integrated loudness is an
+ *  average weighted by duration.  Loudness range cannot be put together like this so
+ *  it is left out.
+ *
+ *  @return true if the analysis was made, false if the whole playlist must be analysed.
+ */
+bool
+AnalyseAudioJob::compose ()
+{
+	ContentList content;
+	optional<DCPTime> last_end;
+	BOOST_FOREACH (shared_ptr<Content> i, _playlist->content ()) {
+		if (!i->audio) {
+			continue;
+		}
+		if (last_end && i->position() < last_end.get()) {
+			/* Overlapping audio would be mixed together, which we can't reproduce here */
+			return false;
+		}
+		last_end = max (last_end.get_value_or (DCPTime ()), i->end ());
+		content.push_back (i);
+	}
+
+	if (content.size() < 2) {
+		return false;
+	}
+
+	int const rate = _film->audio_frame_rate ();
+	int const channels = _film->audio_channels ();
+
+	vector<shared_ptr<AudioAnalysis> > analyses;
+	for (size_t i = 0; i < content.size(); ++i) {
+		shared_ptr<Playlist> playlist (new Playlist);
+		playlist->set_sequence (false);
+		playlist->add (content[i]);
+		boost::filesystem::path const path = _film->audio_analysis_path (playlist);
+
+		shared_ptr<AudioAnalysis> analysis;
+		if (boost::filesystem::exists (path)) {
+			try {
+				analysis.reset (new AudioAnalysis (path));
+			} catch (OldFormatError& e) {
+				/* We'll re-analyse it */
+			} catch (FileError& e) {
+				/* Likewise */
+			}
+		}
+
+		if (!analysis || analysis->channels() != channels) {
+			_progress_from = float (i) / content.size ();
+			_progress_to = float (i + 1) / content.size ();
+			analyse_playlist (playlist, path);
+			analysis.reset (new AudioAnalysis (path));
+		}
+
+		analyses.push_back (analysis);
+	}
 
+	_progress_from = 0;
+	_progress_to = 1;
+
+	/* Work out the points in the same way as analyse() would */
 	DCPTime const start = _playlist->start().get_value_or (DCPTime ());
-	DCPTime const length = _playlist->length ();
+	Frame const len = DCPTime (_playlist->length() - start).frames_round (rate);
+	int64_t const samples_per_point = max (int64_t (1), len / _num_points);
+	int64_t const points = len > 0 ? ((len - 1) / samples_per_point + 1) : 0;
+
+	/* Sum of squares and peak for each channel and point */
+	vector<vector<double> > sum (channels, vector<double> (points, 0));
+	vector<vector<float> > peak (channels, vector<float> (points, ANALYSE_AUDIO_FLOOR));
+
+	vector<float> sample_peak (channels, 0);
+	vector<DCPTime> sample_peak_time (channels);
+	vector<float> true_peak (channels, 0);
+	bool have_true_peak = true;
+	double loudness_sum = 0;
+	double loudness_duration = 0;
+	bool have_loudness = true;
+
+	for (size_t i = 0; i < content.size(); ++i) {
+		shared_ptr<AudioAnalysis> analysis = analyses[i];
+		/* Correct for any change in gain since the content was analysed */
+		float const gain_dB = content[i]->audio->gain() - analysis->analysis_gain().get_value_or (content[i]->audio->gain ());
+		float const gain = pow (10, gain_dB / 20);
+
+		Frame const offset = DCPTime (content[i]->position() - start).frames_round (rate);
+		Frame const content_len = DCPTime (content[i]->end() - content[i]->position()).frames_round (rate);
+		int64_t const content_samples_per_point = max (int64_t (1), content_len / _num_points);
+
+		for (int j = 0; j < channels; ++j) {
+			for (int k = 0; k < analysis->points (j); ++k) {
+				AudioPoint p = analysis->get_point (j, k);
+				/* Frames that this point covers; the first point is just the first frame */
+				Frame const from = offset + (k == 0 ? 0 : ((k - 1) * content_samples_per_point + 1));
+				Frame const to = offset + k * content_samples_per_point;
+				/* Range of our points that these frames are in */
+				int64_t const first = min (points - 1, from == 0 ? 0 : (from + samples_per_point - 1) / samples_per_point);
+				int64_t const last = min (points - 1, to == 0 ? 0 : (to + samples_per_point - 1) / samples_per_point);
+				for (int64_t l = max (int64_t (0), first); l <= last; ++l) {
+					Frame const point_from = l == 0 ? 0 : ((l - 1) * samples_per_point + 1);
+					Frame const point_to = l * samples_per_point;
+					Frame const overlap = min (to, point_to) - max (from, point_from) + 1;
+					if (overlap > 0) {
+						sum[j][l] += pow (p[AudioPoint::RMS] * gain, 2) * overlap;
+						peak[j][l] = max (peak[j][l], p[AudioPoint::PEAK] * gain);
+					}
+				}
+			}
+
+			AudioAnalysis::PeakTime const pt = analysis->sample_peak().at (j);
+			if (pt.peak * gain > sample_peak[j]) {
+				sample_peak[j] = pt.peak * gain;
+				sample_peak_time[j] = content[i]->position() - start + pt.time;
+			}
+		}
+
+		if (analysis->true_peak().size() == size_t (channels)) {
+			for (int j = 0; j < channels; ++j) {
+				true_peak[j] = max (true_peak[j], analysis->true_peak()[j] * gain);
+			}
+		} else {
+			have_true_peak = false;
+		}
+
+		if (analysis->integrated_loudness ()) {
+			double const duration = DCPTime(content[i]->end() - content[i]->position()).seconds ();
+			loudness_sum += pow (10, (analysis->integrated_loudness().get() + gain_dB) / 10) * duration;
+			loudness_duration += duration;
+		} else {
+			have_loudness = false;
+		}
+	}
+
+	_analysis.reset (new AudioAnalysis (channels));
+	for (int i = 0; i < channels; ++i) {
+		for (int64_t j = 0; j < points; ++j) {
+			AudioPoint p;
+			p[AudioPoint::PEAK] = peak[i][j];
+			p[AudioPoint::RMS] = max (float (sqrt (sum[i][j] / samples_per_point)), ANALYSE_AUDIO_FLOOR);
+			_analysis->add_point (i, p);
+		}
+	}
+
+	vector<AudioAnalysis::PeakTime> sample_peaks;
+	for (int i = 0; i < channels; ++i) {
+		sample_peaks.push_back (AudioAnalysis::PeakTime (sample_peak[i], sample_peak_time[i]));
+	}
+	_analysis->set_sample_peak (sample_peaks);
+
+	if (have_true_peak) {
+		_analysis->set_true_peak (true_peak);
+	}
+
+	if (have_loudness && loudness_duration > 0) {
+		_analysis->set_integrated_loudness (10 * log10 (loudness_sum / loudness_duration));
+	}
+
+	_analysis->write (_film->audio_analysis_path (_playlist));
+	return true;
+}
+
+/** Set our progress through the analysis that we are currently doing */
+void
+AnalyseAudioJob::set_analysis_progress (float p)
+{
+	set_progress (_progress_from + p * (_progress_to - _progress_from));
+}
+
+/** Analyse a playlist by running its audio through some players, writing the results to a file */
+void
+AnalyseAudioJob::analyse_playlist (shared_ptr<const Playlist> playlist, boost::filesystem::path output)
+{
+	_analysing = playlist;
+	_ebur128_in_segment = false;
+	_start = playlist->start().get_value_or (DCPTime ());
+	DCPTime const length = playlist->length ();
+
+	int const rate = _film->audio_frame_rate ();
+	int const channels = _film->audio_channels ();
 
-	Frame const len = DCPTime (length - start).frames_round (_film->audio_frame_rate());
+	Frame const len = DCPTime (length - _start).frames_round (rate);
 	_samples_per_point = max (int64_t (1), len / _num_points);
 
-	delete[] _current;
-	_current = new AudioPoint[_film->audio_channels ()];
-	_analysis.reset (new AudioAnalysis (_film->audio_channels ()));
+	_analysis.reset (new AudioAnalysis (channels));
 
 	bool has_any_audio = false;
-	BOOST_FOREACH (shared_ptr<Content> c, _playlist->content ()) {
+	BOOST_FOREACH (shared_ptr<Content> c, playlist->content ()) {
 		if (c->audio) {
 			has_any_audio = true;
 		}
 	}
 
+	/* Split into segments, each of which starts just after a point is finished */
+	int const cores = max (1U, boost::thread::hardware_concurrency ());
+	int const N = max (int64_t (1), min (int64_t (cores), len / (ANALYSE_AUDIO_MIN_SEGMENT_SECONDS * rate)));
+	int64_t const points_per_segment = (len / _samples_per_point + N) / N;
+
+	_segments.clear ();
+	for (int i = 0; i < N; ++i) {
+		Frame const from = i == 0 ? 0 : (i * points_per_segment * _samples_per_point + 1);
+		optional<Frame> to;
+		if (i < (N - 1)) {
+			to = (i + 1) * points_per_segment * _samples_per_point + 1;
+		}
+		_segments.push_back (shared_ptr<Segment> (new Segment (channels, from, to)));
+	}
+
+	bool do_ebur128 = false;
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+	do_ebur128 = Config::instance()->analyse_ebur128 ();
+	_ebur128.reset (new AudioFilterGraph (_film->audio_frame_rate(), _film->audio_channels()));
+	_ebur128->setup (_filters);
+	_ebur128_done = 0;
+#endif
+
 	if (has_any_audio) {
-		_done = 0;
-		while (!player->pass ()) {}
+		if (_segments.size() == 1) {
+			/* Just do everything here, including EBU R128 */
+			_ebur128_in_segment = do_ebur128;
+			analyse_segment (_segments.front().get());
+		} else {
+			boost::thread_group threads;
+			BOOST_FOREACH (shared_ptr<Segment> i, _segments) {
+				threads.create_thread (boost::bind (&AnalyseAudioJob::analyse_segment, this, i.get()));
+			}
+			/* EBU R128 measurement must see all the audio in order, so it gets its own pass */
+			if (do_ebur128) {
+				threads.create_thread (boost::bind (&AnalyseAudioJob::analyse_ebur128, this));
+			}
+
+			try {
+				while (true) {
+					Frame done = 0;
+					bool all_finished = true;
+					{
+						boost::mutex::scoped_lock lm (_mutex);
+						BOOST_FOREACH (shared_ptr<Segment> i, _segments) {
+							done += i->done;
+							all_finished = all_finished && i->finished;
+						}
+						if (do_ebur128) {
+							done = (done + _ebur128_done) / 2;
+						}
+					}
+
+					if (all_finished) {
+						break;
+					}
+
+					set_analysis_progress (len > 0 ? float (done) / len : 0);
+					boost::this_thread::sleep (boost::posix_time::milliseconds (250));
+				}
+			} catch (...) {
+				/* Probably we have been cancelled */
+				{
+					boost::mutex::scoped_lock lm (_mutex);
+					_stop = true;
+				}
+				threads.join_all ();
+				throw;
+			}
+
+			threads.join_all ();
+		}
+
+		rethrow ();
+	}
+
+	/* Put the segments' results together */
+
+	vector<float> peak (channels, 0);
+	vector<Frame> peak_frame (channels, 0);
+	BOOST_FOREACH (shared_ptr<Segment> i, _segments) {
+		for (int j = 0; j < channels; ++j) {
+			BOOST_FOREACH (AudioPoint const & k, i->points[j]) {
+				_analysis->add_point (j, k);
+			}
+			/* Strictly greater so that we get the first of equal peaks, as a single pass would */
+			if (i->sample_peak[j] > peak[j]) {
+				peak[j] = i->sample_peak[j];
+				peak_frame[j] = i->sample_peak_frame[j];
+			}
+		}
 	}
 
 	vector<AudioAnalysis::PeakTime> sample_peak;
-	for (int i = 0; i < _film->audio_channels(); ++i) {
-		sample_peak.push_back (
-			AudioAnalysis::PeakTime (_sample_peak[i], DCPTime::from_frames (_sample_peak_frame[i], _film->audio_frame_rate ()))
-			);
+	for (int i = 0; i < channels; ++i) {
+		sample_peak.push_back (AudioAnalysis::PeakTime (peak[i], DCPTime::from_frames (peak_frame[i], rate)));
 	}
 	_analysis->set_sample_peak (sample_peak);
 
@@ -148,62 +447,204 @@ AnalyseAudioJob::run ()
 	}
 #endif
 
-	if (_playlist->content().size() == 1) {
+	if (playlist->content().size() == 1) {
 		/* If there was only one piece of content in this analysis we may later need to know what its
 		   gain was when we analysed it.
 		*/
-		shared_ptr<const AudioContent> ac = _playlist->content().front()->audio;
+		shared_ptr<const AudioContent> ac = playlist->content().front()->audio;
 		DCPOMATIC_ASSERT (ac);
 		_analysis->set_analysis_gain (ac->gain ());
 	}
 
-	_analysis->write (_film->audio_analysis_path (_playlist));
+	_analysis->write (output);
+}
 
-	set_progress (1);
-	set_state (FINISHED_OK);
+/** Analyse one segment of the playlist with its own player; this may be run in any thread */
+void
+AnalyseAudioJob::analyse_segment (Segment* segment)
+try
+{
+	shared_ptr<Player> player = make_player ();
+	player->Audio.connect (bind (&AnalyseAudioJob::analyse, this, segment, _1, _2));
+
+	if (segment->from > 0) {
+		Frame const preroll = ANALYSE_AUDIO_PREROLL_SECONDS * _film->audio_frame_rate ();
+		player->seek (_start + DCPTime::from_frames (max (Frame (0), segment->from - preroll), _film->audio_frame_rate ()), true);
+	}
+
+	while (true) {
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_stop || segment->finished) {
+				break;
+			}
+		}
+
+		if (player->pass ()) {
+			break;
+		}
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	segment->finished = true;
+}
+catch (...)
+{
+	store_current ();
+	boost::mutex::scoped_lock lm (_mutex);
+	segment->finished = true;
+}
+
+/** Run all the playlist's audio through the EBU R128 filter in order; this may be run in any thread */
+void
+AnalyseAudioJob::analyse_ebur128 ()
+try
+{
+	shared_ptr<Player> player = make_player ();
+	player->Audio.connect (bind (&AnalyseAudioJob::ebur128, this, _1, _2));
+
+	while (true) {
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_stop) {
+				break;
+			}
+		}
+
+		if (player->pass ()) {
+			break;
+		}
+	}
+}
+catch (...)
+{
+	store_current ();
 }
 
 void
-AnalyseAudioJob::analyse (shared_ptr<const AudioBuffers> b, DCPTime time)
+AnalyseAudioJob::ebur128 (shared_ptr<const AudioBuffers> b, DCPTime)
 {
 #ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
-	if (Config::instance()->analyse_ebur128 ()) {
-		_ebur128->process (b);
+	_ebur128->process (b);
+#endif
+	boost::mutex::scoped_lock lm (_mutex);
+	_ebur128_done += b->frames ();
+}
+
+/** Find the peak level and the sum of squares of some samples, after clamping
+ *  their absolute values to ANALYSE_AUDIO_FLOOR.
+ *  @param sum Sum of squares to add to.
+ *  @return Peak absolute sample value.
+ */
+static float
+peak_and_sum_of_squares (float const * data, int n, double& sum)
+{
+	float peak = 0;
+	int i = 0;
+
+#ifdef __SSE__
+	__m128 const sign = _mm_set1_ps (-0.0f);
+	__m128 const floor = _mm_set1_ps (ANALYSE_AUDIO_FLOOR);
+	__m128 peak4 = _mm_setzero_ps ();
+	float p[4];
+	float s[4];
+
+	while ((i + 4) <= n) {
+		/* Move the float sums into our double one every so often to keep their precision */
+		int const block_end = min (n & ~3, i + 4096);
+		__m128 sum4 = _mm_setzero_ps ();
+		for (; i < block_end; i += 4) {
+			__m128 const a = _mm_max_ps (_mm_andnot_ps (sign, _mm_loadu_ps (data + i)), floor);
+			peak4 = _mm_max_ps (peak4, a);
+			sum4 = _mm_add_ps (sum4, _mm_mul_ps (a, a));
+		}
+		_mm_storeu_ps (s, sum4);
+		sum += double (s[0]) + s[1] + s[2] + s[3];
+	}
+
+	_mm_storeu_ps (p, peak4);
+	peak = max (max (p[0], p[1]), max (p[2], p[3]));
+#endif
+
+	for (; i < n; ++i) {
+		float const a = max (fabsf (data[i]), ANALYSE_AUDIO_FLOOR);
+		peak = max (peak, a);
+		sum += a * a;
 	}
+
+	return peak;
+}
+
+void
+AnalyseAudioJob::analyse (Segment* segment, shared_ptr<const AudioBuffers> b, DCPTime time)
+{
+	if (_ebur128_in_segment) {
+#ifdef DCPOMATIC_HAVE_EBUR128_PATCHED_FFMPEG
+		_ebur128->process (b);
 #endif
+	}
 
+	if (!segment->position) {
+		segment->position = DCPTime(time - _start).frames_round (_film->audio_frame_rate ());
+	}
+
+	Frame const position = segment->position.get ();
 	int const frames = b->frames ();
 	int const channels = b->channels ();
 
+	/* Range of frames in b that are in this segment */
+	int const start = min (Frame (frames), max (Frame (0), segment->from - position));
+	int end = frames;
+	if (segment->to) {
+		end = max (Frame (start), min (Frame (frames), segment->to.get() - position));
+	}
+
 	for (int j = 0; j < channels; ++j) {
 		float* data = b->data(j);
-		for (int i = 0; i < frames; ++i) {
-			float s = data[i];
-			float as = fabsf (s);
-			if (as < 10e-7) {
-				/* We may struggle to serialise and recover inf or -inf, so prevent such
-				   values by replacing with this (140dB down) */
-				s = as = 10e-7;
+		AudioPoint& current = segment->current[j];
+		int i = start;
+		while (i < end) {
+			/* Work up to and including the next frame at which a point is finished */
+			Frame const frame = position + i;
+			Frame const remainder = frame % _samples_per_point;
+			Frame const to_boundary = remainder == 0 ? 0 : (_samples_per_point - remainder);
+			int const n = min (Frame (end - i), to_boundary + 1);
+
+			float const peak = peak_and_sum_of_squares (data + i, n, segment->current_sum[j]);
+			current[AudioPoint::PEAK] = max (current[AudioPoint::PEAK], peak);
+
+			if (peak > segment->sample_peak[j]) {
+				/* Find where this peak first happened */
+				int k = 0;
+				while (k < (n - 1) && max (fabsf (data[i + k]), ANALYSE_AUDIO_FLOOR) != peak) {
+					++k;
+				}
+				segment->sample_peak[j] = peak;
+				segment->sample_peak_frame[j] = frame + k;
 			}
-			_current[j][AudioPoint::RMS] += pow (s, 2);
-			_current[j][AudioPoint::PEAK] = max (_current[j][AudioPoint::PEAK], as);
 
-			if (as > _sample_peak[j]) {
-				_sample_peak[j] = as;
-				_sample_peak_frame[j] = _done + i;
+			if (((frame + n - 1) % _samples_per_point) == 0) {
+				current[AudioPoint::RMS] = sqrt (segment->current_sum[j] / _samples_per_point);
+				segment->points[j].push_back (current);
+				current = AudioPoint ();
+				segment->current_sum[j] = 0;
 			}
 
-			if (((_done + i) % _samples_per_point) == 0) {
-				_current[j][AudioPoint::RMS] = sqrt (_current[j][AudioPoint::RMS] / _samples_per_point);
-				_analysis->add_point (j, _current[j]);
-				_current[j] = AudioPoint ();
-			}
+			i += n;
 		}
 	}
 
-	_done += frames;
+	segment->position = position + frames;
 
-	DCPTime const start = _playlist->start().get_value_or (DCPTime ());
-	DCPTime const length = _playlist->length ();
-	set_progress ((time.seconds() - start.seconds()) / (length.seconds() - start.seconds()));
+	boost::mutex::scoped_lock lm (_mutex);
+	segment->done = max (Frame (0), min (segment->position.get(), segment->to.get_value_or (segment->position.get())) - segment->from);
+	if (segment->to && segment->position.get() >= segment->to.get()) {
+		segment->finished = true;
+	}
+
+	if (_segments.size() == 1) {
+		lm.unlock ();
+		DCPTime const length = _analysing->length ();
+		set_analysis_progress ((time.seconds() - _start.seconds()) / (length.seconds() - _start.seconds()));
+	}
 }
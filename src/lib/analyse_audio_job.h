@@ -26,10 +26,15 @@
 #include "audio_point.h"
 #include "types.h"
 #include "dcpomatic_time.h"
+#include "exception_store.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
 
 class AudioBuffers;
 class AudioAnalysis;
 class Playlist;
+class Player;
 class AudioPoint;
 class AudioFilterGraph;
 class Filter;
@@ -40,8 +45,16 @@ class Filter;
  *
  *  After computing the peak and RMS levels the job will write a file
  *  to Film::audio_analysis_path.
+ *
+ *  Playlists of several pieces of content which do not overlap are analysed
+ *  by putting together analyses of each piece, so only content which has
+ *  changed needs to be looked at again.
+ *
+ *  Long playlists are split into segments which are analysed in parallel
+ *  by separate players; the segment boundaries are placed at the boundaries
+ *  of points, so that the results are the same as from a single pass.
  */
-class AnalyseAudioJob : public Job
+class AnalyseAudioJob : public Job, public ExceptionStore
 {
 public:
 	AnalyseAudioJob (boost::shared_ptr<const Film>, boost::shared_ptr<const Playlist>);
@@ -56,16 +69,59 @@ public:
 	}
 
 private:
-	void analyse (boost::shared_ptr<const AudioBuffers>, DCPTime time);
+	friend struct analyse_audio_compose_test;
+
+	/** A part of the playlist which is analysed on its own */
+	class Segment
+	{
+	public:
+		Segment (int channels, Frame from_, boost::optional<Frame> to_);
+
+		/** First frame to analyse, counted from the start of the playlist */
+		Frame from;
+		/** Frame after the last one to analyse, or empty to carry on to the end of the playlist */
+		boost::optional<Frame> to;
+		/** Index of the next frame that we will be given, once we know it */
+		boost::optional<Frame> position;
+		/** Number of frames analysed so far */
+		Frame done;
+		bool finished;
+
+		/** Point currently being built for each channel */
+		std::vector<AudioPoint> current;
+		/** Sum of squares of samples in the current point for each channel */
+		std::vector<double> current_sum;
+		/** Finished points for each channel */
+		std::vector<std::vector<AudioPoint> > points;
+		std::vector<float> sample_peak;
+		std::vector<Frame> sample_peak_frame;
+	};
+
+	bool compose ();
+	void analyse_playlist (boost::shared_ptr<const Playlist> playlist, boost::filesystem::path output);
+	void set_analysis_progress (float p);
+	boost::shared_ptr<Player> make_player () const;
+	void analyse (Segment* segment, boost::shared_ptr<const AudioBuffers>, DCPTime time);
+	void analyse_segment (Segment* segment);
+	void analyse_ebur128 ();
+	void ebur128 (boost::shared_ptr<const AudioBuffers>, DCPTime time);
 
 	boost::shared_ptr<const Playlist> _playlist;
+	/** Playlist that we are currently analysing; either _playlist or a single piece of its content */
+	boost::shared_ptr<const Playlist> _analysing;
+	/** Range of our progress that the current analysis covers */
+	float _progress_from;
+	float _progress_to;
 
-	int64_t _done;
+	DCPTime _start;
 	int64_t _samples_per_point;
-	AudioPoint* _current;
+	bool _ebur128_in_segment;
 
-	float* _sample_peak;
-	Frame* _sample_peak_frame;
+	/** Mutex for the progress of each segment and the EBU R128 pass, and _stop */
+	mutable boost::mutex _mutex;
+	std::vector<boost::shared_ptr<Segment> > _segments;
+	Frame _ebur128_done;
+	bool _stop;
 
 	boost::shared_ptr<AudioAnalysis> _analysis;
 
@@ -23,6 +23,7 @@
 #include "util.h"
 #include "playlist.h"
 #include "audio_content.h"
+#include "exceptions.h"
 #include <dcp/raw_convert.h>
 #include <libxml++/libxml++.h>
 #include <boost/filesystem.hpp>
@@ -32,6 +33,8 @@
 #include <cstdio>
 #include <iostream>
 #include <inttypes.h>
+#include <cerrno>
+#include <cstring>
 
 using std::ostream;
 using std::istream;
@@ -47,7 +50,37 @@ using boost::optional;
 using boost::dynamic_pointer_cast;
 using dcp::raw_convert;
 
-int const AudioAnalysis::_current_state_version = 2;
+int const AudioAnalysis::_current_state_version = 3;
+
+/* Binary format (version 3 onwards), all in the writing machine's byte order:
+ *
+ *   8 bytes   magic, DCPOMAAN
+ *   uint32    0x01020304, to check byte order
+ *   uint32    version
+ *   uint32    channels
+ *   uint32    flags (AUDIO_ANALYSIS_HAS_*)
+ *   float     integrated loudness
+ *   float     loudness range
+ *   double    analysis gain
+ *   uint32    number of sample peaks (S)
+ *   uint32    number of true peaks (T)
+ *   uint32    number of points for each channel
+ *   padding to 8 bytes
+ *   int64     sample peak times (S)
+ *   float     sample peaks (S)
+ *   float     true peaks (T)
+ *   padding to 8 bytes
+ *   then for each channel:
+ *     float   peak for each point
+ *     float   RMS for each point
+ *
+ * so the point data can be used directly from a memory-mapped file.
+ */
+static char const audio_analysis_magic[] = "DCPOMAAN";
+static uint32_t const audio_analysis_byte_order = 0x01020304;
+#define AUDIO_ANALYSIS_HAS_INTEGRATED_LOUDNESS 0x1
+#define AUDIO_ANALYSIS_HAS_LOUDNESS_RANGE      0x2
+#define AUDIO_ANALYSIS_HAS_ANALYSIS_GAIN       0x4
 
 AudioAnalysis::AudioAnalysis (int channels)
 {
@@ -55,11 +88,31 @@ AudioAnalysis::AudioAnalysis (int channels)
 }
 
 AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
+{
+	FILE* f = fopen_boost (filename, "rb");
+	if (!f) {
+		throw OpenFileError (filename, errno, true);
+	}
+
+	char magic[8];
+	size_t const N = fread (magic, 1, sizeof (magic), f);
+	fclose (f);
+
+	if (N == sizeof (magic) && memcmp (magic, audio_analysis_magic, sizeof (magic)) == 0) {
+		read_binary (filename);
+	} else {
+		read_xml (filename);
+	}
+}
+
+/** Read an analysis in the XML format that was used up to version 2 */
+void
+AudioAnalysis::read_xml (boost::filesystem::path filename)
 {
 	cxml::Document f ("AudioAnalysis");
 	f.read_file (filename);
 
-	if (f.optional_number_child<int>("Version").get_value_or(1) < _current_state_version) {
+	if (f.optional_number_child<int>("Version").get_value_or(1) < 2) {
 		/* Too old.  Throw an exception so that this analysis is re-run. */
 		throw OldFormatError ("Audio analysis file is too old");
 	}
@@ -92,6 +145,131 @@ AudioAnalysis::AudioAnalysis (boost::filesystem::path filename)
 	_analysis_gain = f.optional_number_child<double> ("AnalysisGain");
 }
 
+/** Helper to take values out of a binary analysis file.  Running off the end of the
+ *  data throws OldFormatError, so that a truncated file is analysed again.
+ */
+class AudioAnalysisReader
+{
+public:
+	explicit AudioAnalysisReader (vector<uint8_t> const & data)
+		: _data (data)
+		, _offset (0)
+	{}
+
+	template <class T>
+	T get ()
+	{
+		T v;
+		get (&v, 1);
+		return v;
+	}
+
+	template <class T>
+	void get (T* v, size_t n)
+	{
+		if ((_offset + n * sizeof (T)) > _data.size()) {
+			throw OldFormatError ("Audio analysis file is truncated");
+		}
+		if (n > 0) {
+			memcpy (v, &_data[_offset], n * sizeof (T));
+		}
+		_offset += n * sizeof (T);
+	}
+
+	void align ()
+	{
+		_offset = (_offset + 7) & ~7;
+	}
+
+private:
+	vector<uint8_t> const & _data;
+	size_t _offset;
+};
+
+void
+AudioAnalysis::read_binary (boost::filesystem::path filename)
+{
+	/* These files are small (8 bytes per point per channel) so it is quickest just to read it all */
+	vector<uint8_t> data (boost::filesystem::file_size (filename));
+
+	FILE* f = fopen_boost (filename, "rb");
+	if (!f) {
+		throw OpenFileError (filename, errno, true);
+	}
+	size_t const N = data.empty() ? 0 : fread (&data[0], 1, data.size(), f);
+	fclose (f);
+	if (N != data.size ()) {
+		throw ReadFileError (filename, errno);
+	}
+
+	AudioAnalysisReader reader (data);
+
+	char magic[8];
+	reader.get (magic, 8);
+
+	if (reader.get<uint32_t>() != audio_analysis_byte_order || reader.get<uint32_t>() != uint32_t (_current_state_version)) {
+		/* Written on a machine with a different byte order, or by a different version; re-run it */
+		throw OldFormatError ("Audio analysis file is in an unknown format");
+	}
+
+	uint32_t const channels = reader.get<uint32_t> ();
+	uint32_t const flags = reader.get<uint32_t> ();
+	float const integrated_loudness = reader.get<float> ();
+	float const loudness_range = reader.get<float> ();
+	double const analysis_gain = reader.get<double> ();
+	uint32_t const sample_peaks = reader.get<uint32_t> ();
+	uint32_t const true_peaks = reader.get<uint32_t> ();
+
+	if (flags & AUDIO_ANALYSIS_HAS_INTEGRATED_LOUDNESS) {
+		_integrated_loudness = integrated_loudness;
+	}
+	if (flags & AUDIO_ANALYSIS_HAS_LOUDNESS_RANGE) {
+		_loudness_range = loudness_range;
+	}
+	if (flags & AUDIO_ANALYSIS_HAS_ANALYSIS_GAIN) {
+		_analysis_gain = analysis_gain;
+	}
+
+	/* Check sizes before we allocate anything based on them */
+	if (channels > data.size() || sample_peaks > data.size() || true_peaks > data.size()) {
+		throw OldFormatError ("Audio analysis file is corrupt");
+	}
+
+	vector<uint32_t> points (channels);
+	reader.get (points.empty() ? 0 : &points[0], channels);
+	reader.align ();
+
+	vector<int64_t> sample_peak_times (sample_peaks);
+	vector<float> sample_peak_values (sample_peaks);
+	reader.get (sample_peak_times.empty() ? 0 : &sample_peak_times[0], sample_peaks);
+	reader.get (sample_peak_values.empty() ? 0 : &sample_peak_values[0], sample_peaks);
+	for (uint32_t i = 0; i < sample_peaks; ++i) {
+		_sample_peak.push_back (PeakTime (sample_peak_values[i], DCPTime (sample_peak_times[i])));
+	}
+
+	_true_peak.resize (true_peaks);
+	reader.get (_true_peak.empty() ? 0 : &_true_peak[0], true_peaks);
+	reader.align ();
+
+	_data.resize (channels);
+	vector<float> peak;
+	vector<float> rms;
+	for (uint32_t i = 0; i < channels; ++i) {
+		if (points[i] > data.size()) {
+			throw OldFormatError ("Audio analysis file is corrupt");
+		}
+		peak.resize (points[i]);
+		rms.resize (points[i]);
+		reader.get (peak.empty() ? 0 : &peak[0], points[i]);
+		reader.get (rms.empty() ? 0 : &rms[0], points[i]);
+		_data[i].resize (points[i]);
+		for (uint32_t j = 0; j < points[i]; ++j) {
+			_data[i][j][AudioPoint::PEAK] = peak[j];
+			_data[i][j][AudioPoint::RMS] = rms[j];
+		}
+	}
+}
+
 void
 AudioAnalysis::add_point (int c, AudioPoint const & p)
 {
@@ -119,44 +297,124 @@ AudioAnalysis::points (int c) const
 	return _data[c].size ();
 }
 
-void
-AudioAnalysis::write (boost::filesystem::path filename)
+/** Helper to write a binary analysis file */
+class AudioAnalysisWriter
 {
-	shared_ptr<xmlpp::Document> doc (new xmlpp::Document);
-	xmlpp::Element* root = doc->create_root_node ("AudioAnalysis");
+public:
+	AudioAnalysisWriter (boost::filesystem::path file)
+		: _file (file)
+		, _offset (0)
+	{
+		_f = fopen_boost (file, "wb");
+		if (!_f) {
+			throw OpenFileError (file, errno, false);
+		}
+	}
 
-	root->add_child("Version")->add_child_text (raw_convert<string> (_current_state_version));
+	~AudioAnalysisWriter ()
+	{
+		if (_f) {
+			fclose (_f);
+		}
+	}
 
-	BOOST_FOREACH (vector<AudioPoint>& i, _data) {
-		xmlpp::Element* channel = root->add_child ("Channel");
-		BOOST_FOREACH (AudioPoint& j, i) {
-			j.as_xml (channel->add_child ("Point"));
+	template <class T>
+	void put (T v)
+	{
+		put (&v, 1);
+	}
+
+	template <class T>
+	void put (T const * v, size_t n)
+	{
+		if (n > 0 && fwrite (v, sizeof (T), n, _f) != n) {
+			throw WriteFileError (_file, errno);
 		}
+		_offset += n * sizeof (T);
 	}
 
-	for (size_t i = 0; i < _sample_peak.size(); ++i) {
-		xmlpp::Element* n = root->add_child("SamplePeak");
-		n->add_child_text (raw_convert<string> (_sample_peak[i].peak));
-		n->set_attribute ("Time", raw_convert<string> (_sample_peak[i].time.get()));
+	void align ()
+	{
+		while (_offset % 8) {
+			put<uint8_t> (0);
+		}
 	}
 
-	BOOST_FOREACH (float i, _true_peak) {
-		root->add_child("TruePeak")->add_child_text (raw_convert<string> (i));
+	void close ()
+	{
+		int const r = fclose (_f);
+		_f = 0;
+		if (r != 0) {
+			throw WriteFileError (_file, errno);
+		}
 	}
 
+private:
+	boost::filesystem::path _file;
+	FILE* _f;
+	size_t _offset;
+};
+
+/** Write the analysis to a temporary file and then move it into place, so that
+ *  an interrupted write does not leave a truncated analysis at filename.
+ */
+void
+AudioAnalysis::write (boost::filesystem::path filename)
+{
+	boost::filesystem::path const tmp = filename.string() + ".tmp";
+	AudioAnalysisWriter writer (tmp);
+
+	writer.put (audio_analysis_magic, 8);
+	writer.put<uint32_t> (audio_analysis_byte_order);
+	writer.put<uint32_t> (_current_state_version);
+	writer.put<uint32_t> (_data.size ());
+
+	uint32_t flags = 0;
 	if (_integrated_loudness) {
-		root->add_child("IntegratedLoudness")->add_child_text (raw_convert<string> (_integrated_loudness.get ()));
+		flags |= AUDIO_ANALYSIS_HAS_INTEGRATED_LOUDNESS;
 	}
-
 	if (_loudness_range) {
-		root->add_child("LoudnessRange")->add_child_text (raw_convert<string> (_loudness_range.get ()));
+		flags |= AUDIO_ANALYSIS_HAS_LOUDNESS_RANGE;
 	}
-
 	if (_analysis_gain) {
-		root->add_child("AnalysisGain")->add_child_text (raw_convert<string> (_analysis_gain.get ()));
+		flags |= AUDIO_ANALYSIS_HAS_ANALYSIS_GAIN;
+	}
+	writer.put<uint32_t> (flags);
+	writer.put<float> (_integrated_loudness.get_value_or (0));
+	writer.put<float> (_loudness_range.get_value_or (0));
+	writer.put<double> (_analysis_gain.get_value_or (0));
+	writer.put<uint32_t> (_sample_peak.size ());
+	writer.put<uint32_t> (_true_peak.size ());
+
+	BOOST_FOREACH (vector<AudioPoint> const & i, _data) {
+		writer.put<uint32_t> (i.size ());
+	}
+	writer.align ();
+
+	BOOST_FOREACH (PeakTime const & i, _sample_peak) {
+		writer.put<int64_t> (i.time.get ());
+	}
+	BOOST_FOREACH (PeakTime const & i, _sample_peak) {
+		writer.put<float> (i.peak);
+	}
+	BOOST_FOREACH (float i, _true_peak) {
+		writer.put<float> (i);
+	}
+	writer.align ();
+
+	vector<float> values;
+	BOOST_FOREACH (vector<AudioPoint> const & i, _data) {
+		for (int j = 0; j < AudioPoint::COUNT; ++j) {
+			values.clear ();
+			BOOST_FOREACH (AudioPoint k, i) {
+				values.push_back (k[j]);
+			}
+			writer.put (values.empty() ? 0 : &values[0], values.size ());
+		}
 	}
 
-	doc->write_to_file_formatted (filename.string ());
+	writer.close ();
+	boost::filesystem::rename (tmp, filename);
 }
 
 float
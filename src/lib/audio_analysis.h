@@ -105,6 +105,9 @@ public:
 	float gain_correction (boost::shared_ptr<const Playlist> playlist);
 
 private:
+	void read_xml (boost::filesystem::path);
+	void read_binary (boost::filesystem::path);
+
 	std::vector<std::vector<AudioPoint> > _data;
 	std::vector<PeakTime> _sample_peak;
 	std::vector<float> _true_peak;
@@ -0,0 +1,164 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_analysis_pyramid.cc
+ *  @brief AudioAnalysisPyramid class.
+ */
+
+#include "audio_analysis_pyramid.h"
+#include "audio_analysis.h"
+#include "dcpomatic_assert.h"
+#include <cmath>
+
+using std::min;
+using std::max;
+using std::vector;
+using boost::shared_ptr;
+
+AudioAnalysisPyramid::AudioAnalysisPyramid (shared_ptr<const AudioAnalysis> analysis)
+{
+	_channels.resize (analysis->channels ());
+
+	for (int c = 0; c < analysis->channels(); ++c) {
+		vector<vector<Entry> >& levels = _channels[c];
+
+		int const N = analysis->points (c);
+		levels.push_back (vector<Entry> (N));
+		for (int i = 0; i < N; ++i) {
+			AudioPoint p = analysis->get_point (c, i);
+			Entry& e = levels.back()[i];
+			e.peak_max = e.peak_min = p[AudioPoint::PEAK];
+			e.rms_squares = double (p[AudioPoint::RMS]) * p[AudioPoint::RMS];
+		}
+
+		while (levels.back().size() > 1) {
+			vector<Entry> const & below = levels.back ();
+			vector<Entry> level ((below.size() + 1) / 2);
+			for (size_t i = 0; i < level.size(); ++i) {
+				level[i] = below[i * 2];
+				if (i * 2 + 1 < below.size()) {
+					add (level[i], below[i * 2 + 1]);
+				}
+			}
+			levels.push_back (level);
+		}
+	}
+}
+
+int
+AudioAnalysisPyramid::points (int channel) const
+{
+	return _channels[channel].front().size ();
+}
+
+/** @param channel Channel index.
+ *  @param from First point.
+ *  @param to One past the last point; must be greater than from.
+ *  @return Summary of points [from, to).
+ */
+AudioAnalysisPyramid::Summary
+AudioAnalysisPyramid::get (int channel, int from, int to) const
+{
+	Entry const e = combine (channel, from, to);
+
+	Summary s;
+	s.peak_max = e.peak_max;
+	s.peak_min = e.peak_min;
+	s.rms = sqrt (e.rms_squares / (to - from));
+	return s;
+}
+
+/** Find the RMS over a range of points which may extend off either end of
+ *  the analysis; anything before the start takes the value of the first point
+ *  and anything after the end the value of the last.
+ *  @param channel Channel index.
+ *  @param from First point, which may be negative.
+ *  @param to One past the last point, which may be greater than points(channel); must be greater than from.
+ *  @return RMS of the points [from, to).
+ */
+float
+AudioAnalysisPyramid::rms (int channel, int from, int to) const
+{
+	DCPOMATIC_ASSERT (from < to);
+
+	int const N = points (channel);
+	if (N == 0) {
+		return 0;
+	}
+
+	vector<Entry> const & all = _channels[channel].front ();
+	int const count = to - from;
+	double squares = 0;
+
+	if (from < 0) {
+		squares += all.front().rms_squares * (min (to, 0) - from);
+		from = 0;
+	}
+
+	if (to > N) {
+		squares += all.back().rms_squares * (to - max (from, N));
+		to = N;
+	}
+
+	if (from < to) {
+		squares += combine(channel, from, to).rms_squares;
+	}
+
+	return sqrt (squares / count);
+}
+
+/** @return Combination of the level-0 entries [from, to) */
+AudioAnalysisPyramid::Entry
+AudioAnalysisPyramid::combine (int channel, int from, int to) const
+{
+	DCPOMATIC_ASSERT (from >= 0 && to <= points(channel) && from < to);
+
+	vector<vector<Entry> > const & levels = _channels[channel];
+
+	Entry r = levels.front()[from];
+	r.rms_squares = 0;
+
+	/* Walk up the levels, taking entries off either end of the range whenever
+	   they are not covered by a whole entry in the level above.
+	*/
+	for (size_t l = 0; from < to; ++l) {
+		vector<Entry> const & level = levels[l];
+		if (from & 1) {
+			add (r, level[from]);
+			++from;
+		}
+		if (to & 1) {
+			--to;
+			add (r, level[to]);
+		}
+		from /= 2;
+		to /= 2;
+	}
+
+	return r;
+}
+
+void
+AudioAnalysisPyramid::add (Entry& a, Entry const & b)
+{
+	a.peak_max = max (a.peak_max, b.peak_max);
+	a.peak_min = min (a.peak_min, b.peak_min);
+	a.rms_squares += b.rms_squares;
+}
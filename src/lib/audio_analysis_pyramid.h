@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_analysis_pyramid.h
+ *  @brief AudioAnalysisPyramid class.
+ */
+
+#ifndef DCPOMATIC_AUDIO_ANALYSIS_PYRAMID_H
+#define DCPOMATIC_AUDIO_ANALYSIS_PYRAMID_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+class AudioAnalysis;
+
+/** @class AudioAnalysisPyramid
+ *  @brief A multi-resolution summary of the points in an AudioAnalysis.
+ *
+ *  Level 0 holds one entry per analysis point, and each further level
+ *  summarises pairs of entries from the level below.  This means that the
+ *  peak and RMS over any range of points can be found by combining a
+ *  handful of entries, so something drawing an analysis need only do work
+ *  in proportion to the number of pixels it is drawing, whatever the length
+ *  of the analysis.
+ */
+class AudioAnalysisPyramid : public boost::noncopyable
+{
+public:
+	explicit AudioAnalysisPyramid (boost::shared_ptr<const AudioAnalysis> analysis);
+
+	/** Summary of a range of points */
+	struct Summary
+	{
+		Summary ()
+			: peak_max (0)
+			, peak_min (0)
+			, rms (0)
+		{}
+
+		/** highest peak in the range (linear) */
+		float peak_max;
+		/** lowest peak in the range (linear) */
+		float peak_min;
+		/** RMS of the range (linear) */
+		float rms;
+	};
+
+	Summary get (int channel, int from, int to) const;
+	float rms (int channel, int from, int to) const;
+
+	int channels () const {
+		return _channels.size ();
+	}
+
+	int points (int channel) const;
+
+	int levels (int channel) const {
+		return _channels[channel].size ();
+	}
+
+private:
+	struct Entry
+	{
+		Entry ()
+			: peak_max (0)
+			, peak_min (0)
+			, rms_squares (0)
+		{}
+
+		float peak_max;
+		float peak_min;
+		/** sum of the squares of the RMS values of the points that this entry covers */
+		double rms_squares;
+	};
+
+	Entry combine (int channel, int from, int to) const;
+	static void add (Entry& a, Entry const & b);
+
+	/** Levels for each channel; _channels[c][0] is the full-resolution level */
+	std::vector<std::vector<std::vector<Entry> > > _channels;
+};
+
+#endif
@@ -20,14 +20,198 @@
 
 #include "audio_buffers.h"
 #include "dcpomatic_assert.h"
+#include <boost/thread/mutex.hpp>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 #include <cassert>
 #include <cstring>
 #include <cmath>
+#include <cstdlib>
 #include <stdexcept>
+#include <map>
+#include <list>
 
 using std::bad_alloc;
+using std::map;
+using std::list;
 using boost::shared_ptr;
 
+/** Alignment of each channel's data, in bytes */
+#define AUDIO_BUFFERS_ALIGNMENT 64
+/** Maximum total size of the free blocks kept by AudioBufferPool, in bytes */
+#define AUDIO_BUFFERS_POOL_SIZE (64 * 1024 * 1024)
+
+/** @class AudioBufferPool
+ *  @brief A thread-safe pool of aligned memory blocks for AudioBuffers.
+ *
+ *  Most of the audio pipeline allocates and frees buffers of the same few sizes
+ *  over and over, so we keep blocks which are freed and hand them out again
+ *  rather than going back to the heap each time.
+ */
+class AudioBufferPool
+{
+public:
+	AudioBufferPool ()
+		: _size (0)
+	{}
+
+	void* get (size_t bytes)
+	{
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			map<size_t, list<void*> >::iterator i = _free.find (bytes);
+			if (i != _free.end() && !i->second.empty()) {
+				void* b = i->second.front ();
+				i->second.pop_front ();
+				_size -= bytes;
+				return b;
+			}
+		}
+
+		void* b = 0;
+#ifdef DCPOMATIC_WINDOWS
+		b = _aligned_malloc (bytes, AUDIO_BUFFERS_ALIGNMENT);
+#else
+		if (posix_memalign (&b, AUDIO_BUFFERS_ALIGNMENT, bytes) != 0) {
+			b = 0;
+		}
+#endif
+		if (!b) {
+			throw bad_alloc ();
+		}
+
+		return b;
+	}
+
+	void put (void* b, size_t bytes)
+	{
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if ((_size + bytes) <= AUDIO_BUFFERS_POOL_SIZE) {
+				_free[bytes].push_front (b);
+				_size += bytes;
+				return;
+			}
+		}
+
+#ifdef DCPOMATIC_WINDOWS
+		_aligned_free (b);
+#else
+		free (b);
+#endif
+	}
+
+private:
+	boost::mutex _mutex;
+	/** Free blocks, indexed by size in bytes */
+	map<size_t, list<void*> > _free;
+	/** Total size of the blocks in _free, in bytes */
+	size_t _size;
+};
+
+/* This is never destroyed, so that AudioBuffers can safely be freed during static destruction */
+static AudioBufferPool* pool = new AudioBufferPool;
+
+/** @param frames A number of frames.
+ *  @return Number of floats between the start of each channel's data, so that
+ *  every channel is aligned.
+ */
+static int32_t
+stride (int32_t frames)
+{
+	int32_t const n = AUDIO_BUFFERS_ALIGNMENT / sizeof (float);
+	return ((frames + n - 1) / n) * n;
+}
+
+/** @return Size of the block that we need for some audio data, in bytes.
+ *  This is rounded up so that buffers of similar sizes can share blocks from the pool.
+ */
+static size_t
+block_size (int channels, int32_t frames)
+{
+	size_t const pointers = stride (channels * sizeof (float *) / sizeof (float) + 1) * sizeof (float);
+	size_t const bytes = pointers + size_t (channels) * stride (frames) * sizeof (float);
+	size_t const round = 4096;
+	return ((bytes + round - 1) / round) * round;
+}
+
+/** d[i] += s[i] * gain for i in [0, n) */
+void
+audio_accumulate (float* d, float const * s, int32_t n, float gain)
+{
+	int32_t i = 0;
+#ifdef __SSE__
+	__m128 const g = _mm_set1_ps (gain);
+	for (; (i + 8) <= n; i += 8) {
+		__m128 const a = _mm_add_ps (_mm_loadu_ps (d + i), _mm_mul_ps (_mm_loadu_ps (s + i), g));
+		__m128 const b = _mm_add_ps (_mm_loadu_ps (d + i + 4), _mm_mul_ps (_mm_loadu_ps (s + i + 4), g));
+		_mm_storeu_ps (d + i, a);
+		_mm_storeu_ps (d + i + 4, b);
+	}
+#endif
+	for (; i < n; ++i) {
+		d[i] += s[i] * gain;
+	}
+}
+
+/** d[i] += s[i] for i in [0, n) */
+void
+audio_accumulate (float* d, float const * s, int32_t n)
+{
+	int32_t i = 0;
+#ifdef __SSE__
+	for (; (i + 8) <= n; i += 8) {
+		__m128 const a = _mm_add_ps (_mm_loadu_ps (d + i), _mm_loadu_ps (s + i));
+		__m128 const b = _mm_add_ps (_mm_loadu_ps (d + i + 4), _mm_loadu_ps (s + i + 4));
+		_mm_storeu_ps (d + i, a);
+		_mm_storeu_ps (d + i + 4, b);
+	}
+#endif
+	for (; i < n; ++i) {
+		d[i] += s[i];
+	}
+}
+
+/** d[i] *= gain for i in [0, n) */
+void
+audio_scale (float* d, int32_t n, float gain)
+{
+	int32_t i = 0;
+#ifdef __SSE__
+	__m128 const g = _mm_set1_ps (gain);
+	for (; (i + 8) <= n; i += 8) {
+		_mm_storeu_ps (d + i, _mm_mul_ps (_mm_loadu_ps (d + i), g));
+		_mm_storeu_ps (d + i + 4, _mm_mul_ps (_mm_loadu_ps (d + i + 4), g));
+	}
+#endif
+	for (; i < n; ++i) {
+		d[i] *= gain;
+	}
+}
+
+/** d[i] = s[i] * gain for i in [0, n) */
+void
+audio_copy_with_gain (float* d, float const * s, int32_t n, float gain)
+{
+	if (gain == 1) {
+		memcpy (d, s, n * sizeof (float));
+		return;
+	}
+
+	int32_t i = 0;
+#ifdef __SSE__
+	__m128 const g = _mm_set1_ps (gain);
+	for (; (i + 8) <= n; i += 8) {
+		_mm_storeu_ps (d + i, _mm_mul_ps (_mm_loadu_ps (s + i), g));
+		_mm_storeu_ps (d + i + 4, _mm_mul_ps (_mm_loadu_ps (s + i + 4), g));
+	}
+#endif
+	for (; i < n; ++i) {
+		d[i] = s[i] * gain;
+	}
+}
+
 /** Construct an AudioBuffers.  Audio data is undefined after this constructor.
  *  @param channels Number of channels.
  *  @param frames Number of frames to reserve space for.
@@ -72,6 +256,9 @@ AudioBuffers::~AudioBuffers ()
 	deallocate ();
 }
 
+/** Allocate a single block for the channel pointers and all the channels' data.
+ *  Data is undefined after this call.
+ */
 void
 AudioBuffers::allocate (int channels, int32_t frames)
 {
@@ -82,27 +269,23 @@ AudioBuffers::allocate (int channels, int32_t frames)
 	_frames = frames;
 	_allocated_frames = frames;
 
-	_data = static_cast<float**> (malloc (_channels * sizeof (float *)));
-	if (!_data) {
-		throw bad_alloc ();
-	}
+	_block_size = block_size (channels, frames);
+	_block = pool->get (_block_size);
 
+	_data = static_cast<float**> (_block);
+	float* p = static_cast<float*> (_block) + stride (channels * sizeof (float *) / sizeof (float) + 1);
 	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (malloc (frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
+		_data[i] = p;
+		p += stride (frames);
 	}
 }
 
 void
 AudioBuffers::deallocate ()
 {
-	for (int i = 0; i < _channels; ++i) {
-		free (_data[i]);
-	}
-
-	free (_data);
+	pool->put (_block, _block_size);
+	_block = 0;
+	_data = 0;
 }
 
 /** @param c Channel index.
@@ -125,9 +308,9 @@ AudioBuffers::set_frames (int32_t f)
 {
 	DCPOMATIC_ASSERT (f <= _allocated_frames);
 
-	for (int c = 0; c < _channels; ++c) {
-		for (int i = f; i < _frames; ++i) {
-			_data[c][i] = 0;
+	if (f < _frames) {
+		for (int c = 0; c < _channels; ++c) {
+			memset (_data[c] + f, 0, (_frames - f) * sizeof (float));
 		}
 	}
 
@@ -151,9 +334,7 @@ AudioBuffers::make_silent (int c)
 {
 	DCPOMATIC_ASSERT (c >= 0 && c < _channels);
 
-	for (int i = 0; i < _frames; ++i) {
-		_data[c][i] = 0;
-	}
+	memset (_data[c], 0, _frames * sizeof (float));
 }
 
 /** Make some frames.
@@ -166,9 +347,7 @@ AudioBuffers::make_silent (int32_t from, int32_t frames)
 	DCPOMATIC_ASSERT ((from + frames) <= _allocated_frames);
 
 	for (int c = 0; c < _channels; ++c) {
-		for (int i = from; i < (from + frames); ++i) {
-			_data[c][i] = 0;
-		}
+		memset (_data[c] + from, 0, frames * sizeof (float));
 	}
 }
 
@@ -236,12 +415,7 @@ AudioBuffers::accumulate_channel (AudioBuffers const * from, int from_channel, i
 	DCPOMATIC_ASSERT (from->frames() == N);
 	DCPOMATIC_ASSERT (to_channel <= _channels);
 
-	float* s = from->data (from_channel);
-	float* d = _data[to_channel];
-
-	for (int i = 0; i < N; ++i) {
-		*d++ += (*s++) * gain;
-	}
+	audio_accumulate (_data[to_channel], from->data (from_channel), N, gain);
 }
 
 /** Ensure we have space for at least a certain number of frames.  If we extend
@@ -255,7 +429,7 @@ AudioBuffers::ensure_size (int32_t frames)
 	}
 
 	/* Round up frames to the next power of 2 to reduce the number
-	   of realloc()s that are necessary.
+	   of reallocations that are necessary.
 	*/
 	frames--;
 	frames |= frames >> 1;
@@ -265,17 +439,22 @@ AudioBuffers::ensure_size (int32_t frames)
 	frames |= frames >> 16;
 	frames++;
 
+	void* old_block = _block;
+	size_t const old_block_size = _block_size;
+	float** old_data = _data;
+	int32_t const old_frames = _frames;
+	int32_t const old_allocated_frames = _allocated_frames;
+
+	allocate (_channels, frames);
+
 	for (int i = 0; i < _channels; ++i) {
-		_data[i] = static_cast<float*> (realloc (_data[i], frames * sizeof (float)));
-		if (!_data[i]) {
-			throw bad_alloc ();
-		}
-		for (int j = _allocated_frames; j < frames; ++j) {
-			_data[i][j] = 0;
-		}
+		memcpy (_data[i], old_data[i], old_allocated_frames * sizeof (float));
+		memset (_data[i] + old_allocated_frames, 0, (frames - old_allocated_frames) * sizeof (float));
 	}
 
-	_allocated_frames = frames;
+	pool->put (old_block, old_block_size);
+
+	_frames = old_frames;
 }
 
 /** Mix some other buffers with these ones.  The AudioBuffers must have the same number of channels.
@@ -293,9 +472,7 @@ AudioBuffers::accumulate_frames (AudioBuffers const * from, int32_t frames, int3
 
 	float** from_data = from->data ();
 	for (int i = 0; i < _channels; ++i) {
-		for (int j = 0; j < frames; ++j) {
-			_data[i][j + write_offset] += from_data[i][j + read_offset];
-		}
+		audio_accumulate (_data[i] + write_offset, from_data[i] + read_offset, frames);
 	}
 }
 
@@ -306,9 +483,7 @@ AudioBuffers::apply_gain (float dB)
 	float const linear = pow (10, dB / 20);
 
 	for (int i = 0; i < _channels; ++i) {
-		for (int j = 0; j < _frames; ++j) {
-			_data[i][j] *= linear;
-		}
+		audio_scale (_data[i], _frames, linear);
 	}
 }
 
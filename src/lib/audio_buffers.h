@@ -27,6 +27,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <stdint.h>
+#include <cstddef>
 
 /** @class AudioBuffers
  *  @brief A class to hold multi-channel audio data in float format.
@@ -34,6 +35,9 @@
  *  The use of int32_t for frame counts in this class is due to the
  *  round-up to the next power-of-2 code in ensure_size(); if that
  *  were changed the frame count could use any integer type.
+ *
+ *  The channel pointers and all the channels' data are held in a single
+ *  block of memory, taken from a pool, with each channel aligned to 64 bytes.
  */
 class AudioBuffers
 {
@@ -92,6 +96,15 @@ private:
 	int32_t _allocated_frames;
 	/** Audio data (so that, e.g. _data[2][6] is channel 2, sample 6) */
 	float** _data;
+	/** Block of memory holding _data and the audio itself */
+	void* _block;
+	/** Size of _block in bytes */
+	size_t _block_size;
 };
 
+extern void audio_accumulate (float* d, float const * s, int32_t n, float gain);
+extern void audio_accumulate (float* d, float const * s, int32_t n);
+extern void audio_scale (float* d, int32_t n, float gain);
+extern void audio_copy_with_gain (float* d, float const * s, int32_t n, float gain);
+
 #endif
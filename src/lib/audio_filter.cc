@@ -21,8 +21,12 @@
 #include "audio_filter.h"
 #include "audio_buffers.h"
 #include <cmath>
+#include <algorithm>
 
 using std::min;
+using std::copy;
+using std::fill;
+using std::swap;
 using boost::shared_ptr;
 
 /** @return array of floats which the caller must destroy with delete[] */
@@ -82,34 +86,196 @@ AudioFilter::run (shared_ptr<const AudioBuffers> in)
 		_tail->make_silent ();
 	}
 
+	if (_use_fft) {
+		run_fft (in.get(), out.get());
+	} else {
+		run_direct (in.get(), out.get());
+	}
+
+	int const amount = min (in->frames(), _tail->frames());
+	if (amount < _tail->frames ()) {
+		_tail->move (_tail->frames() - amount, amount, 0);
+	}
+	_tail->copy_from (in.get(), amount, in->frames() - amount, _tail->frames () - amount);
+
+	return out;
+}
+
+void
+AudioFilter::run_direct (AudioBuffers const * in, AudioBuffers* out)
+{
 	int const channels = in->channels ();
 	int const frames = in->frames ();
 
+	/* Put the tail and the input together so that the inner loop
+	   does not need to check which one each tap is reading from.
+	*/
+	_history.resize (_M + 1 + frames);
+
 	for (int i = 0; i < channels; ++i) {
-		float* tail_p = _tail->data (i);
-		float* in_p = in->data (i);
+		copy (_tail->data(i), _tail->data(i) + _M + 1, _history.begin());
+		copy (in->data(i), in->data(i) + frames, _history.begin() + _M + 1);
+
+		float const * h = &_history[_M + 1];
 		float* out_p = out->data (i);
 		for (int j = 0; j < frames; ++j) {
 			float s = 0;
 			for (int k = 0; k <= _M; ++k) {
-				if ((j - k) < 0) {
-					s += tail_p[j - k + _M + 1] * _ir[k];
-				} else {
-					s += in_p[j - k] * _ir[k];
-				}
+				s += h[j - k] * _ir[k];
 			}
 
 			out_p[j] = s;
 		}
 	}
+}
 
-	int const amount = min (in->frames(), _tail->frames());
-	if (amount < _tail->frames ()) {
-		_tail->move (_tail->frames() - amount, amount, 0);
+void
+AudioFilter::setup_fft ()
+{
+	/* Use an FFT which is about four times the kernel length; this gives a
+	   reasonable balance between FFT cost and the number of samples that
+	   each block produces.
+	*/
+	_fft_size = 1;
+	while (_fft_size < (_M + 1) * 4) {
+		_fft_size *= 2;
 	}
-	_tail->copy_from (in.get(), amount, in->frames() - amount, _tail->frames () - amount);
 
-	return out;
+	int const N = _fft_size;
+
+	_fft_reverse.resize (N);
+	int bits = 0;
+	while ((1 << bits) < N) {
+		++bits;
+	}
+	for (int i = 0; i < N; ++i) {
+		int r = 0;
+		for (int j = 0; j < bits; ++j) {
+			if (i & (1 << j)) {
+				r |= 1 << (bits - j - 1);
+			}
+		}
+		_fft_reverse[i] = r;
+	}
+
+	_fft_twiddle_re.resize (N / 2);
+	_fft_twiddle_im.resize (N / 2);
+	for (int i = 0; i < N / 2; ++i) {
+		_fft_twiddle_re[i] = cos (-2 * M_PI * i / N);
+		_fft_twiddle_im[i] = sin (-2 * M_PI * i / N);
+	}
+
+	_kernel_re.assign (N, 0);
+	_kernel_im.assign (N, 0);
+	for (int i = 0; i <= _M; ++i) {
+		_kernel_re[i] = _ir[i] / N;
+	}
+	fft (&_kernel_re[0], &_kernel_im[0]);
+
+	_work_re.resize (N);
+	_work_im.resize (N);
+}
+
+/** In-place forward radix-2 FFT of _fft_size points.  An inverse transform
+ *  (without the 1 / N scaling) can be obtained by swapping re and im.
+ */
+void
+AudioFilter::fft (float* re, float* im) const
+{
+	int const N = _fft_size;
+
+	for (int i = 0; i < N; ++i) {
+		int const j = _fft_reverse[i];
+		if (i < j) {
+			swap (re[i], re[j]);
+			swap (im[i], im[j]);
+		}
+	}
+
+	for (int length = 2; length <= N; length *= 2) {
+		int const half = length / 2;
+		int const step = N / length;
+		for (int i = 0; i < N; i += length) {
+			float* a_re = re + i;
+			float* a_im = im + i;
+			float* b_re = re + i + half;
+			float* b_im = im + i + half;
+			for (int k = 0; k < half; ++k) {
+				float const w_re = _fft_twiddle_re[k * step];
+				float const w_im = _fft_twiddle_im[k * step];
+				float const t_re = b_re[k] * w_re - b_im[k] * w_im;
+				float const t_im = b_re[k] * w_im + b_im[k] * w_re;
+				b_re[k] = a_re[k] - t_re;
+				b_im[k] = a_im[k] - t_im;
+				a_re[k] += t_re;
+				a_im[k] += t_im;
+			}
+		}
+	}
+}
+
+/** Overlap-save convolution.  As our kernel is real we can filter two channels
+ *  at once by putting one in the real part of the FFT input and the other in
+ *  the imaginary part.
+ */
+void
+AudioFilter::run_fft (AudioBuffers const * in, AudioBuffers* out)
+{
+	if (_fft_size == 0) {
+		setup_fft ();
+	}
+
+	int const N = _fft_size;
+	/* Number of new samples that we can process with each FFT */
+	int const block = N - _M;
+	int const channels = in->channels ();
+	int const frames = in->frames ();
+
+	float* re = &_work_re[0];
+	float* im = &_work_im[0];
+	float const * k_re = &_kernel_re[0];
+	float const * k_im = &_kernel_im[0];
+
+	for (int c = 0; c < channels; c += 2) {
+		bool const pair = (c + 1) < channels;
+
+		for (int pos = 0; pos < frames; pos += block) {
+			int const n = min (block, frames - pos);
+
+			/* Previous _M samples then n new ones, zero-padded */
+			for (int i = 0; i < _M; ++i) {
+				int const t = pos - _M + i;
+				re[i] = t < 0 ? _tail->data(c)[t + _M + 1] : in->data(c)[t];
+				im[i] = pair ? (t < 0 ? _tail->data(c + 1)[t + _M + 1] : in->data(c + 1)[t]) : 0;
+			}
+
+			copy (in->data(c) + pos, in->data(c) + pos + n, re + _M);
+			fill (re + _M + n, re + N, 0.0f);
+			if (pair) {
+				copy (in->data(c + 1) + pos, in->data(c + 1) + pos + n, im + _M);
+				fill (im + _M + n, im + N, 0.0f);
+			} else {
+				fill (im + _M, im + N, 0.0f);
+			}
+
+			fft (re, im);
+
+			for (int i = 0; i < N; ++i) {
+				float const r = re[i] * k_re[i] - im[i] * k_im[i];
+				im[i] = re[i] * k_im[i] + im[i] * k_re[i];
+				re[i] = r;
+			}
+
+			/* Inverse transform */
+			fft (im, re);
+
+			/* The first _M outputs are corrupted by circular wrap-around; the rest are what we want */
+			copy (re + _M, re + _M + n, out->data(c) + pos);
+			if (pair) {
+				copy (im + _M, im + _M + n, out->data(c + 1) + pos);
+			}
+		}
+	}
 }
 
 void
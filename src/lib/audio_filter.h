@@ -22,6 +22,7 @@
 #define DCPOMATIC_AUDIO_FILTER_H
 
 #include <boost/shared_ptr.hpp>
+#include <vector>
 
 class AudioBuffers;
 struct audio_filter_impulse_input_test;
@@ -34,6 +35,8 @@ class AudioFilter
 public:
 	AudioFilter (float transition_bandwidth)
 		: _ir (0)
+		, _use_fft (false)
+		, _fft_size (0)
 	{
 		_M = 4 / transition_bandwidth;
 		if (_M % 2) {
@@ -47,15 +50,48 @@ public:
 
 	void flush ();
 
+	/** @param u true to convolve using FFTs (overlap-save) rather than directly.
+	 *  This is much faster for long kernels, but the output will not be bit-identical
+	 *  to that from direct convolution.
+	 */
+	void set_use_fft (bool u) {
+		_use_fft = u;
+		_fft_size = 0;
+	}
+
 protected:
 	friend struct audio_filter_impulse_kernel_test;
 	friend struct audio_filter_impulse_input_test;
+	friend struct audio_filter_fft_test;
 
 	float* sinc_blackman (float cutoff, bool invert) const;
 
 	float* _ir;
 	int _M;
 	boost::shared_ptr<AudioBuffers> _tail;
+
+private:
+	void run_direct (AudioBuffers const * in, AudioBuffers* out);
+	void run_fft (AudioBuffers const * in, AudioBuffers* out);
+	void setup_fft ();
+	void fft (float* re, float* im) const;
+
+	bool _use_fft;
+	/** Buffer of the last _M + 1 input samples followed by the current input, for direct convolution */
+	std::vector<float> _history;
+	/** FFT size, or 0 if the FFT state needs to be set up */
+	int _fft_size;
+	/** Bit-reversed index for each FFT point */
+	std::vector<int> _fft_reverse;
+	/** Twiddle factors */
+	std::vector<float> _fft_twiddle_re;
+	std::vector<float> _fft_twiddle_im;
+	/** Spectrum of _ir, scaled by 1 / _fft_size */
+	std::vector<float> _kernel_re;
+	std::vector<float> _kernel_im;
+	/** Working buffers for a block of input */
+	std::vector<float> _work_re;
+	std::vector<float> _work_im;
 };
 
 class LowPassAudioFilter : public AudioFilter
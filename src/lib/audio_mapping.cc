@@ -126,6 +126,12 @@ AudioMapping::get (int input_channel, int output_channel) const
 	return _gain[input_channel][output_channel];
 }
 
+bool
+AudioMapping::operator== (AudioMapping const & other) const
+{
+	return _input_channels == other._input_channels && _output_channels == other._output_channels && _gain == other._gain;
+}
+
 void
 AudioMapping::as_xml (xmlpp::Node* node) const
 {
@@ -61,6 +61,8 @@ public:
 
 	std::string digest () const;
 
+	bool operator== (AudioMapping const & other) const;
+
 	std::list<int> mapped_output_channels () const;
 	void unmap_all ();
 
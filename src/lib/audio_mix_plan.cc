@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "audio_mix_plan.h"
+#include "audio_buffers.h"
+#include <cstring>
+
+using std::min;
+using std::vector;
+using boost::shared_ptr;
+
+/** Number of frames to mix at a time, chosen so that a block of each
+ *  input channel stays in cache while all the outputs are made.
+ */
+#define AUDIO_MIX_PLAN_BLOCK 4096
+
+/** @param mapping Mapping to use.
+ *  @param output_channels Number of output channels to produce; this may be
+ *  different to the number of outputs in the mapping.
+ */
+AudioMixPlan::AudioMixPlan (AudioMapping mapping, int output_channels)
+{
+	_output_channels.resize (output_channels);
+	for (int i = 0; i < mapping.input_channels(); ++i) {
+		for (int j = 0; j < min (output_channels, mapping.output_channels()); ++j) {
+			float const g = mapping.get (i, j);
+			if (g > 0) {
+				_output_channels[j].push_back (Input (i, g));
+			}
+		}
+	}
+}
+
+shared_ptr<AudioBuffers>
+AudioMixPlan::run (shared_ptr<const AudioBuffers> input) const
+{
+	int const frames = input->frames ();
+	shared_ptr<AudioBuffers> mapped (new AudioBuffers (_output_channels.size(), frames));
+
+	for (int from = 0; from < frames; from += AUDIO_MIX_PLAN_BLOCK) {
+		int const N = min (AUDIO_MIX_PLAN_BLOCK, frames - from);
+		for (size_t i = 0; i < _output_channels.size(); ++i) {
+			float* out = mapped->data(i) + from;
+			vector<Input> const & inputs = _output_channels[i];
+			if (inputs.empty ()) {
+				memset (out, 0, N * sizeof (float));
+				continue;
+			}
+
+			/* Write the first input rather than silencing and then adding to it */
+			audio_copy_with_gain (out, input->data(inputs.front().channel) + from, N, inputs.front().gain);
+			for (size_t j = 1; j < inputs.size(); ++j) {
+				audio_accumulate (out, input->data(inputs[j].channel) + from, N, inputs[j].gain);
+			}
+		}
+	}
+
+	return mapped;
+}
@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/audio_mix_plan.h
+ *  @brief AudioMixPlan class.
+ */
+
+#ifndef DCPOMATIC_AUDIO_MIX_PLAN_H
+#define DCPOMATIC_AUDIO_MIX_PLAN_H
+
+#include "audio_mapping.h"
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class AudioBuffers;
+
+/** @class AudioMixPlan
+ *  @brief A pre-computed plan for mixing audio according to an AudioMapping.
+ *
+ *  The non-zero gains in the mapping are collected into a list for each output
+ *  channel when the plan is made, so that running it does not need to look at
+ *  every (input, output) pair.
+ */
+class AudioMixPlan
+{
+public:
+	AudioMixPlan () {}
+	AudioMixPlan (AudioMapping mapping, int output_channels);
+
+	boost::shared_ptr<AudioBuffers> run (boost::shared_ptr<const AudioBuffers> input) const;
+
+	int output_channels () const {
+		return _output_channels.size ();
+	}
+
+private:
+	struct Input
+	{
+		Input (int c, float g)
+			: channel (c)
+			, gain (g)
+		{}
+
+		int channel;
+		float gain;
+	};
+
+	/** Inputs (with their gains) to mix into each output channel */
+	std::vector<std::vector<Input> > _output_channels;
+};
+
+#endif
@@ -53,7 +53,7 @@ Butler::Butler (shared_ptr<Player> player, shared_ptr<Log> log, AudioMapping aud
 	, _finished (false)
 	, _died (false)
 	, _stop_thread (false)
-	, _audio_mapping (audio_mapping)
+	, _audio_mix_plan (audio_mapping, audio_channels)
 	, _audio_channels (audio_channels)
 	, _disable_audio (false)
 {
@@ -227,7 +227,7 @@ Butler::audio (shared_ptr<AudioBuffers> audio)
 		}
 	}
 
-	_audio.put (remap (audio, _audio_channels, _audio_mapping));
+	_audio.put (_audio_mix_plan.run (audio));
 }
 
 /** Try to get `frames' frames of audio and copy it into `out'.  Silence
@@ -20,7 +20,7 @@
 
 #include "video_ring_buffers.h"
 #include "audio_ring_buffers.h"
-#include "audio_mapping.h"
+#include "audio_mix_plan.h"
 #include "exception_store.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
@@ -73,7 +73,7 @@ private:
 	bool _died;
 	bool _stop_thread;
 
-	AudioMapping _audio_mapping;
+	AudioMixPlan _audio_mix_plan;
 	int _audio_channels;
 
 	bool _disable_audio;
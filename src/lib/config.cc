@@ -139,6 +139,8 @@ Config::set_defaults ()
 	   use about 240Mb with 72 encoding threads.
 	*/
 	_frames_in_memory_multiplier = 3;
+	_j2k_cache_size = 0;
+	_j2k_cache_directory = optional<boost::filesystem::path> ();
 
 	_allowed_dcp_frame_rates.clear ();
 	_allowed_dcp_frame_rates.push_back (24);
@@ -367,6 +369,8 @@ try
 	}
 	_last_player_load_directory = f.optional_string_child("LastPlayerLoadDirectory");
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
+	_j2k_cache_size = f.optional_number_child<int>("J2KCacheSize").get_value_or(0);
+	_j2k_cache_directory = f.optional_string_child("J2KCacheDirectory");
 
 	/* Replace any cinemas from config.xml with those from the configured file */
 	if (boost::filesystem::exists (_cinemas_file)) {
@@ -651,6 +655,14 @@ Config::write_config () const
 	   frames to be held in memory at once.
 	*/
 	root->add_child("FramesInMemoryMultiplier")->add_child_text(raw_convert<string>(_frames_in_memory_multiplier));
+	/* [XML] J2KCacheSize Maximum size in GB of the cache of encoded JPEG2000 frames which is used to avoid re-encoding
+	   frames which have not changed since the last time a DCP was made; 0 for no cache.
+	*/
+	root->add_child("J2KCacheSize")->add_child_text(raw_convert<string>(_j2k_cache_size));
+	if (_j2k_cache_directory) {
+		/* [XML:opt] J2KCacheDirectory Directory to keep the JPEG2000 frame cache in. */
+		root->add_child("J2KCacheDirectory")->add_child_text(_j2k_cache_directory->string());
+	}
 
 	try {
 		doc.write_to_file_formatted(config_file().string());
@@ -835,6 +847,12 @@ Config::existing_template (string name) const
 	return boost::filesystem::exists (template_path (name));
 }
 
+boost::filesystem::path
+Config::j2k_cache_directory () const
+{
+	return _j2k_cache_directory.get_value_or (path ("j2k_cache", false));
+}
+
 boost::filesystem::path
 Config::template_path (string name) const
 {
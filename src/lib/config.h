@@ -349,6 +349,13 @@ public:
 		return _frames_in_memory_multiplier;
 	}
 
+	/** @return Maximum size of the cache of encoded JPEG2000 frames in GB, or 0 for no cache */
+	int j2k_cache_size () const {
+		return _j2k_cache_size;
+	}
+
+	boost::filesystem::path j2k_cache_directory () const;
+
 	void set_master_encoding_threads (int n) {
 		maybe_set (_master_encoding_threads, n);
 	}
@@ -612,6 +619,14 @@ public:
 		maybe_set (_frames_in_memory_multiplier, m);
 	}
 
+	void set_j2k_cache_size (int s) {
+		maybe_set (_j2k_cache_size, s);
+	}
+
+	void set_j2k_cache_directory (boost::filesystem::path d) {
+		maybe_set (_j2k_cache_directory, d);
+	}
+
 	void clear_history () {
 		_history.clear ();
 		changed ();
@@ -780,6 +795,10 @@ private:
 	std::string _cover_sheet;
 	boost::optional<boost::filesystem::path> _last_player_load_directory;
 	int _frames_in_memory_multiplier;
+	/** maximum size of the cache of encoded JPEG2000 frames in GB, or 0 for no cache */
+	int _j2k_cache_size;
+	/** directory for the JPEG2000 frame cache, or empty to use one in our configuration directory */
+	boost::optional<boost::filesystem::path> _j2k_cache_directory;
 
 	/** Singleton instance, or 0 */
 	static Config* _instance;
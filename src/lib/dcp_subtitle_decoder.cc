@@ -22,19 +22,38 @@
 #include "dcp_subtitle_content.h"
 #include <dcp/interop_subtitle_asset.h>
 #include <iostream>
+#include <algorithm>
 
 using std::list;
+using std::vector;
 using std::cout;
 using boost::shared_ptr;
 using boost::bind;
 
+static bool
+subtitle_in_sorter (dcp::SubtitleString const & a, dcp::SubtitleString const & b)
+{
+	return a.in() < b.in();
+}
+
+static bool
+subtitle_in_before (dcp::SubtitleString const & s, ContentTime t)
+{
+	return ContentTime::from_seconds (s.in().as_seconds()) < t;
+}
+
 DCPSubtitleDecoder::DCPSubtitleDecoder (shared_ptr<const DCPSubtitleContent> content, shared_ptr<Log> log)
 {
 	subtitle.reset (new SubtitleDecoder (this, content->subtitle, log));
 
 	shared_ptr<dcp::SubtitleAsset> c (load (content->path (0)));
-	_subtitles = c->subtitles ();
-	_next = _subtitles.begin ();
+	list<dcp::SubtitleString> s = c->subtitles ();
+	_subtitles = vector<dcp::SubtitleString> (s.begin(), s.end());
+	/* Sort by in time (keeping the file's order for subtitles which start together)
+	   so that we can binary-search when seeking.
+	*/
+	stable_sort (_subtitles.begin(), _subtitles.end(), subtitle_in_sorter);
+	_next = 0;
 }
 
 void
@@ -42,17 +61,13 @@ DCPSubtitleDecoder::seek (ContentTime time, bool accurate)
 {
 	Decoder::seek (time, accurate);
 
-	_next = _subtitles.begin ();
-	list<dcp::SubtitleString>::const_iterator i = _subtitles.begin ();
-	while (i != _subtitles.end() && ContentTime::from_seconds (_next->in().as_seconds()) < time) {
-		++i;
-	}
+	_next = lower_bound (_subtitles.begin(), _subtitles.end(), time, subtitle_in_before) - _subtitles.begin();
 }
 
 bool
 DCPSubtitleDecoder::pass ()
 {
-	if (_next == _subtitles.end ()) {
+	if (_next >= _subtitles.size ()) {
 		return true;
 	}
 
@@ -64,10 +79,10 @@ DCPSubtitleDecoder::pass ()
 	*/
 
 	list<dcp::SubtitleString> s;
-	ContentTimePeriod const p = content_time_period (*_next);
+	ContentTimePeriod const p = content_time_period (_subtitles[_next]);
 
-	while (_next != _subtitles.end () && content_time_period (*_next) == p) {
-		s.push_back (*_next);
+	while (_next < _subtitles.size () && content_time_period (_subtitles[_next]) == p) {
+		s.push_back (_subtitles[_next]);
 		++_next;
 	}
 
@@ -20,6 +20,7 @@
 
 #include "subtitle_decoder.h"
 #include "dcp_subtitle.h"
+#include <vector>
 
 class DCPSubtitleContent;
 
@@ -34,6 +35,8 @@ public:
 private:
 	ContentTimePeriod content_time_period (dcp::SubtitleString s) const;
 
-	std::list<dcp::SubtitleString> _subtitles;
-	std::list<dcp::SubtitleString>::const_iterator _next;
+	/** Subtitles sorted by their in time */
+	std::vector<dcp::SubtitleString> _subtitles;
+	/** Index into _subtitles of the next subtitle to emit */
+	size_t _next;
 };
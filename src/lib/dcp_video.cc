@@ -37,11 +37,13 @@
 #include "log.h"
 #include "cross.h"
 #include "player_video.h"
+#include "digester.h"
+#include "rgb_to_xyz.h"
+#include "j2k_draft.h"
 #include "compose.hpp"
 #include <libcxml/cxml.h>
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
-#include <dcp/rgb_xyz.h>
 #include <dcp/j2k.h>
 #include <libxml++/libxml++.h>
 #include <boost/asio.hpp>
@@ -59,6 +61,7 @@
 using std::string;
 using std::cout;
 using boost::shared_ptr;
+using boost::optional;
 using dcp::Size;
 using dcp::Data;
 using dcp::raw_convert;
@@ -70,16 +73,23 @@ using dcp::raw_convert;
  *  @param index Index of the frame within the DCP.
  *  @param bw J2K bandwidth to use (see Config::j2k_bandwidth ())
  *  @param l Log to write to.
+ *  @param draft true to scale quickly at lower quality (see Film::draft ())
+ *  @param half_resolution true to throw away half the image's resolution before encoding
+ *  (see Film::draft_half_resolution ())
  */
 DCPVideo::DCPVideo (
-	shared_ptr<const PlayerVideo> frame, int index, int dcp_fps, int bw, Resolution r, shared_ptr<Log> l
+	shared_ptr<const PlayerVideo> frame, int index, int dcp_fps, int bw, Resolution r, shared_ptr<Log> l, bool draft, bool half_resolution
 	)
 	: _frame (frame)
 	, _index (index)
 	, _frames_per_second (dcp_fps)
 	, _j2k_bandwidth (bw)
 	, _resolution (r)
+	, _draft (draft)
+	, _half_resolution (half_resolution)
 	, _log (l)
+	, _bytes_sent (0)
+	, _bytes_received (0)
 {
 
 }
@@ -87,27 +97,42 @@ DCPVideo::DCPVideo (
 DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::Node> node, shared_ptr<Log> log)
 	: _frame (frame)
 	, _log (log)
+	, _bytes_sent (0)
+	, _bytes_received (0)
 {
 	_index = node->number_child<int> ("Index");
 	_frames_per_second = node->number_child<int> ("FramesPerSecond");
 	_j2k_bandwidth = node->number_child<int> ("J2KBandwidth");
 	_resolution = Resolution (node->optional_number_child<int>("Resolution").get_value_or (RESOLUTION_2K));
+	_draft = node->optional_bool_child("Draft").get_value_or (false);
+	_half_resolution = node->optional_bool_child("HalfResolution").get_value_or (false);
 }
 
+/** @param threads Number of threads which may be used to speed up the conversion.
+ *  @param draft true to use a faster, lower-quality scaler.
+ *  @param half_resolution true to throw away half the resolution of the image.
+ *  @param pool Pool of threads to use if threads is more than 1 (see RGBToXYZ::convert).
+ */
 shared_ptr<dcp::OpenJPEGImage>
-DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note)
+DCPVideo::convert_to_xyz (
+	shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note, int threads, bool draft, bool half_resolution, boost::asio::io_service* pool
+	)
 {
 	shared_ptr<dcp::OpenJPEGImage> xyz;
 
-	shared_ptr<Image> image = frame->image (note, bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, false);
+	shared_ptr<Image> image = frame->image (note, bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, draft);
+	if (half_resolution && image->pixel_format() == AV_PIX_FMT_RGB48LE) {
+		/* Throw away half the resolution; the finest wavelet sub-bands of the result are then
+		   almost empty, which may make the JPEG2000 encode quicker (though this has not been
+		   measured, and the extra scaling has a cost of its own).
+		*/
+		dcp::Size const full = image->size ();
+		shared_ptr<Image> half = image->scale (dcp::Size (full.width / 2, full.height / 2), dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, true);
+		image = half->scale (full, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, true);
+	}
+
 	if (frame->colour_conversion()) {
-		xyz = dcp::rgb_to_xyz (
-			image->data()[0],
-			image->size(),
-			image->stride()[0],
-			frame->colour_conversion().get(),
-			note
-			);
+		xyz = RGBToXYZ::get(frame->colour_conversion().get())->convert (image, note, threads, pool);
 	} else {
 		xyz.reset (new dcp::OpenJPEGImage (image->data()[0], image->size(), image->stride()[0]));
 	}
@@ -116,18 +141,23 @@ DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler
 }
 
 /** J2K-encode this frame on the local host.
+ *  @param threads Number of threads which may be used for this one frame.
+ *  @param pool Pool of threads to use if threads is more than 1.
  *  @return Encoded data.
  */
 Data
-DCPVideo::encode_locally (dcp::NoteHandler note)
+DCPVideo::encode_locally (dcp::NoteHandler note, int threads, boost::asio::io_service* pool)
 {
-	Data enc = compress_j2k (
-		convert_to_xyz (_frame, note),
-		_j2k_bandwidth,
-		_frames_per_second,
-		_frame->eyes() == EYES_LEFT || _frame->eyes() == EYES_RIGHT,
-		_resolution == RESOLUTION_4K
-		);
+	shared_ptr<dcp::OpenJPEGImage> xyz = convert_to_xyz (_frame, note, threads, _draft, _half_resolution, pool);
+	bool const threed = _frame->eyes() == EYES_LEFT || _frame->eyes() == EYES_RIGHT;
+
+	Data enc;
+	if (_draft) {
+		/* Use fewer wavelet decomposition levels than libdcp does */
+		enc = compress_draft_j2k (xyz, _j2k_bandwidth, _frames_per_second, threed, _resolution == RESOLUTION_4K);
+	} else {
+		enc = compress_j2k (xyz, _j2k_bandwidth, _frames_per_second, threed, _resolution == RESOLUTION_4K);
+	}
 
 	switch (_frame->eyes()) {
 	case EYES_BOTH:
@@ -163,11 +193,17 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 
 	socket->connect (*endpoint_iterator);
 
+	/* The server says whether it has room for our request before reading it */
+	if (socket->read_uint32 () == ENCODE_SERVER_BUSY) {
+		throw ServerBusyError (String::compose ("server %1 is busy", serv.host_name ()));
+	}
+
 	/* Collect all XML metadata */
 	xmlpp::Document doc;
 	xmlpp::Element* root = doc.create_root_node ("EncodingRequest");
 	root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
-	add_metadata (root);
+	/* Digesting the source image takes time, so only do it if the server can make use of it */
+	add_metadata (root, serv.image_cache ());
 
 	LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), _index);
 
@@ -176,9 +212,14 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 	socket->write (xml.length() + 1);
 	socket->write ((uint8_t *) xml.c_str(), xml.length() + 1);
 
+	/* The server replies to say whether it already has our source image, in which
+	   case we need not send it again.
+	*/
+	bool const server_has_image = socket->read_uint32 ();
+
 	/* Send binary data */
 	LOG_TIMING("start-remote-send thread=%1", thread_id ());
-	_frame->send_binary (socket);
+	_frame->send_binary (socket, !server_has_image);
 
 	/* Read the response (JPEG2000-encoded data); this blocks until the data
 	   is ready and sent back.
@@ -189,19 +230,25 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 	socket->read (e.data().get(), e.size());
 	LOG_TIMING("finish-remote-receive thread=%1", thread_id ());
 
+	_bytes_sent = socket->bytes_written ();
+	_bytes_received = socket->bytes_read ();
+
 	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), _index);
 
 	return e;
 }
 
+/** @param in_digest true to include a digest of our source image (see PlayerVideo::add_metadata) */
 void
-DCPVideo::add_metadata (xmlpp::Element* el) const
+DCPVideo::add_metadata (xmlpp::Element* el, bool in_digest) const
 {
 	el->add_child("Index")->add_child_text (raw_convert<string> (_index));
 	el->add_child("FramesPerSecond")->add_child_text (raw_convert<string> (_frames_per_second));
 	el->add_child("J2KBandwidth")->add_child_text (raw_convert<string> (_j2k_bandwidth));
 	el->add_child("Resolution")->add_child_text (raw_convert<string> (int (_resolution)));
-	_frame->add_metadata (el);
+	el->add_child("Draft")->add_child_text (_draft ? "1" : "0");
+	el->add_child("HalfResolution")->add_child_text (_half_resolution ? "1" : "0");
+	_frame->add_metadata (el, in_digest);
 }
 
 Eyes
@@ -218,9 +265,48 @@ DCPVideo::same (shared_ptr<const DCPVideo> other) const
 {
 	if (_frames_per_second != other->_frames_per_second ||
 	    _j2k_bandwidth != other->_j2k_bandwidth ||
-	    _resolution != other->_resolution) {
+	    _resolution != other->_resolution ||
+	    _draft != other->_draft ||
+	    _half_resolution != other->_half_resolution) {
 		return false;
 	}
 
 	return _frame->same (other->_frame);
 }
+
+/** @return A digest of everything that affects the result of encoding this frame
+ *  (apart from the frame index).
+ */
+string
+DCPVideo::digest () const
+{
+	Digester digester;
+	_frame->add_digest (digester);
+	digester.add (_frames_per_second);
+	digester.add (_j2k_bandwidth);
+	digester.add (static_cast<int> (_resolution));
+	digester.add (_draft);
+	digester.add (_half_resolution);
+	return digester.get ();
+}
+
+/** @return A key which identifies the result of encoding this frame if its image is
+ *  known to be constant (e.g. black, or a still image), otherwise an empty optional.
+ */
+optional<string>
+DCPVideo::constant_key () const
+{
+	optional<string> frame = _frame->constant_key ();
+	if (!frame) {
+		return optional<string> ();
+	}
+
+	Digester digester;
+	digester.add (frame.get ());
+	digester.add (_frames_per_second);
+	digester.add (_j2k_bandwidth);
+	digester.add (static_cast<int> (_resolution));
+	digester.add (_draft);
+	digester.add (_half_resolution);
+	return digester.get ();
+}
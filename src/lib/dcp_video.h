@@ -22,6 +22,8 @@
 #include "encode_server_description.h"
 #include <libcxml/cxml.h>
 #include <dcp/data.h>
+#include <boost/optional.hpp>
+#include <boost/asio.hpp>
 
 /** @file  src/dcp_video_frame.h
  *  @brief A single frame of video destined for a DCP.
@@ -42,31 +44,58 @@ class PlayerVideo;
 class DCPVideo : public boost::noncopyable
 {
 public:
-	DCPVideo (boost::shared_ptr<const PlayerVideo>, int, int, int, Resolution, boost::shared_ptr<Log>);
+	DCPVideo (boost::shared_ptr<const PlayerVideo>, int, int, int, Resolution, boost::shared_ptr<Log>, bool draft = false, bool half_resolution = false);
 	DCPVideo (boost::shared_ptr<const PlayerVideo>, cxml::ConstNodePtr, boost::shared_ptr<Log>);
 
-	dcp::Data encode_locally (dcp::NoteHandler note);
+	dcp::Data encode_locally (dcp::NoteHandler note, int threads = 1, boost::asio::io_service* pool = 0);
 	dcp::Data encode_remotely (EncodeServerDescription, int timeout = 30);
 
 	int index () const {
 		return _index;
 	}
 
+	Resolution resolution () const {
+		return _resolution;
+	}
+
 	Eyes eyes () const;
 
-	bool same (boost::shared_ptr<const DCPVideo> other) const;
+	/** @return number of bytes sent to the server during the last call to encode_remotely() */
+	uint64_t bytes_sent () const {
+		return _bytes_sent;
+	}
 
-	static boost::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz (boost::shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note);
+	/** @return number of bytes received from the server during the last call to encode_remotely() */
+	uint64_t bytes_received () const {
+		return _bytes_received;
+	}
+
+	bool same (boost::shared_ptr<const DCPVideo> other) const;
+	std::string digest () const;
+	boost::optional<std::string> constant_key () const;
+
+	static boost::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz (
+		boost::shared_ptr<const PlayerVideo> frame,
+		dcp::NoteHandler note,
+		int threads = 1,
+		bool draft = false,
+		bool half_resolution = false,
+		boost::asio::io_service* pool = 0
+		);
 
 private:
 
-	void add_metadata (xmlpp::Element *) const;
+	void add_metadata (xmlpp::Element *, bool in_digest) const;
 
 	boost::shared_ptr<const PlayerVideo> _frame;
 	int _index;			 ///< frame index within the DCP's intrinsic duration
 	int _frames_per_second;		 ///< Frames per second that we will use for the DCP
 	int _j2k_bandwidth;		 ///< J2K bandwidth to use
 	Resolution _resolution;          ///< Resolution (2K or 4K)
+	bool _draft;                     ///< true to scale quickly at lower quality
+	bool _half_resolution;           ///< true to throw away half the image's resolution before encoding
 
 	boost::shared_ptr<Log> _log; ///< log
+	uint64_t _bytes_sent;
+	uint64_t _bytes_received;
 };
@@ -32,6 +32,8 @@ Socket::Socket (int timeout)
 	: _deadline (_io_service)
 	, _socket (_io_service)
 	, _timeout (timeout)
+	, _bytes_written (0)
+	, _bytes_read (0)
 {
 	_deadline.expires_at (boost::posix_time::pos_infin);
 	check ();
@@ -89,6 +91,8 @@ Socket::write (uint8_t const * data, int size)
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_write (%1)"), ec.value ()));
 	}
+
+	_bytes_written += size;
 }
 
 void
@@ -117,6 +121,8 @@ Socket::read (uint8_t* data, int size)
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_read (%1)"), ec.value ()));
 	}
+
+	_bytes_read += size;
 }
 
 uint32_t
@@ -19,6 +19,7 @@
 */
 
 #include <boost/asio.hpp>
+#include <stdint.h>
 
 /** @class Socket
  *  @brief A class to wrap a boost::asio::ip::tcp::socket with some things
@@ -45,6 +46,16 @@ public:
 	void read (uint8_t* data, int size);
 	uint32_t read_uint32 ();
 
+	/** @return number of bytes that have been written to this socket */
+	uint64_t bytes_written () const {
+		return _bytes_written;
+	}
+
+	/** @return number of bytes that have been read from this socket */
+	uint64_t bytes_read () const {
+		return _bytes_read;
+	}
+
 private:
 	void check ();
 
@@ -54,4 +65,6 @@ private:
 	boost::asio::deadline_timer _deadline;
 	boost::asio::ip::tcp::socket _socket;
 	int _timeout;
+	uint64_t _bytes_written;
+	uint64_t _bytes_read;
 };
@@ -0,0 +1,267 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/decoder_queue.cc
+ *  @brief DecoderQueue class.
+ */
+
+#include "decoder_queue.h"
+#include "decoder.h"
+#include "video_decoder.h"
+#include "audio_decoder.h"
+#include "subtitle_decoder.h"
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+
+using boost::shared_ptr;
+using boost::function;
+
+/** Maximum number of passes to keep in a threaded DecoderQueue */
+#define DECODER_QUEUE_LENGTH 16
+
+/** @param decoder Decoder to use.
+ *  @param threaded true to run the decoder in its own thread.
+ *  @param video_taken Function to say whether a video frame will be taken by
+ *  the receiver of Video; only used if threaded is true.
+ *  @param audio_accepted Function to return the number of frames in some audio
+ *  that will be accepted by the receiver of Audio; only used if threaded is true.
+ */
+DecoderQueue::DecoderQueue (
+	shared_ptr<Decoder> decoder,
+	bool threaded,
+	function<bool (ContentVideo)> video_taken,
+	function<Frame (AudioStreamPtr, ContentAudio)> audio_accepted
+	)
+	: _decoder (decoder)
+	, _threaded (threaded)
+	, _video_taken (video_taken)
+	, _audio_accepted (audio_accepted)
+	, _thread (0)
+	, _current (0)
+	, _finished (false)
+	, _stop (false)
+{
+	if (_decoder->video) {
+		_video_connection = _decoder->video->Data.connect (boost::bind (&DecoderQueue::video, this, _1));
+	}
+
+	if (_decoder->audio) {
+		_audio_connection = _decoder->audio->Data.connect (boost::bind (&DecoderQueue::audio, this, _1, _2));
+	}
+
+	if (_decoder->subtitle) {
+		_image_subtitle_start_connection = _decoder->subtitle->ImageStart.connect (boost::bind (&DecoderQueue::image_subtitle_start, this, _1));
+		_text_subtitle_start_connection = _decoder->subtitle->TextStart.connect (boost::bind (&DecoderQueue::text_subtitle_start, this, _1));
+		_subtitle_stop_connection = _decoder->subtitle->Stop.connect (boost::bind (&DecoderQueue::subtitle_stop, this, _1));
+	}
+
+	start ();
+}
+
+DecoderQueue::~DecoderQueue ()
+{
+	stop ();
+}
+
+void
+DecoderQueue::start ()
+{
+	if (_threaded) {
+		_thread = new boost::thread (boost::bind (&DecoderQueue::thread, this));
+	}
+}
+
+/** Stop our thread (if we have one) and discard anything that it has decoded
+ *  but which has not yet been emitted.
+ */
+void
+DecoderQueue::stop ()
+{
+	if (!_thread) {
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_summon.notify_all ();
+	}
+
+	/* Let the thread finish any pass that it is in the middle of, as
+	   interrupting it could leave the decoder in a strange state.
+	*/
+	_thread->join ();
+	delete _thread;
+	_thread = 0;
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_passes.clear ();
+	_finished = false;
+	_stop = false;
+}
+
+void
+DecoderQueue::thread ()
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_stop && (_finished || _passes.size() >= DECODER_QUEUE_LENGTH)) {
+			_summon.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		lm.unlock ();
+
+		Pass pass;
+		_current = &pass;
+		try {
+			pass.position = _decoder->position ();
+			pass.done = _decoder->pass ();
+		} catch (...) {
+			/* Keep the exception to be re-thrown when this pass is emitted, which
+			   is when it would have been thrown if we were not threaded.
+			*/
+			store_current ();
+			pass.failed = true;
+		}
+		_current = 0;
+
+		lm.lock ();
+		_passes.push_back (pass);
+		_finished = pass.done || pass.failed;
+		_arrived.notify_all ();
+	}
+}
+
+/** @return Earliest time of content that the next pass() will emit */
+ContentTime
+DecoderQueue::position ()
+{
+	if (!_threaded) {
+		return _decoder->position ();
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	while (_passes.empty ()) {
+		_arrived.wait (lm);
+	}
+	return _passes.front().position;
+}
+
+/** Emit the data from one pass of the decoder.
+ *  @return true if the decoder will emit no more data unless a seek() happens.
+ */
+bool
+DecoderQueue::pass ()
+{
+	if (!_threaded) {
+		return _decoder->pass ();
+	}
+
+	Pass pass;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_passes.empty ()) {
+			_arrived.wait (lm);
+		}
+		pass.emissions.swap (_passes.front().emissions);
+		pass.done = _passes.front().done;
+		pass.failed = _passes.front().failed;
+		_passes.pop_front ();
+		_summon.notify_all ();
+	}
+
+	BOOST_FOREACH (function<void ()> i, pass.emissions) {
+		i ();
+	}
+
+	if (pass.failed) {
+		rethrow ();
+	}
+
+	return pass.done;
+}
+
+void
+DecoderQueue::seek (ContentTime time, bool accurate)
+{
+	stop ();
+	_decoder->seek (time, accurate);
+	start ();
+}
+
+bool
+DecoderQueue::video (ContentVideo video)
+{
+	if (!_threaded) {
+		return Video(video).get_value_or (false);
+	}
+
+	_current->emissions.push_back (boost::bind (boost::ref (Video), video));
+	return _video_taken (video);
+}
+
+Frame
+DecoderQueue::audio (AudioStreamPtr stream, ContentAudio audio)
+{
+	if (!_threaded) {
+		return Audio(stream, audio).get_value_or (0);
+	}
+
+	_current->emissions.push_back (boost::bind (boost::ref (Audio), stream, audio));
+	return _audio_accepted (stream, audio);
+}
+
+void
+DecoderQueue::image_subtitle_start (ContentImageSubtitle subtitle)
+{
+	if (!_threaded) {
+		ImageSubtitleStart (subtitle);
+		return;
+	}
+
+	_current->emissions.push_back (boost::bind (boost::ref (ImageSubtitleStart), subtitle));
+}
+
+void
+DecoderQueue::text_subtitle_start (ContentTextSubtitle subtitle)
+{
+	if (!_threaded) {
+		TextSubtitleStart (subtitle);
+		return;
+	}
+
+	_current->emissions.push_back (boost::bind (boost::ref (TextSubtitleStart), subtitle));
+}
+
+void
+DecoderQueue::subtitle_stop (ContentTime time)
+{
+	if (!_threaded) {
+		SubtitleStop (time);
+		return;
+	}
+
+	_current->emissions.push_back (boost::bind (boost::ref (SubtitleStop), time));
+}
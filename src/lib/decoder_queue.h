@@ -0,0 +1,135 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/decoder_queue.h
+ *  @brief DecoderQueue class.
+ */
+
+#ifndef DCPOMATIC_DECODER_QUEUE_H
+#define DCPOMATIC_DECODER_QUEUE_H
+
+#include "content_video.h"
+#include "content_audio.h"
+#include "content_subtitle.h"
+#include "audio_stream.h"
+#include "exception_store.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/signals2.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <list>
+
+class Decoder;
+
+/** @class DecoderQueue
+ *  @brief A wrapper around a Decoder which can run the decoder in its own thread.
+ *
+ *  When the queue is threaded its thread calls Decoder::pass() repeatedly,
+ *  keeping the data from each pass in a queue until pass() is called on this
+ *  object, at which point the data are emitted from our signals.  position()
+ *  gives the position that the decoder had before the pass that will be emitted
+ *  next, so a user of several DecoderQueues sees things in the same order as it
+ *  would if it were using the decoders directly, but the decoding itself can
+ *  happen in parallel.
+ *
+ *  The decoder runs ahead of the data that have been emitted, so it cannot ask
+ *  the receivers of our signals whether they took video or audio data.
+ *  Instead, we ask the functions given to our constructor.
+ *
+ *  When the queue is not threaded, calls are passed straight through to the decoder.
+ */
+class DecoderQueue : public ExceptionStore, public boost::noncopyable
+{
+public:
+	DecoderQueue (
+		boost::shared_ptr<Decoder> decoder,
+		bool threaded,
+		boost::function<bool (ContentVideo)> video_taken,
+		boost::function<Frame (AudioStreamPtr, ContentAudio)> audio_accepted
+		);
+
+	~DecoderQueue ();
+
+	ContentTime position ();
+	bool pass ();
+	void seek (ContentTime time, bool accurate);
+	void stop ();
+
+	boost::signals2::signal<bool (ContentVideo)> Video;
+	boost::signals2::signal<Frame (AudioStreamPtr, ContentAudio)> Audio;
+	boost::signals2::signal<void (ContentImageSubtitle)> ImageSubtitleStart;
+	boost::signals2::signal<void (ContentTextSubtitle)> TextSubtitleStart;
+	boost::signals2::signal<void (ContentTime)> SubtitleStop;
+
+private:
+	/** The results of one call to Decoder::pass() */
+	struct Pass
+	{
+		Pass ()
+			: done (false)
+			, failed (false)
+		{}
+
+		/** decoder position before the pass */
+		ContentTime position;
+		/** signal emissions made by the pass */
+		std::list<boost::function<void ()> > emissions;
+		/** value returned by the pass */
+		bool done;
+		/** true if the pass threw an exception */
+		bool failed;
+	};
+
+	void start ();
+	void thread ();
+	bool video (ContentVideo video);
+	Frame audio (AudioStreamPtr stream, ContentAudio audio);
+	void image_subtitle_start (ContentImageSubtitle subtitle);
+	void text_subtitle_start (ContentTextSubtitle subtitle);
+	void subtitle_stop (ContentTime time);
+
+	boost::shared_ptr<Decoder> _decoder;
+	bool _threaded;
+	boost::function<bool (ContentVideo)> _video_taken;
+	boost::function<Frame (AudioStreamPtr, ContentAudio)> _audio_accepted;
+
+	boost::thread* _thread;
+	/** Pass that our thread is currently making; only used by that thread */
+	Pass* _current;
+
+	/** mutex to protect _passes, _finished and _stop */
+	boost::mutex _mutex;
+	boost::condition _summon;
+	boost::condition _arrived;
+	/** passes which are waiting to be emitted */
+	std::list<Pass> _passes;
+	/** true if the decoder has said that it is done, or has thrown an exception */
+	bool _finished;
+	bool _stop;
+
+	boost::signals2::scoped_connection _video_connection;
+	boost::signals2::scoped_connection _audio_connection;
+	boost::signals2::scoped_connection _image_subtitle_start_connection;
+	boost::signals2::scoped_connection _text_subtitle_start_connection;
+	boost::signals2::scoped_connection _subtitle_stop_connection;
+};
+
+#endif
@@ -34,6 +34,7 @@
 #include "compose.hpp"
 #include "log.h"
 #include "encoded_log_entry.h"
+#include "image_proxy.h"
 #include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
 #include <libxml++/libxml++.h>
@@ -51,9 +52,23 @@
 #define LOG_ERROR(...)      _log->log (String::compose (__VA_ARGS__), LogEntry::TYPE_ERROR);
 #define LOG_ERROR_NC(...)   _log->log (__VA_ARGS__, LogEntry::TYPE_ERROR);
 
+/** Number of threads to use for network I/O for each encoding thread */
+#define IO_THREADS_PER_WORKER_THREAD 2
+/** Maximum number of connections waiting to be read for each encoding thread; any more are refused */
+#define MAXIMUM_QUEUED_CONNECTIONS_PER_WORKER_THREAD 4
+/** Number of source images to keep for each encoding thread, so that masters need not send them again;
+ *  masters keep a couple of requests in flight for each of our threads, so this lets a cycle of
+ *  repeated frames that keeps all of them busy still hit the cache.
+ */
+#define IMAGE_CACHE_SIZE_PER_WORKER_THREAD 4
+/** Number of requests between reports of how well the source image cache is doing */
+#define IMAGE_CACHE_REPORT_INTERVAL 1000
+
 using std::string;
 using std::vector;
 using std::list;
+using std::pair;
+using std::make_pair;
 using std::cout;
 using std::cerr;
 using std::fixed;
@@ -71,6 +86,9 @@ EncodeServer::EncodeServer (shared_ptr<Log> log, bool verbose, int num_threads)
 	, _log (log)
 	, _verbose (verbose)
 	, _num_threads (num_threads)
+	, _busy (0)
+	, _image_cache_hits (0)
+	, _image_cache_requests (0)
 {
 
 }
@@ -81,7 +99,7 @@ EncodeServer::~EncodeServer ()
 		boost::mutex::scoped_lock lm (_mutex);
 		_terminate = true;
 		_empty_condition.notify_all ();
-		_full_condition.notify_all ();
+		_io_condition.notify_all ();
 	}
 
 	BOOST_FOREACH (boost::thread* i, _worker_threads) {
@@ -94,6 +112,13 @@ EncodeServer::~EncodeServer ()
 		delete i;
 	}
 
+	BOOST_FOREACH (boost::thread* i, _io_threads) {
+		if (i->joinable ()) {
+			i->join ();
+		}
+		delete i;
+	}
+
 	if (_broadcast.socket) {
 		_broadcast.socket->close ();
 	}
@@ -109,113 +134,238 @@ EncodeServer::~EncodeServer ()
 	}
 }
 
-/** @param after_read Filled in with gettimeofday() after reading the input from the network.
- *  @param after_encode Filled in with gettimeofday() after encoding the image.
+/** Read a request to encode a frame from a socket.
+ *  @return The request, or an empty optional if it could not be read.
  */
-int
-EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
+optional<EncodeServer::Request>
+EncodeServer::receive (shared_ptr<Socket> socket)
 {
-	uint32_t length = socket->read_uint32 ();
-	scoped_array<char> buffer (new char[length]);
-	socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
-
-	string s (buffer.get());
-	shared_ptr<cxml::Document> xml (new cxml::Document ("EncodingRequest"));
-	xml->read_string (s);
-	/* This is a double-check; the server shouldn't even be on the candidate list
-	   if it is the wrong version, but it doesn't hurt to make sure here.
-	*/
-	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
-		cerr << "Mismatched server/client versions\n";
-		LOG_ERROR_NC ("Mismatched server/client versions");
-		return -1;
-	}
+	Request request;
+	request.socket = socket;
+	gettimeofday (&request.start, 0);
 
-	shared_ptr<PlayerVideo> pvf (new PlayerVideo (xml, socket));
-
-	DCPVideo dcp_video_frame (pvf, xml, _log);
+	try {
+		/* Tell the master that we are ready for its request */
+		socket->write (ENCODE_SERVER_READY);
+
+		uint32_t length = socket->read_uint32 ();
+		scoped_array<char> buffer (new char[length]);
+		socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
+
+		string s (buffer.get());
+		shared_ptr<cxml::Document> xml (new cxml::Document ("EncodingRequest"));
+		xml->read_string (s);
+		/* This is a double-check; the server shouldn't even be on the candidate list
+		   if it is the wrong version, but it doesn't hurt to make sure here.
+		*/
+		if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
+			cerr << "Mismatched server/client versions\n";
+			LOG_ERROR_NC ("Mismatched server/client versions");
+			return optional<Request> ();
+		}
 
-	gettimeofday (&after_read, 0);
+		/* Tell the master whether it needs to send us the source image; it only sends
+		   a digest if it knows that we have a cache.
+		*/
+		optional<string> in_digest = xml->optional_string_child ("InDigest");
+		shared_ptr<const ImageProxy> in;
+		if (in_digest) {
+			in = cached_image (in_digest.get ());
+		}
+		socket->write (in ? 1 : 0);
+		if (!in) {
+			in = image_proxy_factory (xml->node_child ("In"), socket);
+			if (in_digest) {
+				add_cached_image (in_digest.get(), in);
+			}
+		}
 
-	Data encoded = dcp_video_frame.encode_locally (boost::bind (&Log::dcp_log, _log.get(), _1, _2));
+		shared_ptr<PlayerVideo> pvf (new PlayerVideo (xml, in, socket));
+		request.video.reset (new DCPVideo (pvf, xml, _log));
+		request.ip = socket->socket().remote_endpoint().address().to_string();
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		LOG_ERROR ("Error: %1", e.what());
+		return optional<Request> ();
+	}
 
-	gettimeofday (&after_encode, 0);
+	gettimeofday (&request.after_read, 0);
+	return request;
+}
 
+/** Send an encoded frame back to the client which asked for it, and log how long it all took */
+void
+EncodeServer::send (Request request)
+{
 	try {
-		socket->write (encoded.size());
-		socket->write (encoded.data().get(), encoded.size());
+		request.socket->write (request.encoded->size());
+		request.socket->write (request.encoded->data().get(), request.encoded->size());
 	} catch (std::exception& e) {
-		cerr << "Send failed; frame " << dcp_video_frame.index() << "\n";
-		LOG_ERROR ("Send failed; frame %1", dcp_video_frame.index());
-		throw;
+		cerr << "Send failed; frame " << request.video->index() << "\n";
+		LOG_ERROR ("Send failed; frame %1", request.video->index());
+		return;
+	}
+
+	struct timeval end;
+	gettimeofday (&end, 0);
+
+	shared_ptr<EncodedLogEntry> e (
+		new EncodedLogEntry (
+			request.video->index(), request.ip,
+			seconds(request.after_read) - seconds(request.start),
+			seconds(request.after_encode) - seconds(request.after_read),
+			seconds(end) - seconds(request.after_encode)
+			)
+		);
+
+	if (_verbose) {
+		cout << e->get() << "\n";
 	}
 
-	return dcp_video_frame.index ();
+	_log->log (e);
 }
 
+/** Record the time taken to encode a frame, so that we can tell masters how fast we are.
+ *  _mutex must be held by the caller.
+ */
 void
-EncodeServer::worker_thread ()
+EncodeServer::add_encode_time (Resolution resolution, double time)
+{
+	if (_encode_time[resolution]) {
+		_encode_time[resolution] = _encode_time[resolution].get() * 0.9 + time * 0.1;
+	} else {
+		_encode_time[resolution] = time;
+	}
+}
+
+/** Look for a source image in our cache, and keep a note of how often we find one.
+ *  @param digest Digest of the image, as given to us by the master.
+ *  @return Image, or 0 if we do not have it.
+ */
+shared_ptr<const ImageProxy>
+EncodeServer::cached_image (string digest)
+{
+	boost::mutex::scoped_lock lm (_image_cache_mutex);
+
+	++_image_cache_requests;
+
+	shared_ptr<const ImageProxy> image;
+	for (list<pair<string, shared_ptr<const ImageProxy> > >::iterator i = _image_cache.begin(); i != _image_cache.end(); ++i) {
+		if (i->first == digest) {
+			image = i->second;
+			++_image_cache_hits;
+			/* Move to the front as it is now the most recently used */
+			_image_cache.splice (_image_cache.begin(), _image_cache, i);
+			break;
+		}
+	}
+
+	if ((_image_cache_requests % IMAGE_CACHE_REPORT_INTERVAL) == 0) {
+		float const rate = float (_image_cache_hits) * 100 / _image_cache_requests;
+		LOG_GENERAL ("Source image cache hit rate %1%% over %2 frames", rate, _image_cache_requests);
+		if (_verbose) {
+			cout << "Source image cache hit rate " << rate << "% over " << _image_cache_requests << " frames.\n";
+		}
+	}
+
+	return image;
+}
+
+/** Add a source image which has just been sent to us to the cache, evicting the least
+ *  recently used image if the cache is full.
+ */
+void
+EncodeServer::add_cached_image (string digest, shared_ptr<const ImageProxy> image)
+{
+	boost::mutex::scoped_lock lm (_image_cache_mutex);
+
+	_image_cache.push_front (make_pair (digest, image));
+	while (int (_image_cache.size()) > _num_threads * IMAGE_CACHE_SIZE_PER_WORKER_THREAD) {
+		_image_cache.pop_back ();
+	}
+}
+
+/** Thread to do network I/O: send back encoded frames, and read new requests
+ *  when there is room for them in the queue of things to encode.  These threads
+ *  spend most of their time waiting for the network, which means that a slow link
+ *  to a client doesn't leave any of our encoding threads idle.
+ */
+void
+EncodeServer::io_thread ()
 {
 	while (true) {
 		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
-			_empty_condition.wait (lock);
+		while (
+			!_terminate &&
+			_replies.empty () &&
+			(_queue.empty () || _requests.size() >= _worker_threads.size() * 2)
+			) {
+			_io_condition.wait (lock);
 		}
 
 		if (_terminate) {
 			return;
 		}
 
-		shared_ptr<Socket> socket = _queue.front ();
-		_queue.pop_front ();
+		if (!_replies.empty ()) {
+			Request reply = _replies.front ();
+			_replies.pop_front ();
+			lock.unlock ();
+			send (reply);
+		} else {
+			shared_ptr<Socket> socket = _queue.front ();
+			_queue.pop_front ();
+			lock.unlock ();
+
+			optional<Request> request = receive (socket);
+			if (request) {
+				lock.lock ();
+				_requests.push_back (request.get ());
+				_empty_condition.notify_all ();
+			}
+		}
+	}
+}
 
-		lock.unlock ();
+/** Thread to encode requests which have been read by an io_thread() */
+void
+EncodeServer::worker_thread ()
+{
+	while (true) {
+		boost::mutex::scoped_lock lock (_mutex);
+		while (_requests.empty () && !_terminate) {
+			_empty_condition.wait (lock);
+		}
 
-		int frame = -1;
-		string ip;
+		if (_terminate) {
+			return;
+		}
 
-		struct timeval start;
-		struct timeval after_read;
-		struct timeval after_encode;
-		struct timeval end;
+		Request request = _requests.front ();
+		_requests.pop_front ();
+		++_busy;
+		/* There is room for another request now */
+		_io_condition.notify_all ();
 
-		gettimeofday (&start, 0);
+		lock.unlock ();
 
 		try {
-			frame = process (socket, after_read, after_encode);
-			ip = socket->socket().remote_endpoint().address().to_string();
+			request.encoded = request.video->encode_locally (boost::bind (&Log::dcp_log, _log.get(), _1, _2));
 		} catch (std::exception& e) {
 			cerr << "Error: " << e.what() << "\n";
 			LOG_ERROR ("Error: %1", e.what());
 		}
 
-		gettimeofday (&end, 0);
-
-		socket.reset ();
+		gettimeofday (&request.after_encode, 0);
 
 		lock.lock ();
+		--_busy;
 
-		if (frame >= 0) {
-			struct timeval end;
-			gettimeofday (&end, 0);
-
-			shared_ptr<EncodedLogEntry> e (
-				new EncodedLogEntry (
-					frame, ip,
-					seconds(after_read) - seconds(start),
-					seconds(after_encode) - seconds(after_read),
-					seconds(end) - seconds(after_encode)
-					)
-				);
-
-			if (_verbose) {
-				cout << e->get() << "\n";
-			}
-
-			_log->log (e);
+		if (request.encoded) {
+			add_encode_time (request.video->resolution(), seconds (request.after_encode) - seconds (request.after_read));
+			_replies.push_back (request);
+			_io_condition.notify_all ();
 		}
-
-		_full_condition.notify_all ();
 	}
 }
 
@@ -231,6 +381,10 @@ EncodeServer::run ()
 		_worker_threads.push_back (new thread (bind (&EncodeServer::worker_thread, this)));
 	}
 
+	for (int i = 0; i < _num_threads * IO_THREADS_PER_WORKER_THREAD; ++i) {
+		_io_threads.push_back (new thread (bind (&EncodeServer::io_thread, this)));
+	}
+
 	_broadcast.thread = new thread (bind (&EncodeServer::broadcast_thread, this));
 
 	Server::run ();
@@ -271,6 +425,25 @@ EncodeServer::broadcast_received ()
 		xmlpp::Element* root = doc.create_root_node ("ServerAvailable");
 		root->add_child("Threads")->add_child_text (raw_convert<string> (_worker_threads.size ()));
 		root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
+
+		/* Tell the master how fast and how busy we are, so that it can decide how
+		   much work to send us.
+		*/
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_encode_time[RESOLUTION_2K]) {
+				root->add_child("FramesPerSecond2K")->add_child_text (raw_convert<string> (_worker_threads.size() / _encode_time[RESOLUTION_2K].get()));
+			}
+			if (_encode_time[RESOLUTION_4K]) {
+				root->add_child("FramesPerSecond4K")->add_child_text (raw_convert<string> (_worker_threads.size() / _encode_time[RESOLUTION_4K].get()));
+			}
+			root->add_child("QueueLength")->add_child_text (raw_convert<string> (_queue.size() + _requests.size()));
+			root->add_child("Load")->add_child_text (raw_convert<string> (float (_busy) / _worker_threads.size ()));
+		}
+
+		/* Tell the master that it is worth sending us digests of its source images */
+		root->add_child("ImageCache")->add_child_text (raw_convert<string> (_num_threads * IMAGE_CACHE_SIZE_PER_WORKER_THREAD));
+
 		string xml = doc.write_to_string ("UTF-8");
 
 		if (_verbose) {
@@ -292,16 +465,31 @@ EncodeServer::broadcast_received ()
 		);
 }
 
+/** Called by the accept loop with a new connection; we queue it for an io_thread()
+ *  to read rather than blocking here.  If there are already too many connections
+ *  waiting we tell the master that we are busy and close the new one, so that it
+ *  can try again shortly or use another server.
+ */
 void
 EncodeServer::handle (shared_ptr<Socket> socket)
 {
 	boost::mutex::scoped_lock lock (_mutex);
 
-	/* Wait until the queue has gone down a bit */
-	while (_queue.size() >= _worker_threads.size() * 2 && !_terminate) {
-		_full_condition.wait (lock);
+	if (_queue.size() >= _worker_threads.size() * MAXIMUM_QUEUED_CONNECTIONS_PER_WORKER_THREAD) {
+		LOG_GENERAL ("Refusing connection with %1 already waiting", _queue.size());
+		if (_verbose) {
+			cout << "Refusing connection with " << _queue.size() << " already waiting\n";
+		}
+		lock.unlock ();
+		try {
+			/* This goes into an empty socket buffer so it will not hold up the accept loop */
+			socket->write (ENCODE_SERVER_BUSY);
+		} catch (...) {
+			/* The master will find out anyway when we close the connection */
+		}
+		return;
 	}
 
 	_queue.push_back (socket);
-	_empty_condition.notify_all ();
+	_io_condition.notify_all ();
 }
@@ -27,13 +27,18 @@
 
 #include "server.h"
 #include "exception_store.h"
+#include "types.h"
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
 #include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
+#include <dcp/data.h>
 #include <string>
 
 class Socket;
 class Log;
+class DCPVideo;
+class ImageProxy;
 
 /** @class EncodeServer
  *  @brief A class to run a server which can accept requests to perform JPEG2000
@@ -48,19 +53,64 @@ public:
 	void run ();
 
 private:
+	/** A request to encode a frame, which is passed from an io_thread() to a worker_thread()
+	 *  to be encoded, then back to an io_thread() to be sent back to the client.
+	 */
+	struct Request
+	{
+		boost::shared_ptr<Socket> socket;
+		boost::shared_ptr<DCPVideo> video;
+		boost::optional<dcp::Data> encoded;
+		/** address of the client */
+		std::string ip;
+		struct timeval start;
+		struct timeval after_read;
+		struct timeval after_encode;
+	};
+
 	void handle (boost::shared_ptr<Socket>);
 	void worker_thread ();
-	int process (boost::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	void io_thread ();
+	boost::optional<Request> receive (boost::shared_ptr<Socket> socket);
+	void send (Request request);
 	void broadcast_thread ();
 	void broadcast_received ();
+	void add_encode_time (Resolution resolution, double time);
+	boost::shared_ptr<const ImageProxy> cached_image (std::string digest);
+	void add_cached_image (std::string digest, boost::shared_ptr<const ImageProxy> image);
 
+	/** threads to encode frames */
 	std::vector<boost::thread *> _worker_threads;
+	/** threads to read requests and send replies */
+	std::vector<boost::thread *> _io_threads;
+	/** connections which have not yet been read */
 	std::list<boost::shared_ptr<Socket> > _queue;
-	boost::condition _full_condition;
+	/** requests which have been read and are waiting to be encoded */
+	std::list<Request> _requests;
+	/** encoded frames waiting to be sent back */
+	std::list<Request> _replies;
+	/** condition to wake worker threads when there is something to encode */
 	boost::condition _empty_condition;
+	/** condition to wake I/O threads when there is something to send, or room to read */
+	boost::condition _io_condition;
 	boost::shared_ptr<Log> _log;
 	bool _verbose;
 	int _num_threads;
+	/** number of worker threads which are currently busy; protected by _mutex */
+	int _busy;
+	/** recent mean time taken by one thread to encode a frame at each Resolution,
+	    in seconds; protected by _mutex
+	*/
+	boost::optional<double> _encode_time[2];
+	/** source images that we have recently been sent, with their digests, most recently
+	    used first; protected by _image_cache_mutex
+	*/
+	std::list<std::pair<std::string, boost::shared_ptr<const ImageProxy> > > _image_cache;
+	/** number of requests whose source image was in _image_cache; protected by _image_cache_mutex */
+	int _image_cache_hits;
+	/** number of requests which have looked in _image_cache; protected by _image_cache_mutex */
+	int _image_cache_requests;
+	boost::mutex _image_cache_mutex;
 
 	struct Broadcast {
 
@@ -21,6 +21,10 @@
 #ifndef DCPOMATIC_ENCODE_SERVER_DESCRIPTION_H
 #define DCPOMATIC_ENCODE_SERVER_DESCRIPTION_H
 
+#include "types.h"
+#include <boost/optional.hpp>
+#include <string>
+
 /** @class EncodeServerDescription
  *  @brief Class to describe a server to which we can send encoding work.
  */
@@ -30,6 +34,9 @@ public:
 	EncodeServerDescription ()
 		: _host_name ("")
 		, _threads (1)
+		, _queue_length (0)
+		, _load (0)
+		, _image_cache (false)
 	{}
 
 	/** @param h Server host name or IP address in string form.
@@ -38,6 +45,9 @@ public:
 	EncodeServerDescription (std::string h, int t)
 		: _host_name (h)
 		, _threads (t)
+		, _queue_length (0)
+		, _load (0)
+		, _image_cache (false)
 	{}
 
 	/* Default copy constructor is fine */
@@ -60,11 +70,56 @@ public:
 		_threads = t;
 	}
 
+	/** @return frames per second that the server has been measured to encode
+	 *  at the given resolution, if it is known.
+	 */
+	boost::optional<float> frames_per_second (Resolution r) const {
+		return _frames_per_second[r];
+	}
+
+	void set_frames_per_second (Resolution r, boost::optional<float> f) {
+		_frames_per_second[r] = f;
+	}
+
+	/** @return number of frames waiting to be encoded on the server when it last reported */
+	int queue_length () const {
+		return _queue_length;
+	}
+
+	void set_queue_length (int l) {
+		_queue_length = l;
+	}
+
+	/** @return proportion of the server's threads which were busy when it last reported */
+	float load () const {
+		return _load;
+	}
+
+	void set_load (float l) {
+		_load = l;
+	}
+
+	/** @return true if the server keeps a cache of source images, so that it is worth
+	 *  sending it a digest of each one.
+	 */
+	bool image_cache () const {
+		return _image_cache;
+	}
+
+	void set_image_cache (bool c) {
+		_image_cache = c;
+	}
+
 private:
 	/** server's host name */
 	std::string _host_name;
 	/** number of threads to use on the server */
 	int _threads;
+	/** measured encoding speed for each Resolution */
+	boost::optional<float> _frames_per_second[2];
+	int _queue_length;
+	float _load;
+	bool _image_cache;
 };
 
 #endif
@@ -128,10 +128,9 @@ try
 		/* Query our `definite' servers (if there are any) */
 		vector<string> servers = Config::instance()->servers ();
 		for (vector<string>::const_iterator i = servers.begin(); i != servers.end(); ++i) {
-			if (server_found (*i)) {
-				/* Don't bother asking a server that we already know about */
-				continue;
-			}
+			/* Ask servers that we already know about too, so that we hear about
+			   changes in their speed and load.
+			*/
 			try {
 				boost::asio::ip::udp::resolver resolver (io_service);
 				boost::asio::ip::udp::resolver::query query (*i, raw_convert<string> (HELLO_PORT));
@@ -200,28 +199,40 @@ EncodeServerFinder::handle_accept (boost::system::error_code ec, shared_ptr<Sock
 	xml->read_string (s);
 
 	string const ip = socket->socket().remote_endpoint().address().to_string ();
-	if (!server_found (ip) && xml->optional_number_child<int>("Version").get_value_or (0) == SERVER_LINK_VERSION) {
+	if (xml->optional_number_child<int>("Version").get_value_or (0) == SERVER_LINK_VERSION) {
 		EncodeServerDescription sd (ip, xml->number_child<int> ("Threads"));
+		sd.set_frames_per_second (RESOLUTION_2K, xml->optional_number_child<float> ("FramesPerSecond2K"));
+		sd.set_frames_per_second (RESOLUTION_4K, xml->optional_number_child<float> ("FramesPerSecond4K"));
+		sd.set_queue_length (xml->optional_number_child<int>("QueueLength").get_value_or (0));
+		sd.set_load (xml->optional_number_child<float>("Load").get_value_or (0));
+		sd.set_image_cache (xml->optional_number_child<int>("ImageCache").get_value_or (0) > 0);
+
+		bool changed = false;
 		{
 			boost::mutex::scoped_lock lm (_servers_mutex);
-			_servers.push_back (sd);
+			list<EncodeServerDescription>::iterator i = _servers.begin();
+			while (i != _servers.end() && i->host_name() != ip) {
+				++i;
+			}
+			if (i == _servers.end ()) {
+				_servers.push_back (sd);
+				changed = true;
+			} else {
+				/* We already know about this server; just update its details.  Changes in
+				   speed and load are picked up by J2KEncoder as it goes, so they do not
+				   count as a change to the list.
+				*/
+				changed = i->threads() != sd.threads();
+				*i = sd;
+			}
 		}
-		emit (boost::bind (boost::ref (ServersListChanged)));
-	}
-
-	start_accept ();
-}
 
-bool
-EncodeServerFinder::server_found (string ip) const
-{
-	boost::mutex::scoped_lock lm (_servers_mutex);
-	list<EncodeServerDescription>::const_iterator i = _servers.begin();
-	while (i != _servers.end() && i->host_name() != ip) {
-		++i;
+		if (changed) {
+			emit (boost::bind (boost::ref (ServersListChanged)));
+		}
 	}
 
-	return i != _servers.end ();
+	start_accept ();
 }
 
 EncodeServerFinder*
@@ -62,7 +62,6 @@ private:
 	void search_thread ();
 	void listen_thread ();
 
-	bool server_found (std::string) const;
 	void start_accept ();
 	void handle_accept (boost::system::error_code ec, boost::shared_ptr<Socket> socket);
 
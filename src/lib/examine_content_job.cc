@@ -18,22 +18,36 @@
 
 */
 
-#include <boost/filesystem.hpp>
 #include "examine_content_job.h"
 #include "log.h"
 #include "content.h"
 #include "film.h"
+#include "compose.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string.hpp>
 #include <iostream>
 
 #include "i18n.h"
 
 using std::string;
 using std::cout;
+using std::min;
+using std::max;
+using std::vector;
 using boost::shared_ptr;
 
 ExamineContentJob::ExamineContentJob (shared_ptr<const Film> film, shared_ptr<Content> c)
+	: Job (film)
+	, _next (0)
+{
+	_content.push_back (c);
+}
+
+ExamineContentJob::ExamineContentJob (shared_ptr<const Film> film, ContentList c)
 	: Job (film)
 	, _content (c)
+	, _next (0)
 {
 
 }
@@ -41,6 +55,10 @@ ExamineContentJob::ExamineContentJob (shared_ptr<const Film> film, shared_ptr<Co
 string
 ExamineContentJob::name () const
 {
+	if (_content.size() > 1) {
+		return String::compose (_("Examine %1 pieces of content"), _content.size());
+	}
+
 	return _("Examine content");
 }
 
@@ -53,7 +71,135 @@ ExamineContentJob::json_name () const
 void
 ExamineContentJob::run ()
 {
-	_content->examine (shared_from_this ());
+	if (_content.size() == 1) {
+		_content.front()->examine (shared_from_this ());
+		boost::mutex::scoped_lock lm (_mutex);
+		_done.assign (1, true);
+		_ok.assign (1, true);
+	} else {
+		examine_in_parallel ();
+	}
+
+	vector<string> errors;
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		errors = _errors;
+	}
+
+	if (!errors.empty ()) {
+		set_error (
+			String::compose (_("Could not examine %1 of %2 pieces of content"), errors.size(), _content.size()),
+			boost::algorithm::join (errors, "\n")
+			);
+		set_progress (1);
+		set_state (FINISHED_ERROR);
+		return;
+	}
+
 	set_progress (1);
 	set_state (FINISHED_OK);
 }
+
+/** Examine all our content using a pool of threads, each of which takes the
+ *  next piece of content which has not yet been examined.  The progress of
+ *  this job is the combined progress of all the examinations.
+ */
+void
+ExamineContentJob::examine_in_parallel ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_done.assign (_content.size(), false);
+		_ok.assign (_content.size(), false);
+	}
+
+	BOOST_FOREACH (shared_ptr<Content> i, _content) {
+		_children.push_back (shared_ptr<ExamineContentJob> (new ExamineContentJob (_film, i)));
+	}
+
+	boost::thread_group threads;
+	size_t const N = min (size_t (max (1U, boost::thread::hardware_concurrency ())), _content.size ());
+	for (size_t i = 0; i < N; ++i) {
+		threads.create_thread (boost::bind (&ExamineContentJob::examine_thread, this));
+	}
+
+	try {
+		while (true) {
+			float progress = 0;
+			bool all_done = true;
+
+			{
+				boost::mutex::scoped_lock lm (_mutex);
+				for (size_t i = 0; i < _children.size(); ++i) {
+					if (_done[i]) {
+						progress += 1;
+					} else {
+						all_done = false;
+						progress += _children[i]->progress().get_value_or (0);
+					}
+				}
+			}
+
+			if (all_done) {
+				break;
+			}
+
+			set_progress (progress / _children.size ());
+			boost::this_thread::sleep (boost::posix_time::milliseconds (250));
+		}
+	} catch (...) {
+		/* Probably we have been cancelled */
+		threads.interrupt_all ();
+		threads.join_all ();
+		throw;
+	}
+
+	threads.join_all ();
+}
+
+void
+ExamineContentJob::examine_thread ()
+{
+	while (true) {
+		size_t n;
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			if (_next >= _children.size ()) {
+				return;
+			}
+			n = _next++;
+		}
+
+		string error;
+		try {
+			_children[n]->run ();
+		} catch (boost::thread_interrupted &) {
+			throw;
+		} catch (std::exception& e) {
+			error = String::compose ("%1: %2", _content[n]->path_summary(), e.what());
+		} catch (...) {
+			error = String::compose (_("%1: unknown error"), _content[n]->path_summary());
+		}
+
+		boost::mutex::scoped_lock lm (_mutex);
+		_done[n] = true;
+		if (error.empty ()) {
+			_ok[n] = true;
+		} else {
+			_errors.push_back (error);
+		}
+	}
+}
+
+ContentList
+ExamineContentJob::examined () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	ContentList c;
+	for (size_t i = 0; i < _content.size(); ++i) {
+		if (i < _ok.size() && _ok[i]) {
+			c.push_back (_content[i]);
+		}
+	}
+	return c;
+}
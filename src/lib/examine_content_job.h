@@ -19,19 +19,46 @@
 */
 
 #include "job.h"
+#include "types.h"
 #include <boost/shared_ptr.hpp>
 
 class Content;
 
+/** @class ExamineContentJob
+ *  @brief A job to examine one or more pieces of content.
+ *
+ *  When given several pieces of content they are examined in parallel.
+ */
 class ExamineContentJob : public Job
 {
 public:
 	ExamineContentJob (boost::shared_ptr<const Film>, boost::shared_ptr<Content>);
+	ExamineContentJob (boost::shared_ptr<const Film>, ContentList);
 
 	std::string name () const;
 	std::string json_name () const;
 	void run ();
 
+	/** @return Content that was successfully examined, in the order that it was given to us */
+	ContentList examined () const;
+
 private:
-	boost::shared_ptr<Content> _content;
+	void examine_in_parallel ();
+	void examine_thread ();
+
+	ContentList _content;
+
+	/** Jobs which do the examination of each piece of content when we are examining several */
+	std::vector<boost::shared_ptr<ExamineContentJob> > _children;
+
+	/** mutex to protect _next, _done, _ok and _errors */
+	mutable boost::mutex _mutex;
+	/** Index of the next piece of _content to examine */
+	size_t _next;
+	/** true for each piece of _content whose examination has finished (successfully or not) */
+	std::vector<bool> _done;
+	/** true for each piece of _content which was examined successfully */
+	std::vector<bool> _ok;
+	/** Errors from any pieces of _content which could not be examined */
+	std::vector<std::string> _errors;
 };
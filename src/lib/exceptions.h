@@ -186,6 +186,18 @@ public:
 	{}
 };
 
+/** @class ServerBusyError
+ *  @brief Indicates that an encode server was too busy to take a frame; it may be
+ *  worth trying again soon.
+ */
+class ServerBusyError : public NetworkError
+{
+public:
+	ServerBusyError (std::string s)
+		: NetworkError (s)
+	{}
+};
+
 /** @class KDMError
  *  @brief A problem with a KDM.
  */
@@ -0,0 +1,445 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/fast_image_decoder.cc
+ *  @brief FastImageDecoder class.
+ */
+
+#include "fast_image_decoder.h"
+#include "image.h"
+#include <cstring>
+#include <iostream>
+
+using std::cout;
+using std::min;
+using boost::shared_ptr;
+using boost::optional;
+
+/* Values in the DPX image element header */
+#define DPX_DESCRIPTOR_RGB 50
+#define DPX_TRANSFER_PRINTING_DENSITY 1
+#define DPX_TRANSFER_LOGARITHMIC 3
+
+/* TIFF tags that we look at */
+#define TIFF_IMAGE_WIDTH 256
+#define TIFF_IMAGE_LENGTH 257
+#define TIFF_BITS_PER_SAMPLE 258
+#define TIFF_COMPRESSION 259
+#define TIFF_PHOTOMETRIC_INTERPRETATION 262
+#define TIFF_STRIP_OFFSETS 273
+#define TIFF_ORIENTATION 274
+#define TIFF_SAMPLES_PER_PIXEL 277
+#define TIFF_ROWS_PER_STRIP 278
+#define TIFF_PLANAR_CONFIGURATION 284
+
+FastImageDecoder::FastImageDecoder (uint8_t const * data, size_t size)
+	: _data (data)
+	, _size_in_bytes (size)
+	, _big_endian (false)
+	, _ok (false)
+	, _type (DPX_16)
+	, _rows_per_strip (0)
+	, _row_stride (0)
+{
+	if (size < 4) {
+		return;
+	}
+
+	if (memcmp (data, "SDPX", 4) == 0 || memcmp (data, "XPDS", 4) == 0) {
+		parse_dpx ();
+	} else if (memcmp (data, "II*\0", 4) == 0 || memcmp (data, "MM\0*", 4) == 0) {
+		parse_tiff ();
+	}
+}
+
+uint16_t
+FastImageDecoder::get_16 (size_t offset) const
+{
+	uint8_t const * p = _data + offset;
+	if (_big_endian) {
+		return (p[0] << 8) | p[1];
+	}
+	return p[0] | (p[1] << 8);
+}
+
+uint32_t
+FastImageDecoder::get_32 (size_t offset) const
+{
+	uint8_t const * p = _data + offset;
+	if (_big_endian) {
+		return (uint32_t (p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	}
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t (p[3]) << 24);
+}
+
+void
+FastImageDecoder::parse_dpx ()
+{
+	/* We need the file header and the first image element header */
+	if (_size_in_bytes < 816) {
+		return;
+	}
+
+	_big_endian = _data[0] == 'S';
+
+	uint32_t data_offset = get_32 (4);
+	uint16_t const orientation = get_16 (768);
+	uint16_t const elements = get_16 (770);
+	uint32_t const width = get_32 (772);
+	uint32_t const height = get_32 (776);
+
+	if (width == 0 || width > 65536 || height == 0 || height > 65536) {
+		return;
+	}
+
+	_size = dcp::Size (width, height);
+
+	uint8_t const descriptor = _data[800];
+	uint8_t const transfer = _data[801];
+	uint8_t const bit_depth = _data[803];
+	uint16_t const packing = get_16 (804);
+	uint16_t const encoding = get_16 (806);
+	uint32_t const element_offset = get_32 (808);
+	uint32_t eol_padding = get_32 (812);
+
+	/* Printing density and logarithmic files are treated as log by ImageMagick, and MagickImageProxy
+	   has special handling of their colour spaces, so leave them to it to be sure of getting the same
+	   answer.
+	*/
+	if (
+		orientation != 0 ||
+		elements < 1 ||
+		descriptor != DPX_DESCRIPTOR_RGB ||
+		transfer == DPX_TRANSFER_PRINTING_DENSITY ||
+		transfer == DPX_TRANSFER_LOGARITHMIC ||
+		encoding != 0
+		) {
+		return;
+	}
+
+	if (element_offset != 0 && element_offset != 0xffffffff) {
+		data_offset = element_offset;
+	}
+
+	if (eol_padding == 0xffffffff) {
+		eol_padding = 0;
+	}
+
+	int bytes_per_pixel = 0;
+	if (bit_depth == 10 && packing == 1) {
+		_type = DPX_10_FILLED_A;
+		bytes_per_pixel = 4;
+	} else if (bit_depth == 10 && packing == 2) {
+		_type = DPX_10_FILLED_B;
+		bytes_per_pixel = 4;
+	} else if (bit_depth == 16 && (width % 2) == 0) {
+		/* With an odd width the lines may or may not be padded, depending on the packing */
+		_type = DPX_16;
+		bytes_per_pixel = 6;
+	} else {
+		return;
+	}
+
+	_row_stride = width * bytes_per_pixel + eol_padding;
+	_rows_per_strip = height;
+	_strip_offsets.push_back (data_offset);
+
+	if ((uint64_t (data_offset) + uint64_t (_row_stride) * (height - 1) + width * bytes_per_pixel) > _size_in_bytes) {
+		return;
+	}
+
+	_ok = true;
+}
+
+/** @param entry Offset of a TIFF IFD entry.
+ *  @param index Index of the value within the entry.
+ *  @return Value, or an empty optional if the entry has no such value or it is of a type that we don't handle.
+ */
+optional<uint32_t>
+FastImageDecoder::tiff_value (size_t entry, uint32_t index) const
+{
+	uint16_t const type = get_16 (entry + 2);
+	uint32_t const count = get_32 (entry + 4);
+	if (index >= count) {
+		return optional<uint32_t> ();
+	}
+
+	int size = 0;
+	switch (type) {
+	case 1:
+		/* BYTE */
+		size = 1;
+		break;
+	case 3:
+		/* SHORT */
+		size = 2;
+		break;
+	case 4:
+		/* LONG */
+		size = 4;
+		break;
+	default:
+		return optional<uint32_t> ();
+	}
+
+	/* Values are stored in the entry itself if they fit */
+	uint64_t position = (uint64_t (count) * size) <= 4 ? (entry + 8) : get_32 (entry + 8);
+	position += uint64_t (index) * size;
+	if ((position + size) > _size_in_bytes) {
+		return optional<uint32_t> ();
+	}
+
+	switch (size) {
+	case 1:
+		return uint32_t (_data[position]);
+	case 2:
+		return uint32_t (get_16 (position));
+	default:
+		return get_32 (position);
+	}
+}
+
+void
+FastImageDecoder::parse_tiff ()
+{
+	if (_size_in_bytes < 8) {
+		return;
+	}
+
+	_big_endian = _data[0] == 'M';
+
+	uint32_t const ifd = get_32 (4);
+	if ((uint64_t (ifd) + 2) > _size_in_bytes) {
+		return;
+	}
+
+	uint16_t const entries = get_16 (ifd);
+	if ((uint64_t (ifd) + 2 + entries * 12) > _size_in_bytes) {
+		return;
+	}
+
+	/* Defaults for things which may not be specified */
+	optional<uint32_t> width;
+	optional<uint32_t> height;
+	uint32_t bits = 1;
+	bool bits_consistent = true;
+	uint32_t compression = 1;
+	optional<uint32_t> photometric;
+	uint32_t orientation = 1;
+	uint32_t samples_per_pixel = 1;
+	optional<uint32_t> rows_per_strip;
+	uint32_t planar_configuration = 1;
+
+	for (uint16_t i = 0; i < entries; ++i) {
+		size_t const entry = ifd + 2 + i * 12;
+		uint16_t const tag = get_16 (entry);
+		optional<uint32_t> const value = tiff_value (entry, 0);
+		if (!value) {
+			continue;
+		}
+
+		switch (tag) {
+		case TIFF_IMAGE_WIDTH:
+			width = *value;
+			break;
+		case TIFF_IMAGE_LENGTH:
+			height = *value;
+			break;
+		case TIFF_BITS_PER_SAMPLE:
+		{
+			bits = *value;
+			uint32_t const count = get_32 (entry + 4);
+			for (uint32_t j = 1; j < count; ++j) {
+				if (tiff_value (entry, j).get_value_or (0) != bits) {
+					bits_consistent = false;
+				}
+			}
+			break;
+		}
+		case TIFF_COMPRESSION:
+			compression = *value;
+			break;
+		case TIFF_PHOTOMETRIC_INTERPRETATION:
+			photometric = *value;
+			break;
+		case TIFF_STRIP_OFFSETS:
+		{
+			uint32_t const count = get_32 (entry + 4);
+			for (uint32_t j = 0; j < count; ++j) {
+				optional<uint32_t> offset = tiff_value (entry, j);
+				if (!offset) {
+					return;
+				}
+				_strip_offsets.push_back (*offset);
+			}
+			break;
+		}
+		case TIFF_ORIENTATION:
+			orientation = *value;
+			break;
+		case TIFF_SAMPLES_PER_PIXEL:
+			samples_per_pixel = *value;
+			break;
+		case TIFF_ROWS_PER_STRIP:
+			rows_per_strip = *value;
+			break;
+		case TIFF_PLANAR_CONFIGURATION:
+			planar_configuration = *value;
+			break;
+		}
+	}
+
+	if (!width || !height || *width == 0 || *width > 65536 || *height == 0 || *height > 65536) {
+		return;
+	}
+
+	_size = dcp::Size (*width, *height);
+
+	/* We only handle uncompressed, chunky, top-left-origin RGB */
+	if (compression != 1 || !photometric || *photometric != 2 || orientation != 1 || samples_per_pixel != 3 || planar_configuration != 1 || !bits_consistent) {
+		return;
+	}
+
+	if (bits == 8) {
+		_type = TIFF_8;
+	} else if (bits == 16) {
+		_type = TIFF_16;
+	} else {
+		return;
+	}
+
+	_row_stride = *width * 3 * bits / 8;
+	_rows_per_strip = min (rows_per_strip.get_value_or (*height), *height);
+	if (_rows_per_strip == 0) {
+		return;
+	}
+
+	/* Check that all the image data that we need is there */
+	size_t const strips = (*height + _rows_per_strip - 1) / _rows_per_strip;
+	if (_strip_offsets.size() < strips) {
+		return;
+	}
+
+	for (size_t i = 0; i < strips; ++i) {
+		uint32_t const rows = min (uint32_t (_rows_per_strip), uint32_t (*height - i * _rows_per_strip));
+		if ((uint64_t (_strip_offsets[i]) + uint64_t (_row_stride) * rows) > _size_in_bytes) {
+			return;
+		}
+	}
+
+	_ok = true;
+}
+
+/* The unpacking functions below are kept free of branches in their inner loops,
+   with the endianness as a template parameter, so that the compiler can vectorise them.
+*/
+
+/** Expand a 10-bit value to 16 bits */
+static inline uint16_t
+expand_10 (uint32_t v)
+{
+	return (v << 6) | (v >> 4);
+}
+
+/** Unpack a line of 10-bit DPX data where each pixel is in a 32-bit word.
+ *  @param shift 2 for packing method A (padding in the least significant bits), 0 for method B.
+ */
+template <bool big_endian>
+static void
+unpack_dpx_10 (uint8_t const * in, uint16_t* out, int width, int shift)
+{
+	for (int x = 0; x < width; ++x) {
+		uint32_t const w = big_endian ?
+			((uint32_t (in[0]) << 24) | (in[1] << 16) | (in[2] << 8) | in[3]) :
+			(in[0] | (in[1] << 8) | (in[2] << 16) | (uint32_t (in[3]) << 24));
+
+		out[0] = expand_10 ((w >> (20 + shift)) & 0x3ff);
+		out[1] = expand_10 ((w >> (10 + shift)) & 0x3ff);
+		out[2] = expand_10 ((w >> shift) & 0x3ff);
+
+		in += 4;
+		out += 3;
+	}
+}
+
+template <bool big_endian>
+static void
+unpack_16 (uint8_t const * in, uint16_t* out, int samples)
+{
+	for (int i = 0; i < samples; ++i) {
+		out[i] = big_endian ? ((in[i * 2] << 8) | in[i * 2 + 1]) : (in[i * 2] | (in[i * 2 + 1] << 8));
+	}
+}
+
+static void
+unpack_8 (uint8_t const * in, uint16_t* out, int samples)
+{
+	for (int i = 0; i < samples; ++i) {
+		out[i] = in[i] * 257;
+	}
+}
+
+/** @return Decoded image in AV_PIX_FMT_RGB48LE, or 0 if ok() is false */
+shared_ptr<Image>
+FastImageDecoder::decode () const
+{
+	if (!_ok) {
+		return shared_ptr<Image> ();
+	}
+
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, *_size, true));
+
+	int const width = _size->width;
+
+	for (int y = 0; y < _size->height; ++y) {
+		uint8_t const * in = _data + _strip_offsets[y / _rows_per_strip] + (y % _rows_per_strip) * _row_stride;
+		uint16_t* out = reinterpret_cast<uint16_t*> (image->data()[0] + y * image->stride()[0]);
+
+		switch (_type) {
+		case DPX_10_FILLED_A:
+			if (_big_endian) {
+				unpack_dpx_10<true> (in, out, width, 2);
+			} else {
+				unpack_dpx_10<false> (in, out, width, 2);
+			}
+			break;
+		case DPX_10_FILLED_B:
+			if (_big_endian) {
+				unpack_dpx_10<true> (in, out, width, 0);
+			} else {
+				unpack_dpx_10<false> (in, out, width, 0);
+			}
+			break;
+		case DPX_16:
+		case TIFF_16:
+			if (_big_endian) {
+				unpack_16<true> (in, out, width * 3);
+			} else {
+				unpack_16<false> (in, out, width * 3);
+			}
+			break;
+		case TIFF_8:
+			unpack_8 (in, out, width * 3);
+			break;
+		}
+	}
+
+	return image;
+}
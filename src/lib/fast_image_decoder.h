@@ -0,0 +1,92 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/fast_image_decoder.h
+ *  @brief FastImageDecoder class.
+ */
+
+#ifndef DCPOMATIC_FAST_IMAGE_DECODER_H
+#define DCPOMATIC_FAST_IMAGE_DECODER_H
+
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+#include <vector>
+
+class Image;
+
+/** @class FastImageDecoder
+ *  @brief Decoder for uncompressed DPX and baseline TIFF images which does not use ImageMagick.
+ *
+ *  Only the simple (but common) variants of these formats are handled;
+ *  ok() says whether some data can be decoded here, and if not the caller
+ *  should fall back to ImageMagick.  Images are returned as RGB48LE so that
+ *  no precision is lost from 10- and 16-bit files.
+ */
+class FastImageDecoder
+{
+public:
+	FastImageDecoder (uint8_t const * data, size_t size);
+
+	/** @return true if we can decode this data */
+	bool ok () const {
+		return _ok;
+	}
+
+	/** @return Size of the image, if it could be found from the header
+	 *  (which may be the case even if ok() is false).
+	 */
+	boost::optional<dcp::Size> size () const {
+		return _size;
+	}
+
+	boost::shared_ptr<Image> decode () const;
+
+private:
+	enum Type {
+		DPX_10_FILLED_A,
+		DPX_10_FILLED_B,
+		DPX_16,
+		TIFF_8,
+		TIFF_16
+	};
+
+	void parse_dpx ();
+	void parse_tiff ();
+	uint16_t get_16 (size_t offset) const;
+	uint32_t get_32 (size_t offset) const;
+	boost::optional<uint32_t> tiff_value (size_t entry, uint32_t index) const;
+
+	uint8_t const * _data;
+	size_t _size_in_bytes;
+	bool _big_endian;
+
+	bool _ok;
+	boost::optional<dcp::Size> _size;
+	Type _type;
+	/** Offset of the start of each strip of image data (for DPX there is just one) */
+	std::vector<uint32_t> _strip_offsets;
+	/** Number of rows in each strip */
+	int _rows_per_strip;
+	/** Number of bytes between the start of one row and the next */
+	int _row_stride;
+};
+
+#endif
@@ -54,7 +54,7 @@ boost::weak_ptr<Log> FFmpeg::_ffmpeg_log;
 FFmpeg::FFmpeg (boost::shared_ptr<const FFmpegContent> c)
 	: _ffmpeg_content (c)
 	, _avio_buffer (0)
-	, _avio_buffer_size (4096)
+	, _avio_buffer_size (65536)
 	, _avio_context (0)
 	, _format_context (0)
 	, _frame (0)
@@ -23,19 +23,41 @@
  */
 
 #include <cstdio>
+#include <cstring>
 #include <sndfile.h>
 #include "file_group.h"
 #include "exceptions.h"
 #include "cross.h"
+#include "dcpomatic_assert.h"
+#ifdef DCPOMATIC_LINUX
+#include <fcntl.h>
+#endif
+#include <sys/time.h>
 #include <iostream>
 
 using std::vector;
+using std::min;
 using std::cout;
 
+/** Size of the buffer that we read into from the underlying files */
+int const FileGroup::default_buffer_size = 1024 * 1024;
+
+/** Number of buffers-worth of data beyond the current position that we
+ *  ask the operating system to start fetching in the background.
+ */
+static int const read_ahead_buffers = 4;
+
 /** Construct a FileGroup with no files */
 FileGroup::FileGroup ()
 	: _current_path (0)
 	, _current_file (0)
+	, _file_position (0)
+	, _buffer (default_buffer_size)
+	, _buffer_position (0)
+	, _buffer_fill (0)
+	, _position (0)
+	, _bytes_read (0)
+	, _read_time (0)
 {
 
 }
@@ -44,20 +66,32 @@ FileGroup::FileGroup ()
 FileGroup::FileGroup (boost::filesystem::path p)
 	: _current_path (0)
 	, _current_file (0)
+	, _file_position (0)
+	, _buffer (default_buffer_size)
+	, _buffer_position (0)
+	, _buffer_fill (0)
+	, _position (0)
+	, _bytes_read (0)
+	, _read_time (0)
 {
-	_paths.push_back (p);
-	ensure_open_path (0);
-	seek (0, SEEK_SET);
+	vector<boost::filesystem::path> paths;
+	paths.push_back (p);
+	set_paths (paths);
 }
 
 /** Construct a FileGroup with multiple files */
 FileGroup::FileGroup (vector<boost::filesystem::path> const & p)
-	: _paths (p)
-	, _current_path (0)
+	: _current_path (0)
 	, _current_file (0)
+	, _file_position (0)
+	, _buffer (default_buffer_size)
+	, _buffer_position (0)
+	, _buffer_fill (0)
+	, _position (0)
+	, _bytes_read (0)
+	, _read_time (0)
 {
-	ensure_open_path (0);
-	seek (0, SEEK_SET);
+	set_paths (p);
 }
 
 /** Destroy a FileGroup, closing any open file */
@@ -71,9 +105,40 @@ FileGroup::~FileGroup ()
 void
 FileGroup::set_paths (vector<boost::filesystem::path> const & p)
 {
+	if (_current_file) {
+		fclose (_current_file);
+		_current_file = 0;
+	}
+
 	_paths = p;
-	ensure_open_path (0);
-	seek (0, SEEK_SET);
+
+	/* Find the lengths once here so that we don't need to stat the files
+	   (which can be slow on network filesystems) every time we seek.
+	*/
+	_lengths.clear ();
+	for (vector<boost::filesystem::path>::const_iterator i = _paths.begin(); i != _paths.end(); ++i) {
+		_lengths.push_back (boost::filesystem::file_size (*i));
+	}
+
+	_buffer_position = 0;
+	_buffer_fill = 0;
+
+	if (!_paths.empty ()) {
+		ensure_open_path (0);
+	}
+	_position = 0;
+}
+
+/** Set the size of the buffer that is used to read from the files.  Larger
+ *  sizes mean fewer (but larger) requests to the filesystem.
+ *  @param size New buffer size in bytes.
+ */
+void
+FileGroup::set_buffer_size (int size)
+{
+	DCPOMATIC_ASSERT (size > 0);
+	_buffer.resize (size);
+	_buffer_fill = 0;
 }
 
 /** Ensure that the given path index in the content is the _current_file */
@@ -94,6 +159,19 @@ FileGroup::ensure_open_path (size_t p) const
 	if (_current_file == 0) {
 		throw OpenFileError (_paths[_current_path], errno, true);
 	}
+
+	/* We do our own buffering */
+	setvbuf (_current_file, 0, _IONBF, 0);
+
+#ifdef DCPOMATIC_LINUX
+	/* Encourage the kernel to use a large read-ahead window for this file */
+	posix_fadvise (fileno (_current_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	_file_position = 0;
+	for (size_t i = 0; i < _current_path; ++i) {
+		_file_position += _lengths[i];
+	}
 }
 
 int64_t
@@ -108,39 +186,21 @@ FileGroup::seek (int64_t pos, int whence) const
 		full_pos = pos;
 		break;
 	case SEEK_CUR:
-		for (size_t i = 0; i < _current_path; ++i) {
-			full_pos += boost::filesystem::file_size (_paths[i]);
-		}
-#ifdef DCPOMATIC_WINDOWS
-		full_pos += _ftelli64 (_current_file);
-#else
-		full_pos += ftell (_current_file);
-#endif
-		full_pos += pos;
+		full_pos = _position + pos;
 		break;
 	case SEEK_END:
 		full_pos = length() - pos;
 		break;
 	}
 
-	/* Seek to full_pos */
-	size_t i = 0;
-	int64_t sub_pos = full_pos;
-	while (i < _paths.size ()) {
-		boost::uintmax_t len = boost::filesystem::file_size (_paths[i]);
-		if (sub_pos < int64_t (len)) {
-			break;
-		}
-		sub_pos -= len;
-		++i;
-	}
-
-	if (i == _paths.size ()) {
+	if (full_pos < 0 || full_pos >= length()) {
 		return -1;
 	}
 
-	ensure_open_path (i);
-	dcpomatic_fseek (_current_file, sub_pos, SEEK_SET);
+	/* The underlying file is only moved when we next need to read from it,
+	   and not at all if the data is already in our buffer.
+	*/
+	_position = full_pos;
 	return full_pos;
 }
 
@@ -152,10 +212,81 @@ FileGroup::seek (int64_t pos, int whence) const
 int
 FileGroup::read (uint8_t* buffer, int amount) const
 {
+	int done = 0;
+	while (done < amount) {
+		if (_position >= _buffer_position && _position < (_buffer_position + _buffer_fill)) {
+			/* Some or all of what we want is in the buffer */
+			int const offset = _position - _buffer_position;
+			int const this_time = min (amount - done, _buffer_fill - offset);
+			memcpy (buffer + done, &_buffer[offset], this_time);
+			done += this_time;
+			_position += this_time;
+			continue;
+		}
+
+		if ((amount - done) >= int (_buffer.size ())) {
+			/* This is bigger than our buffer so there's no point in going through it */
+			int const this_time = read_from_files (buffer + done, amount - done);
+			done += this_time;
+			_position += this_time;
+			break;
+		}
+
+		fill_buffer ();
+		if (_buffer_fill == 0) {
+			/* End of the files */
+			break;
+		}
+	}
+
+	return done;
+}
+
+/** Refill _buffer with data from _position */
+void
+FileGroup::fill_buffer () const
+{
+	_buffer_position = _position;
+	_buffer_fill = read_from_files (&_buffer[0], _buffer.size ());
+	hint_read_ahead ();
+}
+
+/** Read from the files, starting at _position, straight into a buffer.
+ *  Does not change _position.
+ *  @return Number of bytes read.
+ */
+int
+FileGroup::read_from_files (uint8_t* buffer, int amount) const
+{
+	if (_file_position != _position) {
+		/* Find the file that contains _position and move to the right place in it */
+		size_t i = 0;
+		int64_t sub_pos = _position;
+		while (i < _paths.size() && sub_pos >= _lengths[i]) {
+			sub_pos -= _lengths[i];
+			++i;
+		}
+
+		if (i == _paths.size ()) {
+			return 0;
+		}
+
+		ensure_open_path (i);
+		dcpomatic_fseek (_current_file, sub_pos, SEEK_SET);
+		_file_position = _position;
+	}
+
+	struct timeval start;
+	gettimeofday (&start, 0);
+
 	int read = 0;
 	while (true) {
 		int const this_time = fread (buffer + read, 1, amount - read, _current_file);
 		read += this_time;
+		/* ensure_open_path resets _file_position to the start of the next file, so
+		   this must be kept up to date as we go.
+		*/
+		_file_position += this_time;
 		if (read == amount) {
 			/* Done */
 			break;
@@ -168,17 +299,62 @@ FileGroup::read (uint8_t* buffer, int amount) const
 		ensure_open_path (_current_path + 1);
 	}
 
+	struct timeval end;
+	gettimeofday (&end, 0);
+
+	_bytes_read += read;
+	_read_time += (end.tv_sec - start.tv_sec) + double (end.tv_usec - start.tv_usec) / 1e6;
+
 	return read;
 }
 
+/** Tell the operating system that we are likely to want the data after
+ *  the current file position soon, so that it can fetch it in the background
+ *  while our caller processes what we have already read.
+ */
+void
+FileGroup::hint_read_ahead () const
+{
+#ifdef DCPOMATIC_LINUX
+	if (!_current_file) {
+		return;
+	}
+
+	int64_t path_start = 0;
+	for (size_t i = 0; i < _current_path; ++i) {
+		path_start += _lengths[i];
+	}
+
+	posix_fadvise (
+		fileno (_current_file),
+		_file_position - path_start,
+		int64_t (_buffer.size ()) * read_ahead_buffers,
+		POSIX_FADV_WILLNEED
+		);
+#endif
+}
+
 /** @return Combined length of all the files */
 int64_t
 FileGroup::length () const
 {
 	int64_t len = 0;
-	for (size_t i = 0; i < _paths.size(); ++i) {
-		len += boost::filesystem::file_size (_paths[i]);
+	for (size_t i = 0; i < _lengths.size(); ++i) {
+		len += _lengths[i];
 	}
 
 	return len;
 }
+
+/** @return Average rate at which data has been read from the underlying files,
+ *  in bytes per second, or 0 if nothing has been read yet.
+ */
+double
+FileGroup::read_rate () const
+{
+	if (_read_time == 0) {
+		return 0;
+	}
+
+	return _bytes_read / _read_time;
+}
@@ -30,6 +30,11 @@
 
 /** @class FileGroup
  *  @brief A class to make a list of files behave like they were concatenated.
+ *
+ *  Reads are served from an internal buffer which is refilled with large
+ *  reads from the underlying files, so that callers which make lots of small
+ *  reads (such as FFmpeg's AVIO) do not turn into lots of small requests to
+ *  the filesystem.  This matters a lot when the files are on network storage.
  */
 class FileGroup
 {
@@ -40,18 +45,51 @@ public:
 	~FileGroup ();
 
 	void set_paths (std::vector<boost::filesystem::path> const &);
+	void set_buffer_size (int);
 
 	int64_t seek (int64_t, int) const;
 	int read (uint8_t*, int) const;
 	int64_t length () const;
 
+	/** @return Number of bytes that have been read from the underlying files */
+	int64_t bytes_read () const {
+		return _bytes_read;
+	}
+
+	/** @return Time spent reading from the underlying files, in seconds */
+	double read_time () const {
+		return _read_time;
+	}
+
+	double read_rate () const;
+
+	static int const default_buffer_size;
+
 private:
 	void ensure_open_path (size_t) const;
+	int read_from_files (uint8_t*, int) const;
+	void fill_buffer () const;
+	void hint_read_ahead () const;
 
 	std::vector<boost::filesystem::path> _paths;
+	/** Lengths of each of _paths, in bytes */
+	std::vector<int64_t> _lengths;
 	/** Index of path that we are currently reading from */
 	mutable size_t _current_path;
 	mutable FILE* _current_file;
+	/** Position of _current_file, as an offset from the start of all the files */
+	mutable int64_t _file_position;
+
+	mutable std::vector<uint8_t> _buffer;
+	/** Position of the first byte in _buffer, as an offset from the start of all the files */
+	mutable int64_t _buffer_position;
+	/** Number of valid bytes in _buffer */
+	mutable int _buffer_fill;
+	/** Our read position, as an offset from the start of all the files */
+	mutable int64_t _position;
+
+	mutable int64_t _bytes_read;
+	mutable double _read_time;
 };
 
 #endif
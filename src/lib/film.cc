@@ -152,6 +152,8 @@ Film::Film (optional<boost::filesystem::path> dir)
 	, _reel_type (REELTYPE_SINGLE)
 	, _reel_length (2000000000)
 	, _upload_after_make_dcp (false)
+	, _draft (false)
+	, _draft_half_resolution (false)
 	, _state_version (current_state_version)
 	, _dirty (false)
 {
@@ -231,6 +233,13 @@ Film::video_identifier () const
 		s += "_3D";
 	}
 
+	if (_draft) {
+		s += "_Draft";
+		if (_draft_half_resolution) {
+			s += "_Half";
+		}
+	}
+
 	return s;
 }
 
@@ -269,7 +278,12 @@ Film::audio_analysis_path (shared_ptr<const Playlist> playlist) const
 
 		digester.add (i->digest ());
 		digester.add (i->audio->mapping().digest ());
+		digester.add (i->trim_start().get ());
+		digester.add (i->trim_end().get ());
+		digester.add (i->audio->delay ());
 		if (playlist->content().size() != 1) {
+			/* The analysis of a playlist with several pieces of content depends on where they are */
+			digester.add (i->position().get ());
 			/* Analyses should be considered equal regardless of gain
 			   if they were made from just one piece of content.  This
 			   is because we can fake any gain change in a single-content
@@ -392,6 +406,12 @@ Film::metadata (bool with_content_paths) const
 	root->add_child("ReelType")->add_child_text (raw_convert<string> (static_cast<int> (_reel_type)));
 	root->add_child("ReelLength")->add_child_text (raw_convert<string> (_reel_length));
 	root->add_child("UploadAfterMakeDCP")->add_child_text (_upload_after_make_dcp ? "1" : "0");
+	if (_draft) {
+		root->add_child("Draft")->add_child_text ("1");
+	}
+	if (_draft_half_resolution) {
+		root->add_child("DraftHalfResolution")->add_child_text ("1");
+	}
 	_playlist->as_xml (root->add_child ("Playlist"), with_content_paths);
 
 	return doc;
@@ -499,6 +519,8 @@ Film::read_metadata (optional<boost::filesystem::path> path)
 	_reel_type = static_cast<ReelType> (f.optional_number_child<int>("ReelType").get_value_or (static_cast<int>(REELTYPE_SINGLE)));
 	_reel_length = f.optional_number_child<int64_t>("ReelLength").get_value_or (2000000000);
 	_upload_after_make_dcp = f.optional_bool_child("UploadAfterMakeDCP").get_value_or (false);
+	_draft = f.optional_bool_child("Draft").get_value_or (false);
+	_draft_half_resolution = f.optional_bool_child("DraftHalfResolution").get_value_or (false);
 
 	list<string> notes;
 	/* This method is the only one that can return notes (so far) */
@@ -635,6 +657,10 @@ Film::isdcf_name (bool if_created_now) const
 		d += "-Temp";
 	}
 
+	if (_draft) {
+		d += "-Draft";
+	}
+
 	if (dm.pre_release) {
 		d += "-Pre";
 	}
@@ -788,6 +814,10 @@ Film::dcp_name (bool if_created_now) const
 		return careful_string_filter (isdcf_name (if_created_now));
 	}
 
+	if (_draft) {
+		return careful_string_filter (name () + "_Draft");
+	}
+
 	return careful_string_filter (name ());
 }
 
@@ -910,6 +940,20 @@ Film::set_upload_after_make_dcp (bool u)
 	signal_changed (UPLOAD_AFTER_MAKE_DCP);
 }
 
+void
+Film::set_draft (bool d)
+{
+	_draft = d;
+	signal_changed (DRAFT);
+}
+
+void
+Film::set_draft_half_resolution (bool h)
+{
+	_draft_half_resolution = h;
+	signal_changed (DRAFT_HALF_RESOLUTION);
+}
+
 void
 Film::signal_changed (Property p)
 {
@@ -1047,6 +1091,38 @@ Film::examine_and_add_content (shared_ptr<Content> content, bool disable_audio_a
 	JobManager::instance()->add (j);
 }
 
+/** Examine several pieces of content in parallel and add those which can be
+ *  examined successfully, in the order that they are given.
+ */
+void
+Film::examine_and_add_content (ContentList content, bool disable_audio_analysis)
+{
+	if (content.empty ()) {
+		return;
+	} else if (content.size() == 1) {
+		examine_and_add_content (content.front(), disable_audio_analysis);
+		return;
+	}
+
+	/* ffprobe.log is overwritten by each run, so only bother with the last FFmpeg content */
+	if (_directory) {
+		for (ContentList::reverse_iterator i = content.rbegin(); i != content.rend(); ++i) {
+			if (dynamic_pointer_cast<FFmpegContent> (*i)) {
+				run_ffprobe ((*i)->path(0), file ("ffprobe.log"), _log);
+				break;
+			}
+		}
+	}
+
+	shared_ptr<Job> j (new ExamineContentJob (shared_from_this(), content));
+
+	_job_connections.push_back (
+		j->Finished.connect (bind (&Film::add_examined_content, this, weak_ptr<Job>(j), disable_audio_analysis))
+		);
+
+	JobManager::instance()->add (j);
+}
+
 void
 Film::maybe_add_content (weak_ptr<Job> j, weak_ptr<Content> c, bool disable_audio_analysis)
 {
@@ -1060,6 +1136,28 @@ Film::maybe_add_content (weak_ptr<Job> j, weak_ptr<Content> c, bool disable_audi
 		return;
 	}
 
+	add_content_and_analyse (content, disable_audio_analysis);
+}
+
+/** Add whatever content an ExamineContentJob managed to examine, even if
+ *  it failed on some other content.
+ */
+void
+Film::add_examined_content (weak_ptr<Job> j, bool disable_audio_analysis)
+{
+	shared_ptr<ExamineContentJob> job = dynamic_pointer_cast<ExamineContentJob> (j.lock ());
+	if (!job || job->finished_cancelled ()) {
+		return;
+	}
+
+	BOOST_FOREACH (shared_ptr<Content> i, job->examined ()) {
+		add_content_and_analyse (i, disable_audio_analysis);
+	}
+}
+
+void
+Film::add_content_and_analyse (shared_ptr<Content> content, bool disable_audio_analysis)
+{
 	add_content (content);
 
 	if (Config::instance()->automatic_audio_analysis() && content->audio && !disable_audio_analysis) {
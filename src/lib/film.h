@@ -195,7 +195,9 @@ public:
 		AUDIO_PROCESSOR,
 		REEL_TYPE,
 		REEL_LENGTH,
-		UPLOAD_AFTER_MAKE_DCP
+		UPLOAD_AFTER_MAKE_DCP,
+		DRAFT,
+		DRAFT_HALF_RESOLUTION
 	};
 
 
@@ -283,6 +285,14 @@ public:
 		return _upload_after_make_dcp;
 	}
 
+	bool draft () const {
+		return _draft;
+	}
+
+	bool draft_half_resolution () const {
+		return _draft_half_resolution;
+	}
+
 	std::string context_id () const {
 		return _context_id;
 	}
@@ -294,6 +304,7 @@ public:
 	void set_name (std::string);
 	void set_use_isdcf_name (bool);
 	void examine_and_add_content (boost::shared_ptr<Content> content, bool disable_audio_analysis = false);
+	void examine_and_add_content (ContentList content, bool disable_audio_analysis = false);
 	void add_content (boost::shared_ptr<Content>);
 	void remove_content (boost::shared_ptr<Content>);
 	void remove_content (ContentList);
@@ -317,6 +328,8 @@ public:
 	void set_reel_type (ReelType);
 	void set_reel_length (int64_t);
 	void set_upload_after_make_dcp (bool);
+	void set_draft (bool);
+	void set_draft_half_resolution (bool);
 
 	/** Emitted when some property has of the Film has changed */
 	mutable boost::signals2::signal<void (Property)> Changed;
@@ -337,6 +350,8 @@ private:
 	void playlist_order_changed ();
 	void playlist_content_changed (boost::weak_ptr<Content>, int, bool frequent);
 	void maybe_add_content (boost::weak_ptr<Job>, boost::weak_ptr<Content>, bool disable_audio_analysis);
+	void add_examined_content (boost::weak_ptr<Job>, bool disable_audio_analysis);
+	void add_content_and_analyse (boost::shared_ptr<Content>, bool disable_audio_analysis);
 	void audio_analysis_finished ();
 
 	static std::string const metadata_file;
@@ -388,6 +403,10 @@ private:
 	/** Desired reel length in bytes, if _reel_type == REELTYPE_BY_LENGTH */
 	int64_t _reel_length;
 	bool _upload_after_make_dcp;
+	/** true to make a quick, lower-quality DCP for checking rather than one for release */
+	bool _draft;
+	/** true to throw away half the picture's resolution when making a draft DCP */
+	bool _draft_half_resolution;
 
 	int _state_version;
 
@@ -28,6 +28,7 @@
 #include "rect.h"
 #include "util.h"
 #include "dcpomatic_socket.h"
+#include "digester.h"
 #include <dcp/rgb_xyz.h>
 #include <dcp/transfer_function.h>
 extern "C" {
@@ -921,6 +922,26 @@ operator== (Image const & a, Image const & b)
 	return true;
 }
 
+/** Add this image's format, size and pixel data (without any alignment padding)
+ *  to a digest.
+ */
+void
+Image::add_digest (Digester& digester) const
+{
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_size.width);
+	digester.add (_size.height);
+
+	for (int c = 0; c < planes(); ++c) {
+		uint8_t* p = data()[c];
+		int const lines = sample_size(c).height;
+		for (int y = 0; y < lines; ++y) {
+			digester.add (p, line_size()[c]);
+			p += stride()[c];
+		}
+	}
+}
+
 /** Fade the image.
  *  @param f Amount to fade by; 0 is black, 1 is no fade.
  */
@@ -36,6 +36,7 @@ extern "C" {
 
 struct AVFrame;
 class Socket;
+class Digester;
 
 class Image
 {
@@ -72,6 +73,7 @@ public:
 
 	void read_from_socket (boost::shared_ptr<Socket>);
 	void write_to_socket (boost::shared_ptr<Socket>) const;
+	void add_digest (Digester& digester) const;
 
 	AVPixelFormat pixel_format () const {
 		return _pixel_format;
@@ -27,6 +27,7 @@
 #include "film.h"
 #include "exceptions.h"
 #include "video_content.h"
+#include "util.h"
 #include <Magick++.h>
 #include <boost/filesystem.hpp>
 #include <iostream>
@@ -34,16 +35,76 @@
 #include "i18n.h"
 
 using std::cout;
+using std::min;
 using boost::shared_ptr;
+using boost::bind;
 using dcp::Size;
 
+/** Maximum number of frames of moving image content to load ahead of the decoder */
+#define PREFETCH_FRAMES 16
+/** Maximum memory that we will use (approximately) for frames that have been loaded ahead */
+#define PREFETCH_MEMORY (512 * 1024 * 1024)
+
+/** @return Approximate memory used by a decoded image of a given pixel format and size */
+static int64_t
+decoded_bytes (AVPixelFormat format, dcp::Size size)
+{
+	Image const sample (format, dcp::Size (1, 1), false);
+	float per_pixel = 0;
+	for (int i = 0; i < sample.planes(); ++i) {
+		per_pixel += sample.bytes_per_pixel (i);
+	}
+	return int64_t (per_pixel * size.width) * size.height;
+}
+
 ImageDecoder::ImageDecoder (shared_ptr<const ImageContent> c, shared_ptr<Log> log)
 	: _image_content (c)
 	, _frame_video_position (0)
+	, _prefetch_bytes (0)
+	, _prefetch_generation (0)
+	, _prefetch_pixel_format (AV_PIX_FMT_RGB48LE)
 {
 	video.reset (new VideoDecoder (this, c, log));
 }
 
+ImageDecoder::~ImageDecoder ()
+{
+	_prefetch_work.reset ();
+	_prefetch_service.stop ();
+	_prefetch_pool.join_all ();
+}
+
+/** Load an image file.
+ *  @param path Image file.
+ *  @param decode true to decode the image now, if that is possible without knowing the
+ *  size that it will be used at.
+ */
+shared_ptr<ImageProxy>
+ImageDecoder::load (boost::filesystem::path path, bool decode) const
+{
+	if (valid_j2k_file (path)) {
+		AVPixelFormat pf;
+		if (_image_content->video->colour_conversion()) {
+			/* We have a specified colour conversion: assume the image is RGB */
+			pf = AV_PIX_FMT_RGB48LE;
+		} else {
+			/* No specified colour conversion: assume the image is XYZ */
+			pf = AV_PIX_FMT_XYZ12LE;
+		}
+		/* We can't extract image size from a JPEG2000 codestream without decoding it,
+		   so pass in the image content's size here.  We don't decode these now as the
+		   best way to decode them depends on the size they will end up being used at.
+		*/
+		return shared_ptr<ImageProxy> (new J2KImageProxy (path, _image_content->video->size(), pf));
+	}
+
+	shared_ptr<ImageProxy> proxy (new MagickImageProxy (path));
+	if (decode) {
+		proxy->prepare ();
+	}
+	return proxy;
+}
+
 bool
 ImageDecoder::pass ()
 {
@@ -51,35 +112,159 @@ ImageDecoder::pass ()
 		return true;
 	}
 
-	if (!_image_content->still() || !_image) {
-		/* Either we need an image or we are using moving images, so load one */
-		boost::filesystem::path path = _image_content->path (_image_content->still() ? 0 : _frame_video_position);
-		if (valid_j2k_file (path)) {
-			AVPixelFormat pf;
-			if (_image_content->video->colour_conversion()) {
-				/* We have a specified colour conversion: assume the image is RGB */
-				pf = AV_PIX_FMT_RGB48LE;
-			} else {
-				/* No specified colour conversion: assume the image is XYZ */
-				pf = AV_PIX_FMT_XYZ12LE;
-			}
-			/* We can't extract image size from a JPEG2000 codestream without decoding it,
-			   so pass in the image content's size here.
-			*/
-			_image.reset (new J2KImageProxy (path, _image_content->video->size(), pf));
-		} else {
-			_image.reset (new MagickImageProxy (path));
+	if (_image_content->still()) {
+		if (!_image) {
+			_image = load (_image_content->path (0), false);
 		}
+	} else {
+		_image = get_frame (_frame_video_position);
 	}
 
 	video->emit (_image, _frame_video_position);
 	++_frame_video_position;
+
+	if (!_image_content->still()) {
+		prefetch ();
+	}
+
 	return false;
 }
 
+/** @return The image for a frame of moving image content, either from the prefetched
+ *  frames or by loading it now.
+ */
+shared_ptr<ImageProxy>
+ImageDecoder::get_frame (Frame frame)
+{
+	{
+		boost::mutex::scoped_lock lm (_prefetch_mutex);
+
+		while (_prefetching.find (frame) != _prefetching.end ()) {
+			_prefetch_done.wait (lm);
+		}
+
+		std::map<Frame, shared_ptr<ImageProxy> >::iterator i = _prefetched.find (frame);
+		if (i != _prefetched.end ()) {
+			shared_ptr<ImageProxy> proxy = i->second;
+			_prefetched.erase (i);
+			_prefetch_bytes -= _prefetch_sizes[frame];
+			_prefetch_sizes.erase (frame);
+			return proxy;
+		}
+	}
+
+	/* We didn't prefetch this one (or prefetching it failed); load it here, so that
+	   any error is reported in this thread.
+	*/
+	return load (_image_content->path (frame), false);
+}
+
+void
+ImageDecoder::start_prefetch ()
+{
+	_prefetch_work.reset (new boost::asio::io_service::work (_prefetch_service));
+	unsigned int const threads = min (boost::thread::hardware_concurrency(), static_cast<unsigned int> (PREFETCH_FRAMES));
+	for (unsigned int i = 0; i < threads; ++i) {
+		_prefetch_pool.create_thread (bind (&boost::asio::io_service::run, &_prefetch_service));
+	}
+}
+
+/** Ask _prefetch_pool to load any frames after the current position which are not already
+ *  loaded or loading, within the limits of PREFETCH_FRAMES and PREFETCH_MEMORY.
+ */
+void
+ImageDecoder::prefetch ()
+{
+	if (!_prefetch_work) {
+		start_prefetch ();
+	}
+
+	Frame const end = min (_frame_video_position + PREFETCH_FRAMES, _image_content->video->length ());
+
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+
+	/* Memory for a decoded frame, assuming it is in the same format as the last one we loaded */
+	int64_t const decoded_size = decoded_bytes (_prefetch_pixel_format, _image_content->video->size ());
+
+	for (Frame i = _frame_video_position; i < end; ++i) {
+		if (_prefetch_sizes.find (i) != _prefetch_sizes.end ()) {
+			continue;
+		}
+
+		boost::filesystem::path const path = _image_content->path (i);
+		boost::system::error_code ec;
+		int64_t bytes = boost::filesystem::file_size (path, ec);
+		if (ec) {
+			/* Leave this one for get_frame to report */
+			break;
+		}
+		bytes += decoded_size;
+
+		if (!_prefetch_sizes.empty() && (_prefetch_bytes + bytes) > PREFETCH_MEMORY) {
+			break;
+		}
+
+		_prefetching.insert (i);
+		_prefetch_sizes[i] = bytes;
+		_prefetch_bytes += bytes;
+		_prefetch_service.post (bind (&ImageDecoder::prefetch_one, this, i, path, decoded_size, _prefetch_generation));
+	}
+}
+
+/** Called in one of the _prefetch_pool threads to load a frame.
+ *  @param decoded_size Memory that prefetch() allowed for the decoded frame.
+ */
+void
+ImageDecoder::prefetch_one (Frame frame, boost::filesystem::path path, int64_t decoded_size, int generation)
+{
+	shared_ptr<ImageProxy> proxy;
+	AVPixelFormat format = AV_PIX_FMT_RGB48LE;
+	try {
+		proxy = load (path, true);
+		format = proxy->pixel_format ();
+	} catch (...) {
+		/* get_frame will try again and report the error */
+	}
+
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+	if (generation != _prefetch_generation) {
+		/* There has been a seek since this frame was requested */
+		return;
+	}
+
+	_prefetching.erase (frame);
+	if (proxy) {
+		_prefetched[frame] = proxy;
+		/* Correct our estimate now that we know the pixel format */
+		int64_t const actual = decoded_bytes (format, _image_content->video->size ());
+		_prefetch_sizes[frame] += actual - decoded_size;
+		_prefetch_bytes += actual - decoded_size;
+		_prefetch_pixel_format = format;
+	} else {
+		_prefetch_bytes -= _prefetch_sizes[frame];
+		_prefetch_sizes.erase (frame);
+	}
+
+	_prefetch_done.notify_all ();
+}
+
+/** Forget about all prefetched frames */
+void
+ImageDecoder::clear_prefetch ()
+{
+	boost::mutex::scoped_lock lm (_prefetch_mutex);
+	_prefetched.clear ();
+	_prefetching.clear ();
+	_prefetch_sizes.clear ();
+	_prefetch_bytes = 0;
+	++_prefetch_generation;
+	_prefetch_done.notify_all ();
+}
+
 void
 ImageDecoder::seek (ContentTime time, bool accurate)
 {
 	Decoder::seek (time, accurate);
 	_frame_video_position = time.frames_round (_image_content->active_video_frame_rate ());
+	clear_prefetch ();
 }
@@ -19,6 +19,15 @@
 */
 
 #include "decoder.h"
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <map>
+#include <set>
 
 class ImageContent;
 class Log;
@@ -28,6 +37,7 @@ class ImageDecoder : public Decoder
 {
 public:
 	ImageDecoder (boost::shared_ptr<const ImageContent> c, boost::shared_ptr<Log> log);
+	~ImageDecoder ();
 
 	boost::shared_ptr<const ImageContent> content () {
 		return _image_content;
@@ -37,8 +47,41 @@ public:
 	void seek (ContentTime, bool);
 
 private:
+	boost::shared_ptr<ImageProxy> load (boost::filesystem::path path, bool decode) const;
+	boost::shared_ptr<ImageProxy> get_frame (Frame frame);
+	void start_prefetch ();
+	void prefetch ();
+	void prefetch_one (Frame frame, boost::filesystem::path path, int64_t decoded_size, int generation);
+	void clear_prefetch ();
 
 	boost::shared_ptr<const ImageContent> _image_content;
 	boost::shared_ptr<ImageProxy> _image;
 	Frame _frame_video_position;
+
+	/** Threads to load (and where possible decode) the frames of moving image content
+	 *  ahead of when they are needed.
+	 */
+	boost::thread_group _prefetch_pool;
+	boost::asio::io_service _prefetch_service;
+	boost::shared_ptr<boost::asio::io_service::work> _prefetch_work;
+
+	/** mutex to protect _prefetched, _prefetching, _prefetch_sizes, _prefetch_bytes,
+	 *  _prefetch_generation and _prefetch_pixel_format
+	 */
+	boost::mutex _prefetch_mutex;
+	boost::condition _prefetch_done;
+	/** Frames that have been loaded ahead of time */
+	std::map<Frame, boost::shared_ptr<ImageProxy> > _prefetched;
+	/** Frames that are being loaded by _prefetch_pool */
+	std::set<Frame> _prefetching;
+	/** Estimate of the memory used by each frame in _prefetched and _prefetching */
+	std::map<Frame, int64_t> _prefetch_sizes;
+	/** Total of _prefetch_sizes */
+	int64_t _prefetch_bytes;
+	/** Incremented on each seek so that stale prefetches can be discarded */
+	int _prefetch_generation;
+	/** Pixel format of the last frame that was prefetched; until we have seen one this
+	 *  is the largest format that our frames are decoded to.
+	 */
+	AVPixelFormat _prefetch_pixel_format;
 };
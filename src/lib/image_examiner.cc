@@ -25,11 +25,13 @@
 #include "exceptions.h"
 #include "config.h"
 #include "cross.h"
+#include "fast_image_decoder.h"
 #include "compose.hpp"
 #include <dcp/openjpeg_image.h>
 #include <dcp/exceptions.h>
 #include <dcp/j2k.h>
 #include <Magick++.h>
+#include <algorithm>
 #include <iostream>
 
 #include "i18n.h"
@@ -37,9 +39,54 @@
 using std::cout;
 using std::list;
 using std::sort;
+using std::vector;
+using std::search;
 using boost::shared_ptr;
 using boost::optional;
 
+/** Read the start of a file.
+ *  @param path File.
+ *  @param max_length Maximum number of bytes to read.
+ */
+static vector<uint8_t>
+read_header (boost::filesystem::path path, size_t max_length)
+{
+	FILE* f = fopen_boost (path, "rb");
+	if (!f) {
+		throw FileError ("Could not open file for reading", path);
+	}
+
+	vector<uint8_t> header (max_length);
+	header.resize (fread (&header[0], 1, max_length, f));
+	fclose (f);
+	return header;
+}
+
+/** @return Size of a JPEG2000 image, taken from the SIZ marker segment at the start of
+ *  its codestream, or an empty optional if no such marker could be found.
+ */
+static optional<dcp::Size>
+j2k_size (vector<uint8_t> const & header)
+{
+	/* SOC immediately followed by SIZ; in a JP2 file this will be at the start of the jp2c box */
+	uint8_t const marker[] = { 0xff, 0x4f, 0xff, 0x51 };
+	vector<uint8_t>::const_iterator i = search (header.begin(), header.end(), marker, marker + 4);
+	if (i == header.end() || (header.end() - i) < 24) {
+		return optional<dcp::Size> ();
+	}
+
+	uint8_t const * p = &(*i);
+	uint32_t const x = (p[8] << 24) | (p[9] << 16) | (p[10] << 8) | p[11];
+	uint32_t const y = (p[12] << 24) | (p[13] << 16) | (p[14] << 8) | p[15];
+	uint32_t const x_offset = (p[16] << 24) | (p[17] << 16) | (p[18] << 8) | p[19];
+	uint32_t const y_offset = (p[20] << 24) | (p[21] << 16) | (p[22] << 8) | p[23];
+	if (x <= x_offset || y <= y_offset) {
+		return optional<dcp::Size> ();
+	}
+
+	return dcp::Size (x - x_offset, y - y_offset);
+}
+
 ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const ImageContent> content, shared_ptr<Job>)
 	: _film (film)
 	, _image_content (content)
@@ -47,27 +94,41 @@ ImageExaminer::ImageExaminer (shared_ptr<const Film> film, shared_ptr<const Imag
 #ifdef DCPOMATIC_HAVE_MAGICKCORE_NAMESPACE
 	using namespace MagickCore;
 #endif
+	/* We only need the size of the image here, so try to get it from the file's
+	   header rather than decoding the whole thing.
+	*/
 	boost::filesystem::path path = content->path(0).string ();
+	vector<uint8_t> header = read_header (path, 65536);
+
 	if (valid_j2k_file (path)) {
-		boost::uintmax_t size = boost::filesystem::file_size (path);
-		FILE* f = fopen_boost (path, "rb");
-		if (!f) {
-			throw FileError ("Could not open file for reading", path);
-		}
-		uint8_t* buffer = new uint8_t[size];
-		fread (buffer, 1, size, f);
-		fclose (f);
-		try {
-			_video_size = dcp::decompress_j2k (buffer, size, 0)->size ();
-		} catch (dcp::DCPReadError& e) {
+		_video_size = j2k_size (header);
+		if (!_video_size) {
+			boost::uintmax_t size = boost::filesystem::file_size (path);
+			FILE* f = fopen_boost (path, "rb");
+			if (!f) {
+				throw FileError ("Could not open file for reading", path);
+			}
+			uint8_t* buffer = new uint8_t[size];
+			fread (buffer, 1, size, f);
+			fclose (f);
+			try {
+				_video_size = dcp::decompress_j2k (buffer, size, 0)->size ();
+			} catch (dcp::DCPReadError& e) {
+				delete[] buffer;
+				throw DecodeError (String::compose (_("Could not decode JPEG2000 file %1 (%2)"), path, e.what ()));
+			}
 			delete[] buffer;
-			throw DecodeError (String::compose (_("Could not decode JPEG2000 file %1 (%2)"), path, e.what ()));
 		}
-		delete[] buffer;
 	} else {
-		Magick::Image* image = new Magick::Image (content->path(0).string());
-		_video_size = dcp::Size (image->columns(), image->rows());
-		delete image;
+		if (!header.empty ()) {
+			_video_size = FastImageDecoder (&header[0], header.size()).size ();
+		}
+		if (!_video_size) {
+			/* ping() reads the image's attributes without decoding its pixels */
+			Magick::Image image;
+			image.ping (content->path(0).string());
+			_video_size = dcp::Size (image.columns(), image.rows());
+		}
 	}
 
 	if (content->still ()) {
@@ -25,6 +25,7 @@
 #include "image.h"
 #include "exceptions.h"
 #include "cross.h"
+#include "digester.h"
 #include <dcp/util.h>
 #include <libcxml/cxml.h>
 #include <iostream>
@@ -35,6 +36,18 @@ using std::cout;
 using std::string;
 using boost::shared_ptr;
 
+string
+ImageProxy::digest () const
+{
+	boost::mutex::scoped_lock lm (_digest_mutex);
+	if (!_digest) {
+		Digester digester;
+		add_digest (digester);
+		_digest = digester.get ();
+	}
+	return _digest.get ();
+}
+
 shared_ptr<ImageProxy>
 image_proxy_factory (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
 {
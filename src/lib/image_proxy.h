@@ -32,9 +32,12 @@ extern "C" {
 #include <boost/shared_ptr.hpp>
 #include <boost/optional.hpp>
 #include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
 
 class Image;
 class Socket;
+class Digester;
 
 namespace xmlpp {
 	class Node;
@@ -74,11 +77,21 @@ public:
 	virtual void send_binary (boost::shared_ptr<Socket>) const = 0;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	virtual bool same (boost::shared_ptr<const ImageProxy>) const = 0;
+	/** Add everything that identifies our image to a digest */
+	virtual void add_digest (Digester &) const = 0;
+	/** @return digest of everything that identifies our image; this is calculated
+	 *  on the first call and remembered after that.
+	 */
+	std::string digest () const;
 	/** Do any useful work that would speed up a subsequent call to ::image().
 	 *  This method may be called in a different thread to image().
 	 */
 	virtual void prepare (boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const {}
 	virtual AVPixelFormat pixel_format () const = 0;
+
+private:
+	mutable boost::mutex _digest_mutex;
+	mutable boost::optional<std::string> _digest;
 };
 
 boost::shared_ptr<ImageProxy> image_proxy_factory (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/j2k_draft.cc
+ *  @brief compress_draft_j2k(), a quicker alternative to dcp::compress_j2k for draft encodes.
+ */
+
+#include "j2k_draft.h"
+#include "exceptions.h"
+#include <dcp/openjpeg_image.h>
+#include <openjpeg.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <cstring>
+
+using std::vector;
+using boost::shared_ptr;
+
+/** Number of wavelet decomposition levels for a draft 2K encode; DCI allows between 1 and 5,
+ *  and dcp::compress_j2k uses 5.
+ */
+#define DRAFT_DECOMPOSITION_LEVELS_2K 3
+/** Number of wavelet decomposition levels for a draft 4K encode; DCI allows between 1 and 6,
+ *  and dcp::compress_j2k uses 6.
+ */
+#define DRAFT_DECOMPOSITION_LEVELS_4K 4
+
+/** Growable buffer which OpenJPEG writes the codestream into; it seeks back to fill in
+ *  tile-part lengths, so we must keep track of a position as well as a size.
+ */
+class DraftBuffer
+{
+public:
+	DraftBuffer ()
+		: position (0)
+	{}
+
+	vector<uint8_t> data;
+	OPJ_OFF_T position;
+};
+
+static OPJ_SIZE_T
+write_function (void* buffer, OPJ_SIZE_T nb_bytes, void* user_data)
+{
+	DraftBuffer* b = reinterpret_cast<DraftBuffer*> (user_data);
+	if (b->data.size() < b->position + nb_bytes) {
+		b->data.resize (b->position + nb_bytes);
+	}
+	memcpy (&b->data[b->position], buffer, nb_bytes);
+	b->position += nb_bytes;
+	return nb_bytes;
+}
+
+static OPJ_OFF_T
+skip_function (OPJ_OFF_T nb_bytes, void* user_data)
+{
+	DraftBuffer* b = reinterpret_cast<DraftBuffer*> (user_data);
+	b->position += nb_bytes;
+	if (b->data.size() < size_t (b->position)) {
+		b->data.resize (b->position);
+	}
+	return nb_bytes;
+}
+
+static OPJ_BOOL
+seek_function (OPJ_OFF_T nb_bytes, void* user_data)
+{
+	DraftBuffer* b = reinterpret_cast<DraftBuffer*> (user_data);
+	b->position = nb_bytes;
+	if (b->data.size() < size_t (b->position)) {
+		b->data.resize (b->position);
+	}
+	return OPJ_TRUE;
+}
+
+/** Compress an XYZ image to JPEG2000 in the same way as dcp::compress_j2k, except that fewer
+ *  wavelet decomposition levels are used.  The result is still a DCI-compliant codestream;
+ *  the DWT has less to do, as do the tier-2 passes of rate allocation since there are fewer
+ *  resolutions (and hence packets) in each tile, but compression is a little less efficient.
+ *  @param xyz Image to compress.
+ *  @param bandwidth J2K bandwidth in bits per second.
+ *  @param frames_per_second Frame rate of the DCP.
+ *  @param threed true if this is one eye of a 3D DCP.
+ *  @param fourk true to make a 4K codestream, otherwise 2K.
+ */
+dcp::Data
+compress_draft_j2k (shared_ptr<const dcp::OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk)
+{
+	/* Maximum sizes as dcp::compress_j2k computes them */
+	int max_cs_len = ((float) bandwidth) / 8 / frames_per_second;
+	if (threed) {
+		/* In 3D we have only half the normal bandwidth per eye */
+		max_cs_len /= 2;
+	}
+	int const max_comp_size = max_cs_len / 1.25;
+
+	opj_cparameters_t parameters;
+	opj_set_default_encoder_parameters (&parameters);
+
+	parameters.rsiz = fourk ? OPJ_PROFILE_CINEMA_4K : OPJ_PROFILE_CINEMA_2K;
+	parameters.numresolution = (fourk ? DRAFT_DECOMPOSITION_LEVELS_4K : DRAFT_DECOMPOSITION_LEVELS_2K) + 1;
+
+	/* One tile at (0, 0) */
+	parameters.tile_size_on = OPJ_FALSE;
+	parameters.cp_tdx = 1;
+	parameters.cp_tdy = 1;
+	parameters.cp_tx0 = 0;
+	parameters.cp_ty0 = 0;
+	parameters.image_offset_x0 = 0;
+	parameters.image_offset_y0 = 0;
+
+	/* Tile parts split by component */
+	parameters.tp_flag = 'C';
+	parameters.tp_on = 1;
+
+	/* 32x32 code-blocks, default precincts, CPRL progression, no ROI */
+	parameters.cblockw_init = 32;
+	parameters.cblockh_init = 32;
+	parameters.csty |= 0x01;
+	parameters.prog_order = OPJ_CPRL;
+	parameters.roi_compno = -1;
+
+	parameters.subsampling_dx = 1;
+	parameters.subsampling_dy = 1;
+
+	/* Irreversible 9-7 wavelet and colour transforms */
+	parameters.irreversible = 1;
+	parameters.tcp_mct = 1;
+
+	/* One quality layer, with its size limited by the bandwidth */
+	parameters.tcp_rates[0] = 0;
+	parameters.tcp_numlayers = 1;
+	parameters.cp_disto_alloc = 1;
+	parameters.max_cs_size = max_cs_len;
+	parameters.max_comp_size = max_comp_size;
+
+	if (fourk) {
+		/* The 2K resolutions first, then the last 4K one, so that 2K players can
+		   just take the start of each tile part.
+		*/
+		parameters.numpocs = 2;
+		parameters.POC[0].tile = 1;
+		parameters.POC[0].resno0 = 0;
+		parameters.POC[0].compno0 = 0;
+		parameters.POC[0].layno1 = 1;
+		parameters.POC[0].resno1 = parameters.numresolution - 1;
+		parameters.POC[0].compno1 = 3;
+		parameters.POC[0].prg1 = OPJ_CPRL;
+		parameters.POC[1].tile = 1;
+		parameters.POC[1].resno0 = parameters.numresolution - 1;
+		parameters.POC[1].compno0 = 0;
+		parameters.POC[1].layno1 = 1;
+		parameters.POC[1].resno1 = parameters.numresolution;
+		parameters.POC[1].compno1 = 3;
+		parameters.POC[1].prg1 = OPJ_CPRL;
+	}
+
+	opj_codec_t* encoder = opj_create_compress (OPJ_CODEC_J2K);
+	if (!encoder) {
+		throw EncodeError ("could not create JPEG2000 encoder");
+	}
+
+	if (!opj_setup_encoder (encoder, &parameters, xyz->opj_image ())) {
+		opj_destroy_codec (encoder);
+		throw EncodeError ("could not set up JPEG2000 encoder");
+	}
+
+	opj_stream_t* stream = opj_stream_default_create (OPJ_FALSE);
+	if (!stream) {
+		opj_destroy_codec (encoder);
+		throw EncodeError ("could not create JPEG2000 stream");
+	}
+
+	DraftBuffer buffer;
+	opj_stream_set_write_function (stream, write_function);
+	opj_stream_set_skip_function (stream, skip_function);
+	opj_stream_set_seek_function (stream, seek_function);
+	opj_stream_set_user_data (stream, &buffer, 0);
+
+	bool const ok =
+		opj_start_compress (encoder, xyz->opj_image (), stream) &&
+		opj_encode (encoder, stream) &&
+		opj_end_compress (encoder, stream);
+
+	opj_stream_destroy (stream);
+	opj_destroy_codec (encoder);
+
+	if (!ok) {
+		throw EncodeError ("JPEG2000 encoding failed");
+	}
+
+	dcp::Data enc (buffer.data.size ());
+	memcpy (enc.data().get(), &buffer.data[0], buffer.data.size ());
+	return enc;
+}
@@ -0,0 +1,33 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_J2K_DRAFT_H
+#define DCPOMATIC_J2K_DRAFT_H
+
+#include <dcp/data.h>
+#include <boost/shared_ptr.hpp>
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+extern dcp::Data compress_draft_j2k (boost::shared_ptr<const dcp::OpenJPEGImage> xyz, int bandwidth, int frames_per_second, bool threed, bool fourk);
+
+#endif
@@ -34,10 +34,13 @@
 #include "player.h"
 #include "player_video.h"
 #include "encode_server_description.h"
+#include "j2k_frame_cache.h"
+#include "exceptions.h"
 #include "compose.hpp"
 #include <libcxml/cxml.h>
 #include <boost/foreach.hpp>
 #include <iostream>
+#include <cmath>
 
 #include "i18n.h"
 
@@ -47,7 +50,29 @@
 #define LOG_TIMING(...) _film->log()->log (String::compose (__VA_ARGS__), LogEntry::TYPE_TIMING);
 #define LOG_DEBUG_ENCODE(...) _film->log()->log (String::compose (__VA_ARGS__), LogEntry::TYPE_DEBUG_ENCODE);
 
+/** Minimum time in seconds that a frame which is holding up the writer must have been
+ *  encoding for before we re-dispatch it to another thread.
+ */
+#define HEDGE_MINIMUM_TIMEOUT 2.0
+/** Multiple of the mean encode time after which a frame which is holding up the
+ *  writer will be re-dispatched to another thread.
+ */
+#define HEDGE_TIMEOUT_FACTOR 4
+/** Maximum number of threads to use for a remote server, as a multiple of the number
+ *  of threads that the server has.
+ */
+#define SERVER_MAXIMUM_THREADS_FACTOR 2
+/** Interval in seconds at which to look for changes in the speed and load that servers advertise */
+#define SERVER_REFRESH_INTERVAL 10
+/** Time in milliseconds to wait before sending more work to a server which said that it was busy */
+#define SERVER_BUSY_RETRY_DELAY 500
+
 using std::list;
+using std::string;
+using std::map;
+using std::pair;
+using std::max;
+using std::min;
 using std::cout;
 using boost::shared_ptr;
 using boost::weak_ptr;
@@ -60,8 +85,27 @@ using dcp::Data;
 J2KEncoder::J2KEncoder (shared_ptr<const Film> film, shared_ptr<Writer> writer)
 	: _film (film)
 	, _history (200)
+	, _local_threads (0)
+	, _local_busy (0)
 	, _writer (writer)
+	, _xyz_work (new boost::asio::io_service::work (_xyz_service))
 {
+	/* Each local encode does one band of its XYZ conversion itself, so the pool needs one thread
+	   fewer than the most that a local encode can be given.
+	*/
+	for (int i = 1; i < Config::instance()->master_encoding_threads (); ++i) {
+		_xyz_pool.create_thread (boost::bind (&boost::asio::io_service::run, &_xyz_service));
+	}
+
+	int const cache_size = Config::instance()->j2k_cache_size ();
+	if (cache_size > 0) {
+		try {
+			_cache.reset (new J2KFrameCache (Config::instance()->j2k_cache_directory(), uint64_t (cache_size) * 1024 * 1024 * 1024));
+		} catch (std::exception& e) {
+			LOG_ERROR (N_("Could not open encoded frame cache (%1)"), e.what ());
+		}
+	}
+
 	servers_list_changed ();
 }
 
@@ -75,6 +119,10 @@ J2KEncoder::~J2KEncoder ()
 		   I think.
 		*/
 	}
+
+	_xyz_work.reset ();
+	_xyz_pool.join_all ();
+	_xyz_service.stop ();
 }
 
 void
@@ -106,8 +154,8 @@ J2KEncoder::end ()
 
 	LOG_GENERAL (N_("Clearing queue of %1"), _queue.size ());
 
-	/* Keep waking workers until the queue is empty */
-	while (!_queue.empty ()) {
+	/* Keep waking workers until the queue is empty and nothing is being encoded */
+	while (!_queue.empty () || !_in_flight.empty ()) {
 		rethrow ();
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -127,17 +175,35 @@ J2KEncoder::end ()
 	     3. the remote worker fails to encode the image and puts it back on the queue
 	     4. the remote worker is then terminated by terminate_threads
 
-	     So just mop up anything left in the queue here.
+	     So just mop up anything left in the queue here.  There are no other threads
+	     now, so each frame can use all the local threads that we would normally use;
+	     if we have been told that only servers should encode we try them first, and
+	     only encode here (with a single thread) if none of them will do it.
 	*/
 
+	bool const only_servers = Config::instance()->only_servers_encode ();
+	int const local_threads = only_servers ? 1 : max (1, Config::instance()->master_encoding_threads ());
+
 	for (list<shared_ptr<DCPVideo> >::iterator i = _queue.begin(); i != _queue.end(); ++i) {
 		LOG_GENERAL (N_("Encode left-over frame %1"), (*i)->index ());
+
+		optional<Data> encoded;
+		if (only_servers) {
+			BOOST_FOREACH (EncodeServerDescription j, EncodeServerFinder::instance()->servers ()) {
+				try {
+					encoded = (*i)->encode_remotely (j);
+					break;
+				} catch (std::exception& e) {
+					LOG_ERROR (N_("Remote encode of %1 on %2 failed (%3)"), (*i)->index(), j.host_name(), e.what ());
+				}
+			}
+		}
+
 		try {
-			_writer->write (
-				(*i)->encode_locally (boost::bind (&Log::dcp_log, _film->log().get(), _1, _2)),
-				(*i)->index (),
-				(*i)->eyes ()
-				);
+			if (!encoded) {
+				encoded = (*i)->encode_locally (boost::bind (&Log::dcp_log, _film->log().get(), _1, _2), local_threads, &_xyz_service);
+			}
+			_writer->write (encoded.get(), (*i)->index (), (*i)->eyes ());
 			frame_done ();
 		} catch (std::exception& e) {
 			LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
@@ -220,34 +286,216 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 		LOG_DEBUG_ENCODE("Frame @ %1 J2K", to_string(time));
 		/* This frame already has J2K data, so just write it */
 		_writer->write (pv->j2k(), position, pv->eyes ());
-	} else if (_last_player_video[pv->eyes()] && _writer->can_repeat(position) && pv->same (_last_player_video[pv->eyes()])) {
-		LOG_DEBUG_ENCODE("Frame @ %1 REPEAT", to_string(time));
-		_writer->repeat (position, pv->eyes ());
 	} else {
-		LOG_DEBUG_ENCODE("Frame @ %1 ENCODE", to_string(time));
-		/* Queue this new frame for encoding */
-		LOG_TIMING ("add-frame-to-queue queue=%1", _queue.size ());
-		_queue.push_back (shared_ptr<DCPVideo> (
-					  new DCPVideo (
-						  pv,
-						  position,
-						  _film->video_frame_rate(),
-						  _film->j2k_bandwidth(),
-						  _film->resolution(),
-						  _film->log()
-						  )
-					  ));
-
-		/* The queue might not be empty any more, so notify anything which is
-		   waiting on that.
-		*/
-		_empty_condition.notify_all ();
+		shared_ptr<DCPVideo> vf (
+			new DCPVideo (
+				pv,
+				position,
+				_film->video_frame_rate(),
+				_film->j2k_bandwidth(),
+				_film->resolution(),
+				_film->log(),
+				_film->draft(),
+				_film->draft() && _film->draft_half_resolution()
+				)
+			);
+
+		optional<Data> constant = constant_frame (vf);
+		if (constant) {
+			LOG_DEBUG_ENCODE("Frame @ %1 CONSTANT", to_string(time));
+			/* We have already encoded a frame which looks exactly like this one */
+			_writer->write (constant.get(), position, pv->eyes ());
+			frame_done ();
+		} else if (_last_player_video[pv->eyes()] && _writer->can_repeat(position) && pv->same (_last_player_video[pv->eyes()])) {
+			LOG_DEBUG_ENCODE("Frame @ %1 REPEAT", to_string(time));
+			_writer->repeat (position, pv->eyes ());
+		} else {
+			LOG_DEBUG_ENCODE("Frame @ %1 ENCODE", to_string(time));
+			/* Queue this new frame for encoding */
+			LOG_TIMING ("add-frame-to-queue queue=%1", _queue.size ());
+			_queue.push_back (vf);
+
+			/* The queue might not be empty any more, so notify anything which is
+			   waiting on that.
+			*/
+			_empty_condition.notify_all ();
+		}
 	}
 
 	_last_player_video[pv->eyes()] = pv;
 	_last_player_video_time = time;
 }
 
+/** @return Encoded data for a frame if it is one that we know to be constant, and
+ *  we have encoded an identical one before; otherwise an empty optional.
+ */
+optional<Data>
+J2KEncoder::constant_frame (shared_ptr<const DCPVideo> vf) const
+{
+	optional<string> key = vf->constant_key ();
+	if (!key) {
+		return optional<Data> ();
+	}
+
+	boost::mutex::scoped_lock lm (_constant_frames_mutex);
+	map<string, Data>::const_iterator i = _constant_frames.find (key.get ());
+	if (i == _constant_frames.end ()) {
+		return optional<Data> ();
+	}
+
+	return i->second;
+}
+
+/** Remember the encoded version of a frame, if it is one that we know to be constant */
+void
+J2KEncoder::add_constant_frame (shared_ptr<const DCPVideo> vf, Data encoded)
+{
+	optional<string> key = vf->constant_key ();
+	if (!key) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_constant_frames_mutex);
+	if (_constant_frames.size() < CONSTANT_FRAMES_MAX) {
+		_constant_frames[key.get()] = encoded;
+	}
+}
+
+/** Find a frame which is being encoded, and which is holding up the writer because
+ *  it is taking too long.  It will be marked as being re-dispatched to the calling thread.
+ *  _queue_mutex must be held by the caller.
+ *  @param server Server of the calling thread, or empty if it is a local thread.
+ *  @return Frame to encode, or 0.
+ */
+shared_ptr<DCPVideo>
+J2KEncoder::straggler (optional<EncodeServerDescription> server)
+{
+	if (_in_flight.empty ()) {
+		return shared_ptr<DCPVideo> ();
+	}
+
+	/* Wait for a multiple of the recent typical encode time, or a minimum time if we
+	   don't know that yet.
+	*/
+	boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time ();
+	double const timeout = max (HEDGE_MINIMUM_TIMEOUT, _mean_encode_time.get_value_or(0) * HEDGE_TIMEOUT_FACTOR);
+	string const host = server ? server->host_name() : "";
+
+	bool any = false;
+	for (InFlightMap::const_iterator i = _in_flight.begin(); i != _in_flight.end(); ++i) {
+		if (i->second.workers == 1 && i->second.host != host && _hedged.find (i->first) == _hedged.end() &&
+		    (now - i->second.start).total_milliseconds() > timeout * 1000) {
+			any = true;
+			break;
+		}
+	}
+
+	if (!any) {
+		return shared_ptr<DCPVideo> ();
+	}
+
+	/* Now see if any of these late frames is one that the writer is waiting for; this
+	   includes the tail of a reel when the writer has nothing else queued.
+	*/
+	list<pair<Frame, Eyes> > awaiting = _writer->awaiting ();
+
+	for (InFlightMap::iterator i = _in_flight.begin(); i != _in_flight.end(); ++i) {
+		if (
+			i->second.workers != 1 ||
+			i->second.host == host ||
+			_hedged.find (i->first) != _hedged.end() ||
+			(now - i->second.start).total_milliseconds() <= timeout * 1000
+			) {
+			continue;
+		}
+
+		for (list<pair<Frame, Eyes> >::const_iterator j = awaiting.begin(); j != awaiting.end(); ++j) {
+			if (i->first.first == j->first && (i->first.second == j->second || i->first.second == EYES_BOTH)) {
+				++i->second.workers;
+				_hedged.insert (i->first);
+				return i->second.video;
+			}
+		}
+	}
+
+	return shared_ptr<DCPVideo> ();
+}
+
+/** @param server Server of the calling thread, or empty if it is a local thread.
+ *  @return true if the calling thread may take a frame to encode.  _queue_mutex must be held by the caller.
+ */
+bool
+J2KEncoder::can_take (optional<EncodeServerDescription> server) const
+{
+	if (!server) {
+		return true;
+	}
+
+	map<string, ServerState>::const_iterator i = _servers.find (server->host_name ());
+	return i == _servers.end() || i->second.active < i->second.limit;
+}
+
+/** @param server A server, as it last described itself.
+ *  @param ours Number of frames that we are currently sending to the server.
+ *  @return Estimate of the number of frames from other masters that the server is
+ *  encoding or has queued.
+ */
+static int
+other_work (EncodeServerDescription const & server, int ours)
+{
+	return max (0, int (lrint (server.load() * server.threads())) + server.queue_length() - ours);
+}
+
+/** Called when one of our threads has finished with a frame on a remote server, to update
+ *  how many of our threads may send work to that server at once.  We aim to keep all
+ *  the server's threads busy, with enough extra frames to cover the time that frames spend
+ *  travelling to and from the server.  _queue_mutex must be held by the caller.
+ *  @param host Server's host name.
+ *  @param round_trip Time taken to encode the frame, if it was successful.
+ */
+void
+J2KEncoder::update_server_state (string host, optional<double> round_trip)
+{
+	map<string, ServerState>::iterator i = _servers.find (host);
+	if (i == _servers.end ()) {
+		return;
+	}
+
+	ServerState& state = i->second;
+	--state.active;
+
+	if (round_trip) {
+		/* Let the shortest time drift upwards so that we notice if things get slower */
+		state.min_round_trip = state.min_round_trip ? min (*round_trip, *state.min_round_trip * 1.05) : *round_trip;
+	}
+
+	boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time ();
+	if ((now - state.refreshed).total_seconds() > SERVER_REFRESH_INTERVAL) {
+		BOOST_FOREACH (EncodeServerDescription j, EncodeServerFinder::instance()->servers ()) {
+			if (j.host_name() == host) {
+				state.frames_per_second = j.frames_per_second (_film->resolution ());
+				state.others = other_work (j, state.active);
+			}
+		}
+		state.refreshed = now;
+	}
+
+	int limit = state.threads;
+	if (state.frames_per_second && state.min_round_trip) {
+		/* Time that one of the server's threads takes to encode a frame */
+		double const encode = state.threads / state.frames_per_second.get ();
+		/* Extra frames needed to keep the server busy while others are in transit */
+		limit += ceil (max (0.0, state.min_round_trip.get() - encode) * state.frames_per_second.get ());
+	}
+
+	/* Leave room for work that other masters are giving the server */
+	limit = max (1, min (limit, state.threads * SERVER_MAXIMUM_THREADS_FACTOR) - state.others);
+	if (limit != state.limit) {
+		LOG_DEBUG_ENCODE (N_("Sending up to %1 frames at once to %2"), limit, host);
+		state.limit = limit;
+	}
+}
+
 void
 J2KEncoder::terminate_threads ()
 {
@@ -286,17 +534,36 @@ try
 	   encodings.
 	*/
 	int remote_backoff = 0;
+	/* true if the server said that it was too busy to take our last frame */
+	bool remote_busy = false;
 
 	while (true) {
 
 		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
 		boost::mutex::scoped_lock lock (_queue_mutex);
-		while (_queue.empty ()) {
-			_empty_condition.wait (lock);
+
+		/* Look for a straggling frame that is holding up the writer before taking
+		   new work from the queue.  Wake up every so often to look for stragglers
+		   even if nothing new arrives.
+		*/
+		shared_ptr<DCPVideo> vf;
+		while (true) {
+			if (can_take (server)) {
+				vf = straggler (server);
+				if (vf || !_queue.empty ()) {
+					break;
+				}
+			}
+			_empty_condition.timed_wait (lock, boost::posix_time::seconds (1));
+		}
+
+		bool const hedge = static_cast<bool> (vf);
+		if (!hedge) {
+			vf = _queue.front ();
 		}
 
 		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
-		shared_ptr<DCPVideo> vf = _queue.front ();
+		InFlightKey const key (vf->index(), vf->eyes());
 
 		/* We're about to commit to either encoding this frame or putting it back onto the queue,
 		   so we must not be interrupted until one or other of these things have happened.  This
@@ -305,61 +572,154 @@ try
 		{
 			boost::this_thread::disable_interruption dis;
 
-			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
-			_queue.pop_front ();
+			if (hedge) {
+				LOG_GENERAL (N_("Re-dispatching straggling frame %1 to %2"), vf->index(), server ? server->host_name() : "localhost");
+			} else {
+				LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
+				_queue.pop_front ();
+				_in_flight[key] = InFlight (vf, server ? server->host_name() : "", boost::posix_time::microsec_clock::universal_time ());
+			}
+
+			if (server) {
+				++_servers[server->host_name()].active;
+			}
+
+			/* If there are fewer frames waiting than there are idle local threads (at the
+			   end of a job, or on a short one) this frame can have a share of the threads
+			   which would otherwise have nothing to do.
+			*/
+			int local_threads = 1;
+			if (!server) {
+				++_local_busy;
+				int const spare = _local_threads - _local_busy - int (_queue.size ());
+				if (spare > 0) {
+					local_threads = 1 + spare / _local_busy;
+				}
+			}
 
 			lock.unlock ();
 
+			boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time ();
+
 			optional<Data> encoded;
 
-			/* We need to encode this input */
-			if (server) {
-				try {
-					encoded = vf->encode_remotely (server.get ());
+			string digest;
+			bool cached = false;
+			if (_cache) {
+				digest = vf->digest ();
+				encoded = _cache->get (digest);
+				cached = static_cast<bool> (encoded);
+				if (encoded) {
+					LOG_DEBUG_ENCODE (N_("Frame %1 found in cache"), vf->index());
+				}
+			}
 
-					if (remote_backoff > 0) {
-						LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+			if (!encoded) {
+				/* We need to encode this input */
+				if (server) {
+					try {
+						encoded = vf->encode_remotely (server.get ());
+
+						if (remote_backoff > 0) {
+							LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+						}
+
+						/* This job succeeded, so remove any backoff */
+						remote_backoff = 0;
+						remote_busy = false;
+
+					} catch (ServerBusyError& e) {
+						/* The server is there, just busy, so there is no need to back off; try again soon */
+						remote_backoff = 0;
+						remote_busy = true;
+						LOG_DEBUG_ENCODE (N_("%1 was too busy to take frame %2"), server->host_name(), vf->index());
+					} catch (std::exception& e) {
+						if (remote_backoff < 60) {
+							/* back off more */
+							remote_backoff += 10;
+						}
+						LOG_ERROR (
+							N_("Remote encode of %1 on %2 failed (%3); thread sleeping for %4s"),
+							vf->index(), server->host_name(), e.what(), remote_backoff
+							);
 					}
 
-					/* This job succeeded, so remove any backoff */
-					remote_backoff = 0;
-
-				} catch (std::exception& e) {
-					if (remote_backoff < 60) {
-						/* back off more */
-						remote_backoff += 10;
+				} else {
+					try {
+						LOG_TIMING ("start-local-encode thread=%1 frame=%2 threads=%3", thread_id(), vf->index(), local_threads);
+						encoded = vf->encode_locally (boost::bind (&Log::dcp_log, _film->log().get(), _1, _2), local_threads, &_xyz_service);
+						LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf->index());
+					} catch (std::exception& e) {
+						/* This is very bad, so don't cope with it, just pass it on */
+						LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
+						throw;
 					}
-					LOG_ERROR (
-						N_("Remote encode of %1 on %2 failed (%3); thread sleeping for %4s"),
-						vf->index(), server->host_name(), e.what(), remote_backoff
-						);
 				}
 
-			} else {
-				try {
-					LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf->index());
-					encoded = vf->encode_locally (boost::bind (&Log::dcp_log, _film->log().get(), _1, _2));
-					LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf->index());
-				} catch (std::exception& e) {
-					/* This is very bad, so don't cope with it, just pass it on */
-					LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
-					throw;
+				if (encoded && _cache) {
+					try {
+						_cache->put (digest, encoded.get ());
+					} catch (std::exception& e) {
+						LOG_ERROR (N_("Could not add frame %1 to cache (%2)"), vf->index(), e.what ());
+					}
 				}
 			}
 
+			lock.lock ();
+
+			if (!server) {
+				--_local_busy;
+			}
+
+			optional<double> time;
+			if (encoded && !cached) {
+				time = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+				_mean_encode_time = _mean_encode_time ? (*_mean_encode_time * 0.9 + *time * 0.1) : *time;
+			}
+
+			if (server) {
+				update_server_state (server->host_name(), time);
+				/* This server might be able to take more work now */
+				_empty_condition.notify_all ();
+			}
+
+			/* If this frame was re-dispatched, the first thread to finish wins */
+			InFlightMap::iterator i = _in_flight.find (key);
+
 			if (encoded) {
-				_writer->write (encoded.get(), vf->index (), vf->eyes ());
-				frame_done ();
+
+				if (i != _in_flight.end ()) {
+					_in_flight.erase (i);
+					/* Only a successful encode forgets that the frame was hedged */
+					_hedged.erase (key);
+					lock.unlock ();
+					add_constant_frame (vf, encoded.get ());
+					_writer->write (encoded.get(), vf->index (), vf->eyes ());
+					frame_done ();
+				} else {
+					lock.unlock ();
+					LOG_DEBUG_ENCODE (N_("Discarding duplicate encode of frame %1"), vf->index());
+				}
 			} else {
-				lock.lock ();
-				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
-				_queue.push_front (vf);
+				if (i != _in_flight.end ()) {
+					if (i->second.workers > 1) {
+						/* Someone else is still working on it */
+						--i->second.workers;
+					} else {
+						_in_flight.erase (i);
+						LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
+						_queue.push_front (vf);
+						_empty_condition.notify_all ();
+					}
+				}
 				lock.unlock ();
 			}
 		}
 
 		if (remote_backoff > 0) {
 			boost::this_thread::sleep (boost::posix_time::seconds (remote_backoff));
+		} else if (remote_busy) {
+			boost::this_thread::sleep (boost::posix_time::milliseconds (SERVER_BUSY_RETRY_DELAY));
 		}
 
 		/* The queue might not be full any more, so notify anything that is waiting on that */
@@ -409,9 +769,30 @@ J2KEncoder::servers_list_changed ()
 		}
 	}
 
-	BOOST_FOREACH (EncodeServerDescription i, EncodeServerFinder::instance()->servers ()) {
-		LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), i.threads(), i.host_name ());
-		for (int j = 0; j < i.threads(); ++j) {
+	list<EncodeServerDescription> servers = EncodeServerFinder::instance()->servers ();
+
+	{
+		boost::mutex::scoped_lock queue_lock (_queue_mutex);
+		_local_threads = Config::instance()->only_servers_encode() ? 0 : Config::instance()->master_encoding_threads ();
+		_servers.clear ();
+		BOOST_FOREACH (EncodeServerDescription i, servers) {
+			ServerState& state = _servers[i.host_name()];
+			state.threads = i.threads ();
+			state.frames_per_second = i.frames_per_second (_film->resolution ());
+			/* Start off by leaving room for any work that other masters have already given it */
+			state.others = other_work (i, 0);
+			state.limit = max (1, i.threads() - state.others);
+			state.refreshed = boost::posix_time::microsec_clock::universal_time ();
+		}
+	}
+
+	BOOST_FOREACH (EncodeServerDescription i, servers) {
+		/* Start more threads than the server has so that we can keep it busy while frames
+		   are travelling to and from it; _servers says how many of them may be used at once.
+		*/
+		int const threads = i.threads() * SERVER_MAXIMUM_THREADS_FACTOR;
+		LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), threads, i.host_name ());
+		for (int j = 0; j < threads; ++j) {
 			_threads.push_back (new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, i)));
 		}
 	}
@@ -29,6 +29,7 @@
 #include "cross.h"
 #include "event_history.h"
 #include "exception_store.h"
+#include <dcp/data.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
@@ -36,7 +37,10 @@
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/asio.hpp>
 #include <list>
+#include <map>
+#include <set>
 #include <stdint.h>
 
 class Film;
@@ -45,6 +49,10 @@ class DCPVideo;
 class Writer;
 class Job;
 class PlayerVideo;
+class J2KFrameCache;
+
+/** Maximum number of encoded constant frames to keep; each is typically around 1Mb */
+#define CONSTANT_FRAMES_MAX 32
 
 /** @class J2KEncoder
  *  @brief Class to manage encoding to J2K.
@@ -74,12 +82,18 @@ public:
 	void servers_list_changed ();
 
 private:
+	friend struct constant_frame_table_test;
 
 	static void call_servers_list_changed (boost::weak_ptr<J2KEncoder> encoder);
 
 	void frame_done ();
+	boost::optional<dcp::Data> constant_frame (boost::shared_ptr<const DCPVideo> vf) const;
+	void add_constant_frame (boost::shared_ptr<const DCPVideo> vf, dcp::Data encoded);
 
 	void encoder_thread (boost::optional<EncodeServerDescription>);
+	boost::shared_ptr<DCPVideo> straggler (boost::optional<EncodeServerDescription> server);
+	bool can_take (boost::optional<EncodeServerDescription> server) const;
+	void update_server_state (std::string host, boost::optional<double> round_trip);
 	void terminate_threads ();
 
 	/** Film that we are encoding */
@@ -97,8 +111,94 @@ private:
 	/** condition to manage thread wakeups when we have too much to do */
 	boost::condition _full_condition;
 
+	/** A frame which a thread has taken off the queue to encode */
+	struct InFlight
+	{
+		InFlight ()
+			: workers (0)
+		{}
+
+		InFlight (boost::shared_ptr<DCPVideo> v, std::string h, boost::posix_time::ptime s)
+			: video (v)
+			, host (h)
+			, start (s)
+			, workers (1)
+		{}
+
+		boost::shared_ptr<DCPVideo> video;
+		/** host name of the server that is encoding the frame, or empty for a local thread */
+		std::string host;
+		boost::posix_time::ptime start;
+		/** number of threads encoding the frame; more than 1 if it has been re-dispatched */
+		int workers;
+	};
+
+	typedef std::pair<int, Eyes> InFlightKey;
+	typedef std::map<InFlightKey, InFlight> InFlightMap;
+	/** frames which are being encoded, keyed by index and eyes; protected by _queue_mutex */
+	InFlightMap _in_flight;
+	/** frames which have been re-dispatched by straggler(); a frame stays here even if an
+	    attempt at it fails, so that no frame is re-dispatched more than once.  Protected by
+	    _queue_mutex.
+	*/
+	std::set<InFlightKey> _hedged;
+	/** recent mean time taken to encode a frame in seconds, or empty if not yet known;
+	    protected by _queue_mutex
+	*/
+	boost::optional<double> _mean_encode_time;
+	/** number of local encoding threads; protected by _queue_mutex */
+	int _local_threads;
+	/** number of local encoding threads which are currently encoding a frame; protected by _queue_mutex */
+	int _local_busy;
+
+	/** What we know about a remote server, and how much work we are giving it */
+	struct ServerState
+	{
+		ServerState ()
+			: threads (1)
+			, active (0)
+			, limit (1)
+			, others (0)
+		{}
+
+		/** number of encoding threads on the server */
+		int threads;
+		/** number of our threads which are currently sending it work */
+		int active;
+		/** maximum number of our threads which may send it work at once */
+		int limit;
+		/** estimated number of frames from other masters that it had when we last looked */
+		int others;
+		/** advertised speed at our resolution in frames per second, if known */
+		boost::optional<float> frames_per_second;
+		/** recent shortest time taken to send a frame, have it encoded and get it back, in seconds */
+		boost::optional<double> min_round_trip;
+		/** time that we last looked at the server's advertised speed and load */
+		boost::posix_time::ptime refreshed;
+	};
+
+	/** state of each remote server, keyed by host name; protected by _queue_mutex */
+	std::map<std::string, ServerState> _servers;
+
 	boost::shared_ptr<Writer> _writer;
 	Waker _waker;
+	/** cache of previously-encoded frames, or 0 */
+	boost::shared_ptr<J2KFrameCache> _cache;
+
+	/** threads which convert bands of frames to XYZ for local encodes which have been given
+	    more than one thread; they live as long as we do so that we need not start threads
+	    for each frame.
+	*/
+	boost::thread_group _xyz_pool;
+	boost::asio::io_service _xyz_service;
+	boost::shared_ptr<boost::asio::io_service::work> _xyz_work;
+
+	/** Mutex for _constant_frames */
+	mutable boost::mutex _constant_frames_mutex;
+	/** encoded versions of frames which are known to be constant (e.g. black or still images),
+	    keyed by DCPVideo::constant_key
+	*/
+	std::map<std::string, dcp::Data> _constant_frames;
 
 	boost::shared_ptr<PlayerVideo> _last_player_video[EYES_COUNT];
 	boost::optional<DCPTime> _last_player_video_time;
@@ -0,0 +1,198 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "j2k_frame_cache.h"
+#include <boost/foreach.hpp>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::map;
+using std::sort;
+using boost::optional;
+using dcp::Data;
+
+/** When the cache grows beyond its maximum size we remove frames until it is
+ *  this proportion of the maximum, so that we are not evicting on every put.
+ */
+#define J2K_FRAME_CACHE_EVICT_TO 0.9
+
+/** @param directory Directory to keep cached frames in; will be created if required.
+ *  Frames already in here from previous runs will be used.
+ *  @param max_size Maximum size of the cache in bytes.
+ */
+J2KFrameCache::J2KFrameCache (boost::filesystem::path directory, uint64_t max_size)
+	: _directory (directory)
+	, _max_size (max_size)
+	, _size (0)
+	, _uses (0)
+{
+	boost::filesystem::create_directories (_directory);
+
+	/* Find what is already there, ordered by modification time so that the
+	   least-recently-used frames from previous runs are evicted first.
+	*/
+	vector<pair<std::time_t, pair<string, uint64_t> > > found;
+	for (boost::filesystem::recursive_directory_iterator i (_directory); i != boost::filesystem::recursive_directory_iterator(); ++i) {
+		if (!boost::filesystem::is_regular_file (i->path ())) {
+			continue;
+		}
+
+		if (i->path().extension() == ".tmp") {
+			/* Left over from an interrupted put */
+			boost::system::error_code ec;
+			boost::filesystem::remove (i->path(), ec);
+		} else if (i->path().extension() == ".j2c") {
+			found.push_back (
+				make_pair (
+					boost::filesystem::last_write_time (i->path ()),
+					make_pair (i->path().stem().string(), boost::filesystem::file_size (i->path ()))
+					)
+				);
+		}
+	}
+
+	sort (found.begin(), found.end());
+
+	for (vector<pair<std::time_t, pair<string, uint64_t> > >::const_iterator i = found.begin(); i != found.end(); ++i) {
+		_entries[i->second.first] = Entry (i->second.second, _uses++);
+		_size += i->second.second;
+	}
+}
+
+boost::filesystem::path
+J2KFrameCache::file (string digest) const
+{
+	return _directory / digest.substr (0, 2) / (digest + ".j2c");
+}
+
+/** @return Encoded data for the given digest, or an empty optional if it is not in the cache */
+optional<Data>
+J2KFrameCache::get (string digest)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_entries.find (digest) == _entries.end ()) {
+			return optional<Data> ();
+		}
+	}
+
+	boost::filesystem::path const path = file (digest);
+
+	optional<Data> data;
+	try {
+		data = Data (path);
+	} catch (std::exception& e) {
+		/* It has gone away or is unreadable; forget about it */
+		boost::mutex::scoped_lock lm (_mutex);
+		map<string, Entry>::iterator i = _entries.find (digest);
+		if (i != _entries.end ()) {
+			_size -= i->second.size;
+			_entries.erase (i);
+		}
+		return optional<Data> ();
+	}
+
+	/* Record the use on disk too, so that the next run knows how old this frame is */
+	boost::system::error_code ec;
+	boost::filesystem::last_write_time (path, std::time (0), ec);
+
+	boost::mutex::scoped_lock lm (_mutex);
+	map<string, Entry>::iterator i = _entries.find (digest);
+	if (i != _entries.end ()) {
+		i->second.last_use = _uses++;
+	}
+
+	return data;
+}
+
+/** Add some encoded data to the cache, evicting old frames if the cache has become too big.
+ *  @param digest Digest of the inputs to the encode.
+ *  @param data Encoded data.
+ */
+void
+J2KFrameCache::put (string digest, Data data)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		map<string, Entry>::iterator i = _entries.find (digest);
+		if (i != _entries.end ()) {
+			i->second.last_use = _uses++;
+			return;
+		}
+	}
+
+	boost::filesystem::path const path = file (digest);
+	boost::filesystem::create_directories (path.parent_path ());
+
+	/* Write to a uniquely-named temporary file so that concurrent puts of the same
+	   frame cannot trip over each other, and a reader never sees a partial file.
+	*/
+	data.write_via_temp (path.parent_path() / boost::filesystem::unique_path ("%%%%-%%%%-%%%%-%%%%.tmp"), path);
+
+	vector<boost::filesystem::path> remove;
+
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_entries.find (digest) != _entries.end ()) {
+			/* Someone else put it while we were writing */
+			return;
+		}
+
+		_entries[digest] = Entry (data.size(), _uses++);
+		_size += data.size ();
+
+		if (_size <= _max_size) {
+			return;
+		}
+
+		/* Remove the least-recently-used entries until we are comfortably under the limit */
+		vector<pair<uint64_t, string> > ages;
+		for (map<string, Entry>::const_iterator i = _entries.begin(); i != _entries.end(); ++i) {
+			ages.push_back (make_pair (i->second.last_use, i->first));
+		}
+		sort (ages.begin(), ages.end());
+
+		uint64_t const target = _max_size * J2K_FRAME_CACHE_EVICT_TO;
+		for (vector<pair<uint64_t, string> >::const_iterator i = ages.begin(); i != ages.end() && _size > target; ++i) {
+			map<string, Entry>::iterator j = _entries.find (i->second);
+			_size -= j->second.size;
+			_entries.erase (j);
+			remove.push_back (file (i->second));
+		}
+	}
+
+	/* Do the removals without holding the lock */
+	BOOST_FOREACH (boost::filesystem::path i, remove) {
+		boost::system::error_code ec;
+		boost::filesystem::remove (i, ec);
+	}
+}
+
+uint64_t
+J2KFrameCache::size () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _size;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_J2K_FRAME_CACHE_H
+#define DCPOMATIC_J2K_FRAME_CACHE_H
+
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/optional.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+/** @class J2KFrameCache
+ *  @brief A disk cache of JPEG2000-encoded frames, keyed by a digest of everything
+ *  that went into the encode (see DCPVideo::digest).
+ *
+ *  This means that re-making a DCP after a small change only needs to encode the
+ *  frames whose inputs have actually changed.  The cache is kept below a maximum size
+ *  by removing the least-recently-used frames.  It is safe to call from many threads.
+ */
+class J2KFrameCache : public boost::noncopyable
+{
+public:
+	J2KFrameCache (boost::filesystem::path directory, uint64_t max_size);
+
+	boost::optional<dcp::Data> get (std::string digest);
+	void put (std::string digest, dcp::Data data);
+
+	/** @return Total size of the frames in the cache, in bytes */
+	uint64_t size () const;
+
+private:
+	boost::filesystem::path file (std::string digest) const;
+
+	struct Entry
+	{
+		Entry ()
+			: size (0)
+			, last_use (0)
+		{}
+
+		Entry (uint64_t s, uint64_t l)
+			: size (s)
+			, last_use (l)
+		{}
+
+		uint64_t size;
+		/** value of _uses when this entry was last read or written */
+		uint64_t last_use;
+	};
+
+	boost::filesystem::path _directory;
+	uint64_t _max_size;
+
+	/** Mutex for _entries, _size and _uses */
+	mutable boost::mutex _mutex;
+	std::map<std::string, Entry> _entries;
+	/** total size of the frames in _entries, in bytes */
+	uint64_t _size;
+	/** count of gets and puts, used to order entries by age */
+	uint64_t _uses;
+};
+
+#endif
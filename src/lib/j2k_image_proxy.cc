@@ -21,6 +21,7 @@
 #include "j2k_image_proxy.h"
 #include "dcpomatic_socket.h"
 #include "image.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
 #include <dcp/mono_picture_frame.h>
@@ -205,6 +206,13 @@ J2KImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return memcmp (_data.data().get(), jp->_data.data().get(), _data.size()) == 0;
 }
 
+void
+J2KImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (_data.data().get(), _data.size());
+	digester.add (_forced_reduction.get_value_or (-1));
+}
+
 J2KImageProxy::J2KImageProxy (Data data, dcp::Size size, AVPixelFormat pixel_format)
 	: _data (data)
 	, _size (size)
@@ -59,6 +59,7 @@ public:
 	void send_binary (boost::shared_ptr<Socket>) const;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	bool same (boost::shared_ptr<const ImageProxy>) const;
+	void add_digest (Digester &) const;
 	void prepare (boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const;
 	AVPixelFormat pixel_format () const {
 		return _pixel_format;
@@ -25,6 +25,7 @@
 
 class Content;
 class Decoder;
+class DecoderQueue;
 
 class Piece
 {
@@ -38,6 +39,8 @@ public:
 
 	boost::shared_ptr<Content> content;
 	boost::shared_ptr<Decoder> decoder;
+	/** queue to run decoder; the Player should use this rather than decoder */
+	boost::shared_ptr<DecoderQueue> queue;
 	FrameRateChange frc;
 	bool done;
 };
@@ -38,6 +38,7 @@
 #include "referenced_reel_asset.h"
 #include "decoder_factory.h"
 #include "decoder.h"
+#include "decoder_queue.h"
 #include "video_decoder.h"
 #include "audio_decoder.h"
 #include "subtitle_content.h"
@@ -47,6 +48,7 @@
 #include "content_subtitle.h"
 #include "dcp_decoder.h"
 #include "image_decoder.h"
+#include "image_content.h"
 #include "compose.hpp"
 #include <dcp/reel.h>
 #include <dcp/reel_sound_asset.h>
@@ -87,6 +89,7 @@ Player::Player (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist
 	, _fast (false)
 	, _play_referenced (false)
 	, _audio_merger (_film->audio_frame_rate())
+	, _prerender_thread (0)
 {
 	_film_changed_connection = _film->Changed.connect (bind (&Player::film_changed, this, _1));
 	_playlist_changed_connection = _playlist->Changed.connect (bind (&Player::playlist_changed, this));
@@ -98,9 +101,26 @@ Player::Player (shared_ptr<const Film> film, shared_ptr<const Playlist> playlist
 	seek (DCPTime (), true);
 }
 
+Player::~Player ()
+{
+	if (_prerender_thread) {
+		_prerender_work.reset ();
+		_prerender_service.stop ();
+		_prerender_thread->join ();
+		delete _prerender_thread;
+	}
+}
+
 void
 Player::setup_pieces ()
 {
+	/* Stop any decoding that is going on for the old pieces now, since
+	   _stream_states may keep them alive for a while.
+	*/
+	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
+		i->queue->stop ();
+	}
+
 	_pieces.clear ();
 
 	BOOST_FOREACH (shared_ptr<Content> i, _playlist->content ()) {
@@ -133,28 +153,38 @@ Player::setup_pieces ()
 			dcp->set_forced_reduction (_dcp_decode_reduction);
 		}
 
-		shared_ptr<Piece> piece (new Piece (i, decoder, frc));
-		_pieces.push_back (piece);
+		_pieces.push_back (shared_ptr<Piece> (new Piece (i, decoder, frc)));
+	}
 
-		if (decoder->video) {
-			decoder->video->Data.connect (bind (&Player::video, this, weak_ptr<Piece> (piece), _1));
-		}
+	/* If there is more than one piece, run each decoder in its own thread so that
+	   overlapping content can be decoded in parallel.
+	*/
+	bool const threaded = _pieces.size() > 1;
 
-		if (decoder->audio) {
-			decoder->audio->Data.connect (bind (&Player::audio, this, weak_ptr<Piece> (piece), _1, _2));
-		}
+	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
+		weak_ptr<Piece> wp (i);
+
+		i->queue.reset (
+			new DecoderQueue (
+				i->decoder,
+				threaded,
+				bind (&Player::video_taken, this, wp, _1),
+				bind (&Player::audio_accepted, this, wp, _1, _2)
+				)
+			);
 
-		if (decoder->subtitle) {
-			decoder->subtitle->ImageStart.connect (bind (&Player::image_subtitle_start, this, weak_ptr<Piece> (piece), _1));
-			decoder->subtitle->TextStart.connect (bind (&Player::text_subtitle_start, this, weak_ptr<Piece> (piece), _1));
-			decoder->subtitle->Stop.connect (bind (&Player::subtitle_stop, this, weak_ptr<Piece> (piece), _1));
-		}
+		i->queue->Video.connect (bind (&Player::video, this, wp, _1));
+		i->queue->Audio.connect (bind (&Player::audio, this, wp, _1, _2));
+		i->queue->ImageSubtitleStart.connect (bind (&Player::image_subtitle_start, this, wp, _1));
+		i->queue->TextSubtitleStart.connect (bind (&Player::text_subtitle_start, this, wp, _1));
+		i->queue->SubtitleStop.connect (bind (&Player::subtitle_stop, this, wp, _1));
 	}
 
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
 		if (i->content->audio) {
 			BOOST_FOREACH (AudioStreamPtr j, i->content->audio->streams()) {
 				_stream_states[j] = StreamState (i, i->content->position ());
+				_stream_states[j].mix_plan = AudioMixPlan (j->mapping(), _film->audio_channels());
 			}
 		}
 	}
@@ -189,7 +219,8 @@ Player::playlist_content_changed (weak_ptr<Content> w, int property, bool freque
 		property == SubtitleContentProperty::SHADOW ||
 		property == SubtitleContentProperty::EFFECT_COLOUR ||
 		property == FFmpegContentProperty::SUBTITLE_STREAM ||
-		property == VideoContentProperty::COLOUR_CONVERSION
+		property == VideoContentProperty::COLOUR_CONVERSION ||
+		property == AudioContentProperty::STREAMS
 		) {
 
 		_have_valid_pieces = false;
@@ -255,6 +286,10 @@ Player::film_changed (Film::Property p)
 		*/
 		_have_valid_pieces = false;
 		Changed (false);
+	} else if (p == Film::AUDIO_CHANNELS) {
+		/* Our audio mix plans are made for a particular number of output channels */
+		_have_valid_pieces = false;
+		Changed (false);
 	} else if (p == Film::AUDIO_PROCESSOR) {
 		if (_film->audio_processor ()) {
 			_audio_processor = _film->audio_processor()->clone (_film->audio_frame_rate ());
@@ -310,7 +345,7 @@ Player::transform_image_subtitles (list<ImageSubtitle> subs) const
 shared_ptr<PlayerVideo>
 Player::black_player_video_frame () const
 {
-	return shared_ptr<PlayerVideo> (
+	shared_ptr<PlayerVideo> pv (
 		new PlayerVideo (
 			shared_ptr<const ImageProxy> (new RawImageProxy (_black_image)),
 			Crop (),
@@ -322,6 +357,9 @@ Player::black_player_video_frame () const
 			PresetColourConversion::all().front().conversion
 		)
 	);
+
+	pv->set_constant ("black");
+	return pv;
 }
 
 Frame
@@ -526,7 +564,7 @@ Player::pass ()
 
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
 		if (!i->done) {
-			DCPTime const t = content_time_to_dcp (i, i->decoder->position());
+			DCPTime const t = content_time_to_dcp (i, i->queue->position());
 			/* Given two choices at the same time, pick the one with a subtitle so we see it before
 			   the video.
 			*/
@@ -562,7 +600,7 @@ Player::pass ()
 
 	switch (which) {
 	case CONTENT:
-		earliest_content->done = earliest_content->decoder->pass ();
+		earliest_content->done = earliest_content->queue->pass ();
 		break;
 	case BLACK:
 		emit_video (black_player_video_frame(), _black.position());
@@ -637,8 +675,12 @@ Player::subtitles_for_frame (DCPTime time) const
 	return merge (subtitles);
 }
 
+/** @return true if a video frame from a piece should be taken, ignoring any
+ *  accurate seek that has happened.  This is called from DecoderQueue threads,
+ *  so it must not look at anything that Player changes as it runs.
+ */
 bool
-Player::video (weak_ptr<Piece> wp, ContentVideo video)
+Player::video_taken (weak_ptr<Piece> wp, ContentVideo video) const
 {
 	shared_ptr<Piece> piece = wp.lock ();
 	if (!piece) {
@@ -650,14 +692,26 @@ Player::video (weak_ptr<Piece> wp, ContentVideo video)
 		return false;
 	}
 
+	/* Discard if it's outside the content's period */
+	DCPTime const time = content_video_to_dcp (piece, video.frame);
+	return piece->content->position() <= time && time < piece->content->end();
+}
+
+bool
+Player::video (weak_ptr<Piece> wp, ContentVideo video)
+{
+	shared_ptr<Piece> piece = wp.lock ();
+	if (!piece || !video_taken (wp, video)) {
+		return false;
+	}
+
+	FrameRateChange frc(piece->content->active_video_frame_rate(), _film->video_frame_rate());
+
 	/* Time of the first frame we will emit */
 	DCPTime const time = content_video_to_dcp (piece, video.frame);
 
-	/* Discard if it's outside the content's period or if it's before the last accurate seek */
-	if (
-		time < piece->content->position() ||
-		time >= piece->content->end() ||
-		(_last_video_time && time < *_last_video_time)) {
+	/* Discard if it's before the last accurate seek */
+	if (_last_video_time && time < *_last_video_time) {
 		return false;
 	}
 
@@ -691,6 +745,12 @@ Player::video (weak_ptr<Piece> wp, ContentVideo video)
 			)
 		);
 
+	shared_ptr<ImageContent> image = dynamic_pointer_cast<ImageContent> (piece->content);
+	if (image && image->still() && !image->digest().empty()) {
+		/* Every frame of this content has the same image */
+		_last_video[wp]->set_constant (image->digest ());
+	}
+
 	DCPTime t = time;
 	for (int i = 0; i < frc.repeat; ++i) {
 		emit_video (_last_video[wp], t);
@@ -700,6 +760,39 @@ Player::video (weak_ptr<Piece> wp, ContentVideo video)
 	return true;
 }
 
+/** @return Number of frames of some audio that Player::audio will accept.  This is
+ *  the number of frames passed in unless some are after the end of the content.
+ *  This is called from DecoderQueue threads, so it must not look at anything
+ *  that Player changes as it runs.
+ */
+Frame
+Player::audio_accepted (weak_ptr<Piece> wp, AudioStreamPtr, ContentAudio content_audio) const
+{
+	shared_ptr<Piece> piece = wp.lock ();
+	if (!piece) {
+		return 0;
+	}
+
+	/* Compute time in the DCP */
+	DCPTime const time = resampled_audio_to_dcp (piece, content_audio.frame);
+	/* And the end of this block in the DCP */
+	DCPTime const end = time + DCPTime::from_frames(content_audio.audio->frames(), piece->content->audio->resampled_frame_rate());
+
+	/* We consider frames trimmed off the beginning to nevertheless be `accepted'; it's only frames trimmed
+	   off the end that are considered as discarded.  This logic is necessary to ensure correct reel lengths,
+	   although the precise details escape me at the moment.
+	*/
+	if (time < piece->content->position()) {
+		return content_audio.audio->frames();
+	} else if (time > piece->content->end()) {
+		return 0;
+	} else if (end > piece->content->end()) {
+		return DCPTime(piece->content->end() - time).frames_round(_film->audio_frame_rate());
+	}
+
+	return content_audio.audio->frames();
+}
+
 /** @return Number of input frames that were `accepted'.  This is the number of frames passed in
  *  unless some were discarded at the end of the block.
  */
@@ -718,14 +811,8 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 
 	/* Compute time in the DCP */
 	DCPTime time = resampled_audio_to_dcp (piece, content_audio.frame);
-	/* And the end of this block in the DCP */
-	DCPTime end = time + DCPTime::from_frames(content_audio.audio->frames(), content->resampled_frame_rate());
 
-	/* We consider frames trimmed off the beginning to nevertheless be `accepted'; it's only frames trimmed
-	   off the end that are considered as discarded.  This logic is necessary to ensure correct reel lengths,
-	   although the precise details escape me at the moment.
-	*/
-	Frame accepted = content_audio.audio->frames();
+	Frame const accepted = audio_accepted (wp, stream, content_audio);
 
 	/* Remove anything that comes before the start or after the end of the content */
 	if (time < piece->content->position()) {
@@ -736,18 +823,13 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 		}
 		content_audio.audio = cut.first;
 		time = cut.second;
-	} else if (time > piece->content->end()) {
+	} else if (accepted == 0) {
 		/* Discard it all */
 		return 0;
-	} else if (end > piece->content->end()) {
-		Frame const remaining_frames = DCPTime(piece->content->end() - time).frames_round(_film->audio_frame_rate());
-		if (remaining_frames == 0) {
-			return 0;
-		}
-		shared_ptr<AudioBuffers> cut (new AudioBuffers (content_audio.audio->channels(), remaining_frames));
-		cut->copy_from (content_audio.audio.get(), remaining_frames, 0, 0);
+	} else if (accepted < content_audio.audio->frames()) {
+		shared_ptr<AudioBuffers> cut (new AudioBuffers (content_audio.audio->channels(), accepted));
+		cut->copy_from (content_audio.audio.get(), accepted, 0, 0);
 		content_audio.audio = cut;
-		accepted = content_audio.audio->frames();
 	}
 
 	DCPOMATIC_ASSERT (content_audio.audio->frames() > 0);
@@ -762,7 +844,9 @@ Player::audio (weak_ptr<Piece> wp, AudioStreamPtr stream, ContentAudio content_a
 
 	/* Remap */
 
-	content_audio.audio = remap (content_audio.audio, _film->audio_channels(), stream->mapping());
+	map<AudioStreamPtr, StreamState>::const_iterator state = _stream_states.find (stream);
+	DCPOMATIC_ASSERT (state != _stream_states.end ());
+	content_audio.audio = state->second.mix_plan.run (content_audio.audio);
 
 	/* Process */
 
@@ -841,6 +925,15 @@ Player::text_subtitle_start (weak_ptr<Piece> wp, ContentTextSubtitle subtitle)
 		ps.add_fonts (piece->content->subtitle->fonts ());
 	}
 
+	if (!ps.text.empty() && piece->content->subtitle->use() && (_always_burn_subtitles || piece->content->subtitle->burn())) {
+		/* We're going to be burning this in, so start rendering it now */
+		if (!_prerender_thread) {
+			_prerender_work.reset (new boost::asio::io_service::work (_prerender_service));
+			_prerender_thread = new boost::thread (bind (&boost::asio::io_service::run, &_prerender_service));
+		}
+		_prerender_service.post (bind (&prerender_subtitles, ps.text, ps.fonts, _video_container_size));
+	}
+
 	_active_subtitles.add_from (wp, ps, from);
 }
 
@@ -882,14 +975,15 @@ Player::seek (DCPTime time, bool accurate)
 	BOOST_FOREACH (shared_ptr<Piece> i, _pieces) {
 		if (time < i->content->position()) {
 			/* Before; seek to 0 */
-			i->decoder->seek (ContentTime(), accurate);
+			i->queue->seek (ContentTime(), accurate);
 			i->done = false;
 		} else if (i->content->position() <= time && time < i->content->end()) {
 			/* During; seek to position */
-			i->decoder->seek (dcp_to_content_time (i, time), accurate);
+			i->queue->seek (dcp_to_content_time (i, time), accurate);
 			i->done = false;
 		} else {
 			/* After; this piece is done */
+			i->queue->stop ();
 			i->done = true;
 		}
 	}
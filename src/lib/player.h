@@ -32,9 +32,12 @@
 #include "content_subtitle.h"
 #include "audio_stream.h"
 #include "audio_merger.h"
+#include "audio_mix_plan.h"
 #include "empty.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/thread.hpp>
+#include <boost/asio.hpp>
 #include <list>
 
 namespace dcp {
@@ -54,6 +57,7 @@ class Player : public boost::enable_shared_from_this<Player>, public boost::nonc
 {
 public:
 	Player (boost::shared_ptr<const Film>, boost::shared_ptr<const Playlist> playlist);
+	~Player ();
 
 	bool pass ();
 	void seek (DCPTime time, bool accurate);
@@ -105,7 +109,9 @@ private:
 	ContentTime dcp_to_content_time (boost::shared_ptr<const Piece> piece, DCPTime t) const;
 	DCPTime content_time_to_dcp (boost::shared_ptr<const Piece> piece, ContentTime t) const;
 	boost::shared_ptr<PlayerVideo> black_player_video_frame () const;
+	bool video_taken (boost::weak_ptr<Piece>, ContentVideo) const;
 	bool video (boost::weak_ptr<Piece>, ContentVideo);
+	Frame audio_accepted (boost::weak_ptr<Piece>, AudioStreamPtr, ContentAudio) const;
 	Frame audio (boost::weak_ptr<Piece>, AudioStreamPtr, ContentAudio);
 	void image_subtitle_start (boost::weak_ptr<Piece>, ContentImageSubtitle);
 	void text_subtitle_start (boost::weak_ptr<Piece>, ContentTextSubtitle);
@@ -167,6 +173,8 @@ private:
 
 		boost::shared_ptr<Piece> piece;
 		DCPTime last_push_end;
+		/** Plan to remap this stream's audio, made from its mapping in setup_pieces() */
+		AudioMixPlan mix_plan;
 	};
 	std::map<AudioStreamPtr, StreamState> _stream_states;
 
@@ -176,6 +184,13 @@ private:
 	ActiveSubtitles _active_subtitles;
 	boost::shared_ptr<AudioProcessor> _audio_processor;
 
+	/** Thread to render burnt-in text subtitles as soon as they arrive, so that
+	 *  they are (usually) ready by the time that the video they go on is emitted.
+	 */
+	boost::thread* _prerender_thread;
+	boost::asio::io_service _prerender_service;
+	boost::shared_ptr<boost::asio::io_service::work> _prerender_work;
+
 	boost::signals2::scoped_connection _film_changed_connection;
 	boost::signals2::scoped_connection _playlist_changed_connection;
 	boost::signals2::scoped_connection _playlist_content_changed_connection;
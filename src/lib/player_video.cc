@@ -23,6 +23,7 @@
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
 #include "film.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavutil/pixfmt.h>
@@ -61,7 +62,14 @@ PlayerVideo::PlayerVideo (
 
 }
 
-PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket)
+/** Construct a PlayerVideo from a description sent by a master.
+ *  @param node XML description.
+ *  @param in Source image; the caller must already have read this from the socket,
+ *  or found it in a cache.
+ *  @param socket Socket to read the rest of the binary data from.
+ */
+PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<const ImageProxy> in, shared_ptr<Socket> socket)
+	: _in (in)
 {
 	_crop = Crop (node);
 	_fade = node->optional_number_child<double> ("Fade");
@@ -74,8 +82,6 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 	/* Assume that the ColourConversion uses the current state version */
 	_colour_conversion = ColourConversion::from_xml (node, Film::current_state_version);
 
-	_in = image_proxy_factory (node->node_child ("In"), socket);
-
 	if (node->optional_number_child<int> ("SubtitleX")) {
 
 		shared_ptr<Image> image (
@@ -145,14 +151,20 @@ PlayerVideo::image (dcp::NoteHandler note, function<AVPixelFormat (AVPixelFormat
 	return out;
 }
 
+/** @param in_digest true to include a digest of our source image, so that a server with
+ *  a cache of them can tell us if we need not send it.
+ */
 void
-PlayerVideo::add_metadata (xmlpp::Node* node) const
+PlayerVideo::add_metadata (xmlpp::Node* node, bool in_digest) const
 {
 	_crop.as_xml (node);
 	if (_fade) {
 		node->add_child("Fade")->add_child_text (raw_convert<string> (_fade.get ()));
 	}
 	_in->add_metadata (node->add_child ("In"));
+	if (in_digest) {
+		node->add_child("InDigest")->add_child_text (_in->digest ());
+	}
 	node->add_child("InterWidth")->add_child_text (raw_convert<string> (_inter_size.width));
 	node->add_child("InterHeight")->add_child_text (raw_convert<string> (_inter_size.height));
 	node->add_child("OutWidth")->add_child_text (raw_convert<string> (_out_size.width));
@@ -170,10 +182,13 @@ PlayerVideo::add_metadata (xmlpp::Node* node) const
 	}
 }
 
+/** @param send_in true to send our source image, false if the server already has it */
 void
-PlayerVideo::send_binary (shared_ptr<Socket> socket) const
+PlayerVideo::send_binary (shared_ptr<Socket> socket, bool send_in) const
 {
-	_in->send_binary (socket);
+	if (send_in) {
+		_in->send_binary (socket);
+	}
 	if (_subtitle) {
 		_subtitle->image->write_to_socket (socket);
 	}
@@ -235,6 +250,57 @@ PlayerVideo::same (shared_ptr<const PlayerVideo> other) const
 	return _in->same (other->_in);
 }
 
+/** Add everything that affects the output of image() to a digest, so that
+ *  two PlayerVideos with the same digest will (almost certainly) give the same image.
+ */
+void
+PlayerVideo::add_digest (Digester& digester) const
+{
+	_in->add_digest (digester);
+	add_parameters_digest (digester);
+	if (_subtitle) {
+		_subtitle->image->add_digest (digester);
+		digester.add (_subtitle->position.x);
+		digester.add (_subtitle->position.y);
+	}
+}
+
+/** @return A key which identifies the output of image() without looking at the input image data,
+ *  or an empty optional if we can't make one (because we don't know that our input is constant,
+ *  or we have a subtitle or fade).
+ */
+optional<string>
+PlayerVideo::constant_key () const
+{
+	if (!_constant || _subtitle || _fade) {
+		return optional<string> ();
+	}
+
+	Digester digester;
+	digester.add (_constant.get ());
+	add_parameters_digest (digester);
+	return digester.get ();
+}
+
+void
+PlayerVideo::add_parameters_digest (Digester& digester) const
+{
+	digester.add (_crop.left);
+	digester.add (_crop.right);
+	digester.add (_crop.top);
+	digester.add (_crop.bottom);
+	digester.add (_fade.get_value_or (1));
+	digester.add (_inter_size.width);
+	digester.add (_inter_size.height);
+	digester.add (_out_size.width);
+	digester.add (_out_size.height);
+	digester.add (static_cast<int> (_eyes));
+	digester.add (static_cast<int> (_part));
+	if (_colour_conversion) {
+		digester.add (_colour_conversion->identifier ());
+	}
+}
+
 AVPixelFormat
 PlayerVideo::always_rgb (AVPixelFormat)
 {
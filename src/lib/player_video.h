@@ -34,6 +34,7 @@ extern "C" {
 class Image;
 class ImageProxy;
 class Socket;
+class Digester;
 
 /** Everything needed to describe a video frame coming out of the player, but with the
  *  bits still their raw form.  We may want to combine the bits on a remote machine,
@@ -53,7 +54,7 @@ public:
 		boost::optional<ColourConversion>
 		);
 
-	PlayerVideo (boost::shared_ptr<cxml::Node>, boost::shared_ptr<Socket>);
+	PlayerVideo (boost::shared_ptr<cxml::Node>, boost::shared_ptr<const ImageProxy>, boost::shared_ptr<Socket>);
 
 	void set_subtitle (PositionImage);
 
@@ -63,8 +64,8 @@ public:
 	static AVPixelFormat always_rgb (AVPixelFormat);
 	static AVPixelFormat keep_xyz_or_rgb (AVPixelFormat);
 
-	void add_metadata (xmlpp::Node* node) const;
-	void send_binary (boost::shared_ptr<Socket> socket) const;
+	void add_metadata (xmlpp::Node* node, bool in_digest) const;
+	void send_binary (boost::shared_ptr<Socket> socket, bool send_in) const;
 
 	bool has_j2k () const;
 	dcp::Data j2k () const;
@@ -90,8 +91,20 @@ public:
 	}
 
 	bool same (boost::shared_ptr<const PlayerVideo> other) const;
+	void add_digest (Digester& digester) const;
+
+	/** Say that our input image is the same as that of any other PlayerVideo
+	 *  which is given the same identifier (e.g. because it is black, or from a still image).
+	 */
+	void set_constant (std::string id) {
+		_constant = id;
+	}
+
+	boost::optional<std::string> constant_key () const;
 
 private:
+	void add_parameters_digest (Digester& digester) const;
+
 	boost::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
 	boost::optional<double> _fade;
@@ -101,6 +114,8 @@ private:
 	Part _part;
 	boost::optional<ColourConversion> _colour_conversion;
 	boost::optional<PositionImage> _subtitle;
+	/** identifier of our input image if it is known to be constant */
+	boost::optional<std::string> _constant;
 };
 
 #endif
@@ -547,8 +547,12 @@ Playlist::content_summary (DCPTimePeriod period) const
 bool
 Playlist::video_content_at (DCPTime time) const
 {
+	/* _content is sorted by position, so we can stop once we reach content which starts after `time' */
 	BOOST_FOREACH (shared_ptr<Content> i, _content) {
-		if (i->video && i->position() <= time && time < i->end()) {
+		if (i->position() > time) {
+			break;
+		}
+		if (i->video && time < i->end()) {
 			return true;
 		}
 	}
@@ -560,10 +564,10 @@ bool
 Playlist::audio_content_at (DCPTime time) const
 {
 	BOOST_FOREACH (shared_ptr<Content> i, _content) {
-		if (!i->audio) {
-			continue;
+		if (i->position() > time) {
+			break;
 		}
-		if (i->position() <= time && time < i->end()) {
+		if (i->audio && time < i->end()) {
 			return true;
 		}
 	}
@@ -20,6 +20,7 @@
 
 #include "raw_image_proxy.h"
 #include "image.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 #include <dcp/util.h>
 #include <libcxml/cxml.h>
@@ -84,6 +85,12 @@ RawImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return (*_image.get()) == (*rp->image().get());
 }
 
+void
+RawImageProxy::add_digest (Digester& digester) const
+{
+	_image->add_digest (digester);
+}
+
 AVPixelFormat
 RawImageProxy::pixel_format () const
 {
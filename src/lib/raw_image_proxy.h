@@ -37,6 +37,7 @@ public:
 	void add_metadata (xmlpp::Node *) const;
 	void send_binary (boost::shared_ptr<Socket>) const;
 	bool same (boost::shared_ptr<const ImageProxy>) const;
+	void add_digest (Digester &) const;
 	AVPixelFormat pixel_format () const;
 
 private:
@@ -24,6 +24,7 @@
 #include "cross.h"
 #include "font.h"
 #include "dcpomatic_assert.h"
+#include "compose.hpp"
 #include <dcp/raw_convert.h>
 #include <fontconfig/fontconfig.h>
 #include <cairomm/cairomm.h>
@@ -32,6 +33,7 @@
 #include <pango/pangocairo.h>
 #endif
 #include <boost/foreach.hpp>
+#include <boost/thread/mutex.hpp>
 #include <iostream>
 
 using std::list;
@@ -42,11 +44,16 @@ using std::max;
 using std::pair;
 using std::cerr;
 using std::make_pair;
+using std::map;
 using boost::shared_ptr;
 using boost::optional;
 
+/** Maximum size of the cache of rendered subtitle images, in bytes */
+#define RENDERED_SUBTITLE_CACHE_SIZE (128 * 1024 * 1024)
+
 static FcConfig* fc_config = 0;
 static list<pair<FontFiles, string> > fc_config_fonts;
+static boost::mutex render_mutex;
 
 string
 marked_up (list<SubtitleString> subtitles, int target_height, float fade_factor)
@@ -83,9 +90,36 @@ set_source_rgba (Cairo::RefPtr<Cairo::Context> context, dcp::Colour colour, floa
 
 /** @param subtitles A list of subtitles that are all on the same line,
  *  at the same time and with the same fade in/out.
+ *  @param time Time of the frame that the subtitles are going on.
+ *  @return Amount (from 0 to 1) by which the subtitles are faded in at the given time.
+ */
+static float
+fade_factor (list<SubtitleString> const & subtitles, DCPTime time)
+{
+	float fade_factor = 1;
+
+	DCPTime const fade_in_start = DCPTime::from_seconds (subtitles.front().in().as_seconds ());
+	DCPTime const fade_in_end = fade_in_start + DCPTime::from_seconds (subtitles.front().fade_up_time().as_seconds ());
+	DCPTime const fade_out_end =  DCPTime::from_seconds (subtitles.front().out().as_seconds ());
+	DCPTime const fade_out_start = fade_out_end - DCPTime::from_seconds (subtitles.front().fade_down_time().as_seconds ());
+	if (fade_in_start <= time && time <= fade_in_end && fade_in_start != fade_in_end) {
+		fade_factor = DCPTime(time - fade_in_start).seconds() / DCPTime(fade_in_end - fade_in_start).seconds();
+	} else if (fade_out_start <= time && time <= fade_out_end && fade_out_start != fade_out_end) {
+		fade_factor = 1 - DCPTime(time - fade_out_start).seconds() / DCPTime(fade_out_end - fade_out_start).seconds();
+	} else if (time < fade_in_start || time > fade_out_end) {
+		fade_factor = 0;
+	}
+
+	return fade_factor;
+}
+
+/** render_mutex must be held by the caller.
+ *  @param subtitles A list of subtitles that are all on the same line,
+ *  at the same time and with the same fade in/out.
+ *  @param fade_factor Amount (from 0 to 1) by which the subtitles are faded in.
  */
 static PositionImage
-render_line (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target, DCPTime time)
+render_line (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target, float fade_factor)
 {
 	/* XXX: this method can only handle italic / bold changes mid-line,
 	   nothing else yet.
@@ -237,21 +271,6 @@ render_line (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp:
 
 	context->set_line_width (1);
 
-	/* Compute fade factor */
-	float fade_factor = 1;
-
-	DCPTime const fade_in_start = DCPTime::from_seconds (subtitles.front().in().as_seconds ());
-	DCPTime const fade_in_end = fade_in_start + DCPTime::from_seconds (subtitles.front().fade_up_time().as_seconds ());
-	DCPTime const fade_out_end =  DCPTime::from_seconds (subtitles.front().out().as_seconds ());
-	DCPTime const fade_out_start = fade_out_end - DCPTime::from_seconds (subtitles.front().fade_down_time().as_seconds ());
-	if (fade_in_start <= time && time <= fade_in_end && fade_in_start != fade_in_end) {
-		fade_factor = DCPTime(time - fade_in_start).seconds() / DCPTime(fade_in_end - fade_in_start).seconds();
-	} else if (fade_out_start <= time && time <= fade_out_end && fade_out_start != fade_out_end) {
-		fade_factor = 1 - DCPTime(time - fade_out_start).seconds() / DCPTime(fade_out_end - fade_out_start).seconds();
-	} else if (time < fade_in_start || time > fade_out_end) {
-		fade_factor = 0;
-	}
-
 	/* Render the subtitle at the top left-hand corner of image */
 
 	Pango::FontDescription font (font_name);
@@ -342,24 +361,163 @@ render_line (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp:
 	return PositionImage (image, Position<int> (max (0, x), max (0, y)));
 }
 
-/** @param time Time of the frame that these subtitles are going on */
-list<PositionImage>
-render_subtitles (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target, DCPTime time)
+/** @return Key which identifies how a line of subtitles will be rendered.  This includes
+ *  everything that render_line() uses apart from the timing, which only matters for
+ *  fades and so is covered by the fade factor.
+ */
+static string
+line_key (list<SubtitleString> const & subtitles, list<shared_ptr<Font> > const & fonts, dcp::Size target, float fade_factor)
 {
+	string key = String::compose ("%1x%2:%3", target.width, target.height, fade_factor);
+
+	BOOST_FOREACH (shared_ptr<Font> i, fonts) {
+		if (i->id() == subtitles.front().font()) {
+			for (int j = 0; j < FontFiles::VARIANTS; ++j) {
+				optional<boost::filesystem::path> f = i->file (static_cast<FontFiles::Variant> (j));
+				key += ":" + (f ? f->string() : "");
+			}
+		}
+	}
+
+	BOOST_FOREACH (SubtitleString const & i, subtitles) {
+		key += String::compose (
+			":%1:%2:%3:%4:%5:%6:%7:%8:%9",
+			i.font().get_value_or(""), i.italic(), i.bold(), i.underline(), i.colour().to_rgb_string(), i.size(), i.aspect_adjust(), i.h_position(), i.h_align()
+			);
+		key += String::compose (
+			":%1:%2:%3:%4:%5:%6:%7",
+			i.v_position(), i.v_align(), i.effect(), i.effect_colour().to_rgb_string(), i.outline_width, i.text().length(), i.text()
+			);
+	}
+
+	return key;
+}
+
+/** Cache of rendered lines of subtitles, so that we don't re-render a subtitle for
+ *  every frame that it is on screen.
+ */
+class RenderedSubtitleCache
+{
+public:
+	RenderedSubtitleCache ()
+		: _size (0)
+	{}
+
+	optional<PositionImage> get (string key)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		Map::iterator i = _images.find (key);
+		if (i == _images.end ()) {
+			return optional<PositionImage> ();
+		}
+
+		/* Move this entry to the front of the list as it is now the most recently used */
+		_order.splice (_order.begin(), _order, i->second.second);
+		return i->second.first;
+	}
+
+	void put (string key, PositionImage image)
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		if (_images.find (key) != _images.end ()) {
+			return;
+		}
+
+		_order.push_front (key);
+		_images[key] = make_pair (image, _order.begin ());
+		_size += size (image);
+
+		while (_size > RENDERED_SUBTITLE_CACHE_SIZE && _order.size() > 1) {
+			Map::iterator i = _images.find (_order.back ());
+			_size -= size (i->second.first);
+			_images.erase (i);
+			_order.pop_back ();
+		}
+	}
+
+private:
+	static int64_t size (PositionImage const & image)
+	{
+		return int64_t (image.image->stride()[0]) * image.image->size().height;
+	}
+
+	boost::mutex _mutex;
+	/** Keys in order of use, most recent first */
+	list<string> _order;
+	typedef map<string, pair<PositionImage, list<string>::iterator> > Map;
+	Map _images;
+	/** Total size of the images in _images, in bytes */
+	int64_t _size;
+};
+
+static RenderedSubtitleCache rendered_subtitle_cache;
+
+static PositionImage
+render_line_cached (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target, float fade_factor)
+{
+	string const key = line_key (subtitles, fonts, target, fade_factor);
+	optional<PositionImage> cached = rendered_subtitle_cache.get (key);
+	if (cached) {
+		return *cached;
+	}
+
+	/* fontconfig and Pango use global state, so only render one line at a time */
+	boost::mutex::scoped_lock lm (render_mutex);
+
+	/* Another thread may have rendered this line while we were waiting for the lock */
+	cached = rendered_subtitle_cache.get (key);
+	if (cached) {
+		return *cached;
+	}
+
+	PositionImage image = render_line (subtitles, fonts, target, fade_factor);
+	rendered_subtitle_cache.put (key, image);
+	return image;
+}
+
+/** Split some subtitles up into lines which can be passed to render_line() */
+static list<list<SubtitleString> >
+split_lines (list<SubtitleString> subtitles)
+{
+	list<list<SubtitleString> > lines;
 	list<SubtitleString> pending;
-	list<PositionImage> images;
 
 	BOOST_FOREACH (SubtitleString const & i, subtitles) {
 		if (!pending.empty() && fabs (i.v_position() - pending.back().v_position()) > 1e-4) {
-			images.push_back (render_line (pending, fonts, target, time));
+			lines.push_back (pending);
 			pending.clear ();
 		}
 		pending.push_back (i);
 	}
 
 	if (!pending.empty ()) {
-		images.push_back (render_line (pending, fonts, target, time));
+		lines.push_back (pending);
+	}
+
+	return lines;
+}
+
+/** @param time Time of the frame that these subtitles are going on */
+list<PositionImage>
+render_subtitles (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target, DCPTime time)
+{
+	list<PositionImage> images;
+
+	BOOST_FOREACH (list<SubtitleString> const & i, split_lines (subtitles)) {
+		images.push_back (render_line_cached (i, fonts, target, fade_factor (i, time)));
 	}
 
 	return images;
 }
+
+/** Render some subtitles as they will look when they are not fading in or out, and
+ *  keep the results so that subsequent calls to render_subtitles() are quick.
+ *  This may be called from any thread.
+ */
+void
+prerender_subtitles (list<SubtitleString> subtitles, list<shared_ptr<Font> > fonts, dcp::Size target)
+{
+	BOOST_FOREACH (list<SubtitleString> const & i, split_lines (subtitles)) {
+		render_line_cached (i, fonts, target, 1);
+	}
+}
@@ -29,3 +29,4 @@ std::string marked_up (std::list<SubtitleString> subtitles, int target_height, f
 std::list<PositionImage> render_subtitles (
 	std::list<SubtitleString>, std::list<boost::shared_ptr<Font> > fonts, dcp::Size, DCPTime
 	);
+void prerender_subtitles (std::list<SubtitleString>, std::list<boost::shared_ptr<Font> > fonts, dcp::Size);
@@ -0,0 +1,227 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "rgb_to_xyz.h"
+#include "image.h"
+#include "colour_conversion.h"
+#include "dcpomatic_assert.h"
+#include "compose.hpp"
+#include <dcp/rgb_xyz.h>
+#include <dcp/transfer_function.h>
+#include <dcp/openjpeg_image.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <cmath>
+
+/** Number of different sets of tables to keep */
+#define RGB_TO_XYZ_CACHE_SIZE 8
+
+using std::string;
+using std::vector;
+using std::map;
+using std::min;
+using std::max;
+using boost::shared_ptr;
+
+boost::mutex RGBToXYZ::_cache_mutex;
+map<string, shared_ptr<const RGBToXYZ> > RGBToXYZ::_cache;
+
+RGBToXYZ::RGBToXYZ (ColourConversion const & conversion)
+	: _lut_in (4096)
+	, _lut_out (65536)
+{
+	dcp::combined_rgb_to_xyz (conversion, _matrix);
+
+	double const * lut_in = conversion.in()->lut (12, false);
+	for (int i = 0; i < 4096; ++i) {
+		_lut_in[i] = lut_in[i];
+	}
+
+	double const * lut_out = conversion.out()->lut (16, true);
+	for (int i = 0; i < 65536; ++i) {
+		_lut_out[i] = lrint (lut_out[i] * 4095);
+	}
+}
+
+/** @return Tables for a conversion; these are made the first time they are asked for,
+ *  and then re-used.
+ */
+shared_ptr<const RGBToXYZ>
+RGBToXYZ::get (ColourConversion const & conversion)
+{
+	string const id = conversion.identifier ();
+
+	boost::mutex::scoped_lock lm (_cache_mutex);
+
+	map<string, shared_ptr<const RGBToXYZ> >::const_iterator i = _cache.find (id);
+	if (i != _cache.end ()) {
+		return i->second;
+	}
+
+	if (_cache.size() >= RGB_TO_XYZ_CACHE_SIZE) {
+		_cache.clear ();
+	}
+
+	shared_ptr<const RGBToXYZ> tables (new RGBToXYZ (conversion));
+	_cache[id] = tables;
+	return tables;
+}
+
+/** @param image RGB48LE image to convert.
+ *  @param note Handler for any notes that occur.
+ *  @param threads Number of threads to use; if this is more than 1 the image is split
+ *  into bands of rows and all but the first are given to pool, so that they can be
+ *  converted at the same time.
+ *  @param pool Pool of threads to give bands to, or 0 to convert the whole image in the
+ *  calling thread.
+ *  @return 12-bit XYZ image.
+ */
+shared_ptr<dcp::OpenJPEGImage>
+RGBToXYZ::convert (shared_ptr<const Image> image, dcp::NoteHandler note, int threads, boost::asio::io_service* pool) const
+{
+	DCPOMATIC_ASSERT (image->pixel_format() == AV_PIX_FMT_RGB48LE);
+
+	dcp::Size const size = image->size ();
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (size));
+
+	if (!pool) {
+		threads = 1;
+	}
+
+	threads = max (1, min (threads, size.height));
+	vector<int> clamped (threads, 0);
+
+	/* Give every band except the first to the pool; we do the first ourselves */
+	Bands bands;
+	bands.remaining = threads - 1;
+	for (int i = 1; i < threads; ++i) {
+		pool->post (
+			boost::bind (&RGBToXYZ::convert_band, this, image, xyz, size.height * i / threads, size.height * (i + 1) / threads, &clamped[i], &bands)
+			);
+	}
+
+	convert_rows (image, xyz, 0, size.height / threads, &clamped[0]);
+
+	/* Help the pool with anything that it has not yet started (which may include our bands),
+	   then wait for whatever it is still working on.
+	*/
+	boost::mutex::scoped_lock lm (bands.mutex);
+	while (bands.remaining > 0) {
+		lm.unlock ();
+		bool const ran = pool->poll_one ();
+		lm.lock ();
+		if (!ran) {
+			while (bands.remaining > 0) {
+				bands.condition.wait (lm);
+			}
+		}
+	}
+	lm.unlock ();
+
+	int total_clamped = 0;
+	BOOST_FOREACH (int i, clamped) {
+		total_clamped += i;
+	}
+
+	if (total_clamped && note) {
+		note (dcp::DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", total_clamped));
+	}
+
+	return xyz;
+}
+
+/** Convert a band of an image which was given to a pool by convert(), then tell convert() that it is done */
+void
+RGBToXYZ::convert_band (shared_ptr<const Image> image, shared_ptr<dcp::OpenJPEGImage> xyz, int start, int end, int* clamped, Bands* bands) const
+{
+	convert_rows (image, xyz, start, end, clamped);
+
+	boost::mutex::scoped_lock lm (bands->mutex);
+	--bands->remaining;
+	bands->condition.notify_all ();
+}
+
+/** Convert some rows of an image.
+ *  @param image RGB48LE image.
+ *  @param xyz Image to write XYZ to.
+ *  @param start First row to convert.
+ *  @param end Row after the last one to convert.
+ *  @param clamped Filled in with the number of pixels which had to be clamped.
+ */
+void
+RGBToXYZ::convert_rows (shared_ptr<const Image> image, shared_ptr<dcp::OpenJPEGImage> xyz, int start, int end, int* clamped) const
+{
+	int const width = image->size().width;
+
+	int* xyz_x = xyz->data (0) + start * width;
+	int* xyz_y = xyz->data (1) + start * width;
+	int* xyz_z = xyz->data (2) + start * width;
+
+	/* One row of linear RGB, then of 16-bit XYZ */
+	vector<double> r (width);
+	vector<double> g (width);
+	vector<double> b (width);
+	vector<double> x (width);
+	vector<double> y (width);
+	vector<double> z (width);
+
+	double const * lut_in = &_lut_in[0];
+	int const * lut_out = &_lut_out[0];
+	double const * m = _matrix;
+
+	int n = 0;
+
+	for (int row = start; row < end; ++row) {
+		uint16_t const * p = reinterpret_cast<uint16_t const *> (image->data()[0] + row * image->stride()[0]);
+
+		/* Input gamma LUT (converting 16-bit to 12-bit) */
+		for (int i = 0; i < width; ++i) {
+			r[i] = lut_in[p[0] >> 4];
+			g[i] = lut_in[p[1] >> 4];
+			b[i] = lut_in[p[2] >> 4];
+			p += 3;
+		}
+
+		/* RGB to XYZ, including Bradford transform and DCI companding, then clamp;
+		   there are no branches or lookups here so the compiler can vectorise it.
+		*/
+		for (int i = 0; i < width; ++i) {
+			double const dx = r[i] * m[0] + g[i] * m[1] + b[i] * m[2];
+			double const dy = r[i] * m[3] + g[i] * m[4] + b[i] * m[5];
+			double const dz = r[i] * m[6] + g[i] * m[7] + b[i] * m[8];
+
+			n += (dx < 0) | (dy < 0) | (dz < 0) | (dx > 65535) | (dy > 65535) | (dz > 65535);
+
+			x[i] = min (65535.0, max (0.0, dx));
+			y[i] = min (65535.0, max (0.0, dy));
+			z[i] = min (65535.0, max (0.0, dz));
+		}
+
+		/* Output gamma LUT, straight into the image for the encoder */
+		for (int i = 0; i < width; ++i) {
+			*xyz_x++ = lut_out[lrint (x[i])];
+			*xyz_y++ = lut_out[lrint (y[i])];
+			*xyz_z++ = lut_out[lrint (z[i])];
+		}
+	}
+
+	*clamped = n;
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_RGB_TO_XYZ_H
+#define DCPOMATIC_RGB_TO_XYZ_H
+
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/asio.hpp>
+#include <vector>
+#include <map>
+#include <string>
+
+class Image;
+class ColourConversion;
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+/** @class RGBToXYZ
+ *  @brief Tables to convert RGB48LE images to 12-bit XYZ ready for JPEG2000 encoding,
+ *  using a particular ColourConversion.
+ *
+ *  This does the same job as dcp::rgb_to_xyz, and gives the same results, but the tables
+ *  are only built once for each ColourConversion, the output gamma is done with a single
+ *  integer table lookup and the matrix multiply is done a row at a time in a loop which the
+ *  compiler can vectorise.
+ */
+class RGBToXYZ : public boost::noncopyable
+{
+public:
+	static boost::shared_ptr<const RGBToXYZ> get (ColourConversion const & conversion);
+
+	boost::shared_ptr<dcp::OpenJPEGImage> convert (
+		boost::shared_ptr<const Image> image, dcp::NoteHandler note, int threads = 1, boost::asio::io_service* pool = 0
+		) const;
+
+private:
+	explicit RGBToXYZ (ColourConversion const & conversion);
+
+	/** Bands of an image which have been given to a pool to convert */
+	struct Bands
+	{
+		boost::mutex mutex;
+		boost::condition condition;
+		/** number of bands which are not yet finished; protected by mutex */
+		int remaining;
+	};
+
+	void convert_rows (boost::shared_ptr<const Image> image, boost::shared_ptr<dcp::OpenJPEGImage> xyz, int start, int end, int* clamped) const;
+	void convert_band (
+		boost::shared_ptr<const Image> image, boost::shared_ptr<dcp::OpenJPEGImage> xyz, int start, int end, int* clamped, Bands* bands
+		) const;
+
+	/** input gamma LUT, indexed by 12-bit RGB value */
+	std::vector<double> _lut_in;
+	/** output gamma LUT, indexed by 16-bit XYZ value, giving 12-bit XYZ */
+	std::vector<int> _lut_out;
+	/** RGB to XYZ matrix including the Bradford transform and DCI companding */
+	double _matrix[9];
+
+	static boost::mutex _cache_mutex;
+	/** tables that we have made, keyed by ColourConversion::identifier() */
+	static std::map<std::string, boost::shared_ptr<const RGBToXYZ> > _cache;
+};
+
+#endif
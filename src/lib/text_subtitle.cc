@@ -28,6 +28,7 @@
 #include <unicode/ucsdet.h>
 #include <unicode/ucnv.h>
 #include <iostream>
+#include <algorithm>
 
 #include "i18n.h"
 
@@ -38,6 +39,12 @@ using boost::shared_ptr;
 using boost::scoped_array;
 using dcp::Data;
 
+static bool
+subtitle_from_sorter (sub::Subtitle const & a, sub::Subtitle const & b)
+{
+	return a.from.all_as_seconds() < b.from.all_as_seconds();
+}
+
 TextSubtitle::TextSubtitle (shared_ptr<const TextSubtitleContent> content)
 {
 	Data in (content->path (0));
@@ -80,6 +87,8 @@ TextSubtitle::TextSubtitle (shared_ptr<const TextSubtitleContent> content)
 
 	if (reader) {
 		_subtitles = sub::collect<vector<sub::Subtitle> > (reader->subtitles ());
+		/* Make sure that we are sorted by start time so that decoders can binary-search */
+		stable_sort (_subtitles.begin(), _subtitles.end(), subtitle_from_sorter);
 	}
 
 	delete reader;
@@ -24,6 +24,7 @@
 #include <dcp/subtitle_string.h>
 #include <boost/foreach.hpp>
 #include <iostream>
+#include <algorithm>
 
 using std::list;
 using std::vector;
@@ -34,6 +35,12 @@ using boost::shared_ptr;
 using boost::optional;
 using boost::dynamic_pointer_cast;
 
+static bool
+subtitle_from_before (sub::Subtitle const & s, ContentTime t)
+{
+	return ContentTime::from_seconds (s.from.all_as_seconds ()) < t;
+}
+
 TextSubtitleDecoder::TextSubtitleDecoder (shared_ptr<const TextSubtitleContent> content, shared_ptr<Log> log)
 	: TextSubtitle (content)
 	, _next (0)
@@ -54,10 +61,7 @@ TextSubtitleDecoder::seek (ContentTime time, bool accurate)
 
 	Decoder::seek (time, accurate);
 
-	_next = 0;
-	while (_next < _subtitles.size() && ContentTime::from_seconds (_subtitles[_next].from.all_as_seconds ()) < time) {
-		++_next;
-	}
+	_next = lower_bound (_subtitles.begin(), _subtitles.end(), time, subtitle_from_before) - _subtitles.begin();
 }
 
 bool
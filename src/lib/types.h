@@ -46,7 +46,14 @@ namespace xmlpp {
  *  with servers.  Intended to be bumped when incompatibilities
  *  are introduced.  v2 uses 64+n
  */
-#define SERVER_LINK_VERSION (64+0)
+#define SERVER_LINK_VERSION (64+2)
+
+/** Sent by an encode server as soon as it starts to read a request from a master */
+#define ENCODE_SERVER_READY 0
+/** Sent by an encode server instead of ENCODE_SERVER_READY if it already has too many
+ *  requests waiting; it then closes the connection without reading the request.
+ */
+#define ENCODE_SERVER_BUSY 1
 
 /** A film of F seconds at f FPS will be Ff frames;
     Consider some delta FPS d, so if we run the same
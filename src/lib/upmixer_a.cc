@@ -37,7 +37,12 @@ UpmixerA::UpmixerA (int sampling_rate)
 	, _ls (0.02, 4800.0 / sampling_rate, 20000.0 / sampling_rate)
 	, _rs (0.02, 4800.0 / sampling_rate, 20000.0 / sampling_rate)
 {
-
+	_left.set_use_fft (true);
+	_right.set_use_fft (true);
+	_centre.set_use_fft (true);
+	_lfe.set_use_fft (true);
+	_ls.set_use_fft (true);
+	_rs.set_use_fft (true);
 }
 
 string
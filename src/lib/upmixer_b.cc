@@ -33,7 +33,7 @@ UpmixerB::UpmixerB (int sampling_rate)
 	: _lfe (0.01, 150.0 / sampling_rate)
 	, _delay (0.02 * sampling_rate)
 {
-
+	_lfe.set_use_fft (true);
 }
 
 string
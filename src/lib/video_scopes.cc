@@ -0,0 +1,331 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/video_scopes.cc
+ *  @brief VideoScopeData and VideoScopes classes.
+ */
+
+#include "video_scopes.h"
+#include "dcp_video.h"
+#include "player_video.h"
+#include "image.h"
+#include "dcpomatic_assert.h"
+#include <dcp/openjpeg_image.h>
+#include <boost/bind.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::min;
+using std::max;
+using std::vector;
+using boost::shared_ptr;
+
+#if VIDEO_SCOPES_VALUES * 2 / VIDEO_SCOPES_VECTORSCOPE_SIZE != 32
+#error VideoScopeData expects each vectorscope position to cover 32 component value differences
+#endif
+
+/** @param image XYZ image to analyse.
+ *  @param waveform_size Size of the waveforms to make; the width will be
+ *  reduced to the width of the image if it is larger.
+ */
+VideoScopeData::VideoScopeData (shared_ptr<dcp::OpenJPEGImage> image, dcp::Size waveform_size)
+	: _image_size (image->size ())
+	, _waveform_size (min (waveform_size.width, image->size().width), waveform_size.height)
+{
+	DCPOMATIC_ASSERT (_waveform_size.width > 0 && _waveform_size.height > 0);
+
+	for (int i = 0; i < 3; ++i) {
+		_waveform[i].resize (_waveform_size.width * _waveform_size.height);
+		_histogram[i].resize (VIDEO_SCOPES_VALUES);
+	}
+	_vectorscope.resize (VIDEO_SCOPES_VECTORSCOPE_SIZE * VIDEO_SCOPES_VECTORSCOPE_SIZE);
+
+	int const width = _image_size.width;
+
+	/* Offset into the waveform of the column for each image x, and of the
+	   row for each component value.
+	*/
+	vector<int> column (width);
+	for (int x = 0; x < width; ++x) {
+		column[x] = int64_t (x) * _waveform_size.width / width;
+	}
+	vector<int> row (VIDEO_SCOPES_VALUES);
+	for (int v = 0; v < VIDEO_SCOPES_VALUES; ++v) {
+		row[v] = (v * _waveform_size.height / VIDEO_SCOPES_VALUES) * _waveform_size.width;
+	}
+
+	uint32_t* waveform[3] = { &_waveform[0][0], &_waveform[1][0], &_waveform[2][0] };
+	uint32_t* histogram[3] = { &_histogram[0][0], &_histogram[1][0], &_histogram[2][0] };
+	uint32_t* vectorscope = &_vectorscope[0];
+
+	/* Go through the image a row at a time so that we read each component
+	   sequentially; counts for nearby pixels are usually close to each other
+	   in the waveform since adjacent columns are adjacent in memory.
+	*/
+	for (int y = 0; y < _image_size.height; ++y) {
+		int const * p[3];
+		for (int c = 0; c < 3; ++c) {
+			p[c] = image->data(c) + y * width;
+		}
+
+		int x = 0;
+
+#ifdef __SSE2__
+		__m128 const lowest = _mm_setzero_ps ();
+		__m128 const highest = _mm_set1_ps (VIDEO_SCOPES_VALUES - 1);
+		__m128i const offset = _mm_set1_epi32 (VIDEO_SCOPES_VALUES);
+
+		int value[3][4];
+		int vector_index[4];
+
+		for (; x <= width - 4; x += 4) {
+			__m128i v[3];
+			for (int c = 0; c < 3; ++c) {
+				/* Clamp values to the valid range (via float, since SSE2 has no 32-bit integer min/max) */
+				__m128 f = _mm_cvtepi32_ps (_mm_loadu_si128 (reinterpret_cast<__m128i const *> (p[c] + x)));
+				f = _mm_min_ps (_mm_max_ps (f, lowest), highest);
+				v[c] = _mm_cvttps_epi32 (f);
+				_mm_storeu_si128 (reinterpret_cast<__m128i *> (value[c]), v[c]);
+			}
+
+			/* Vectorscope position is ((X' - Y' + 4096) / 32, (Z' - Y' + 4096) / 32) */
+			__m128i const u = _mm_srai_epi32 (_mm_add_epi32 (_mm_sub_epi32 (v[0], v[1]), offset), 5);
+			__m128i const w = _mm_srai_epi32 (_mm_add_epi32 (_mm_sub_epi32 (v[2], v[1]), offset), 5);
+			_mm_storeu_si128 (reinterpret_cast<__m128i *> (vector_index), _mm_add_epi32 (_mm_slli_epi32 (w, 8), u));
+
+			for (int i = 0; i < 4; ++i) {
+				for (int c = 0; c < 3; ++c) {
+					++waveform[c][row[value[c][i]] + column[x + i]];
+					++histogram[c][value[c][i]];
+				}
+				++vectorscope[vector_index[i]];
+			}
+		}
+#endif
+
+		for (; x < width; ++x) {
+			int v[3];
+			for (int c = 0; c < 3; ++c) {
+				v[c] = min (VIDEO_SCOPES_VALUES - 1, max (0, p[c][x]));
+				++waveform[c][row[v[c]] + column[x]];
+				++histogram[c][v[c]];
+			}
+			int const u = (v[0] - v[1] + VIDEO_SCOPES_VALUES) * VIDEO_SCOPES_VECTORSCOPE_SIZE / (VIDEO_SCOPES_VALUES * 2);
+			int const w = (v[2] - v[1] + VIDEO_SCOPES_VALUES) * VIDEO_SCOPES_VECTORSCOPE_SIZE / (VIDEO_SCOPES_VALUES * 2);
+			++vectorscope[w * VIDEO_SCOPES_VECTORSCOPE_SIZE + u];
+		}
+	}
+}
+
+/** @param count Sum of some waveform counts.
+ *  @param columns Number of waveform columns that were summed.
+ *  @param contrast Fudge multiplication factor to make low-level signals easier to see,
+ *  between 0 and 256.
+ *  @return Brightness to use for the counts.
+ */
+uint8_t
+VideoScopeData::waveform_level (int64_t count, int columns, int contrast) const
+{
+	int64_t const level = count * 255 * _waveform_size.width / (int64_t (_waveform_size.height) * _image_size.width * columns);
+	return min (int64_t (255), level * contrast);
+}
+
+/** @param c Component (0 for X, 1 for Y, 2 for Z).
+ *  @param contrast Fudge multiplication factor to make low-level signals easier to see,
+ *  between 0 and 256.
+ *  @return RGB24 image of the waveform of component c, the same size as the waveform.
+ */
+shared_ptr<Image>
+VideoScopeData::render_waveform (int c, int contrast) const
+{
+	shared_ptr<Image> out (new Image (AV_PIX_FMT_RGB24, _waveform_size, true));
+
+	for (int y = 0; y < _waveform_size.height; ++y) {
+		uint32_t const * in = &_waveform[c][(_waveform_size.height - y - 1) * _waveform_size.width];
+		uint8_t* p = out->data()[0] + y * out->stride()[0];
+		for (int x = 0; x < _waveform_size.width; ++x) {
+			p[0] = p[1] = p[2] = waveform_level (in[x], 1, contrast);
+			p += 3;
+		}
+	}
+
+	return out;
+}
+
+/** @param contrast Fudge multiplication factor to make low-level signals easier to see,
+ *  between 0 and 256.
+ *  @return RGB24 image, the same size as the waveform, showing the waveforms of X, Y
+ *  and Z side-by-side.  They are drawn in grey like render_waveform() so that they are
+ *  not mistaken for the R, G and B of an RGB parade.
+ */
+shared_ptr<Image>
+VideoScopeData::render_xyz_parade (int contrast) const
+{
+	shared_ptr<Image> out (new Image (AV_PIX_FMT_RGB24, _waveform_size, true));
+	out->make_black ();
+
+	int const width = _waveform_size.width;
+
+	for (int c = 0; c < 3; ++c) {
+		/* Squeeze this component's waveform into a third of the width */
+		int const panel_from = c * width / 3;
+		int const panel_to = (c + 1) * width / 3;
+		int const panel_width = panel_to - panel_from;
+		if (panel_width == 0) {
+			continue;
+		}
+
+		for (int y = 0; y < _waveform_size.height; ++y) {
+			uint32_t const * in = &_waveform[c][(_waveform_size.height - y - 1) * width];
+			uint8_t* p = out->data()[0] + y * out->stride()[0] + panel_from * 3;
+			for (int x = 0; x < panel_width; ++x) {
+				int const from = x * width / panel_width;
+				int const to = (x + 1) * width / panel_width;
+				int64_t count = 0;
+				for (int i = from; i < to; ++i) {
+					count += in[i];
+				}
+				p[0] = p[1] = p[2] = waveform_level (count, to - from, contrast);
+				p += 3;
+			}
+		}
+	}
+
+	return out;
+}
+
+static void
+note ()
+{
+
+}
+
+VideoScopes::VideoScopes ()
+	: _pending_again (false)
+	, _skipped (0)
+	, _stop (false)
+{
+	_thread = new boost::thread (boost::bind (&VideoScopes::thread, this));
+}
+
+VideoScopes::~VideoScopes ()
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		_stop = true;
+		_summon.notify_all ();
+	}
+
+	_thread->interrupt ();
+	try {
+		_thread->join ();
+	} catch (boost::thread_interrupted& e) {
+		/* No problem */
+	}
+	delete _thread;
+}
+
+/** Analyse a frame, replacing any frame which is waiting to be analysed.
+ *  May be called from any thread.
+ */
+void
+VideoScopes::process (shared_ptr<const PlayerVideo> video)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (_pending) {
+		++_skipped;
+	}
+	_pending = video;
+	_summon.notify_all ();
+}
+
+/** Set the size of waveforms to make, and re-analyse the last frame with the new size.
+ *  May be called from any thread.
+ */
+void
+VideoScopes::set_waveform_size (dcp::Size size)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (size == _waveform_size) {
+		return;
+	}
+
+	_waveform_size = size;
+	_pending_again = true;
+	_summon.notify_all ();
+}
+
+/** @return Data for the last frame that was analysed, or 0 */
+shared_ptr<const VideoScopeData>
+VideoScopes::data () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _data;
+}
+
+void
+VideoScopes::thread ()
+try
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+		while (!_pending && !_pending_again && !_stop) {
+			_summon.wait (lm);
+		}
+
+		if (_stop) {
+			return;
+		}
+
+		shared_ptr<const PlayerVideo> video = _pending;
+		shared_ptr<dcp::OpenJPEGImage> image = _image;
+		dcp::Size const size = _waveform_size;
+		_pending.reset ();
+		_pending_again = false;
+		lm.unlock ();
+
+		try {
+			if (video) {
+				image = DCPVideo::convert_to_xyz (video, boost::bind (&note));
+			}
+
+			if (!image || size.width <= 0 || size.height <= 0) {
+				continue;
+			}
+
+			shared_ptr<const VideoScopeData> data (new VideoScopeData (image, size));
+
+			lm.lock ();
+			_image = image;
+			_data = data;
+			lm.unlock ();
+
+			emit (boost::bind (boost::ref (Finished)));
+		} catch (boost::thread_interrupted) {
+			throw;
+		} catch (...) {
+			/* Keep going for the next frame, but let the UI know what happened */
+			store_current ();
+		}
+	}
+} catch (boost::thread_interrupted) {
+	/* The scopes thread is being terminated */
+}
@@ -0,0 +1,155 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/video_scopes.h
+ *  @brief VideoScopeData and VideoScopes classes.
+ */
+
+#ifndef DCPOMATIC_VIDEO_SCOPES_H
+#define DCPOMATIC_VIDEO_SCOPES_H
+
+#include "signaller.h"
+#include "exception_store.h"
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/signals2.hpp>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+class PlayerVideo;
+class Image;
+
+/** Number of distinct values that each XYZ component can take */
+#define VIDEO_SCOPES_VALUES 4096
+/** Width and height of the vectorscope */
+#define VIDEO_SCOPES_VECTORSCOPE_SIZE 256
+
+/** @class VideoScopeData
+ *  @brief Waveforms, histograms and a vectorscope of an XYZ image, all made
+ *  in a single pass over the image.
+ */
+class VideoScopeData : public boost::noncopyable
+{
+public:
+	VideoScopeData (boost::shared_ptr<dcp::OpenJPEGImage> image, dcp::Size waveform_size);
+
+	dcp::Size image_size () const {
+		return _image_size;
+	}
+
+	dcp::Size waveform_size () const {
+		return _waveform_size;
+	}
+
+	/** @param c Component (0 for X, 1 for Y, 2 for Z).
+	 *  @param column Waveform column.
+	 *  @param bin Waveform value bin, where 0 is the lowest.
+	 *  @return Number of samples of component c in the image
+	 *  columns covered by column whose values fall into bin.
+	 */
+	uint32_t waveform (int c, int column, int bin) const {
+		return _waveform[c][bin * _waveform_size.width + column];
+	}
+
+	/** @param c Component (0 for X, 1 for Y, 2 for Z).
+	 *  @param value Component value.
+	 *  @return Number of samples of component c with the given value.
+	 */
+	uint32_t histogram (int c, int value) const {
+		return _histogram[c][value];
+	}
+
+	/** @param u Horizontal position, which corresponds to X' - Y'.
+	 *  @param v Vertical position, which corresponds to Z' - Y'.
+	 *  @return Number of pixels at that point.
+	 */
+	uint32_t vectorscope (int u, int v) const {
+		return _vectorscope[v * VIDEO_SCOPES_VECTORSCOPE_SIZE + u];
+	}
+
+	boost::shared_ptr<Image> render_waveform (int c, int contrast) const;
+	boost::shared_ptr<Image> render_xyz_parade (int contrast) const;
+
+private:
+	uint8_t waveform_level (int64_t count, int columns, int contrast) const;
+
+	dcp::Size _image_size;
+	dcp::Size _waveform_size;
+	/** waveform counts for each component, arranged as rows of value bins */
+	std::vector<uint32_t> _waveform[3];
+	std::vector<uint32_t> _histogram[3];
+	std::vector<uint32_t> _vectorscope;
+};
+
+/** @class VideoScopes
+ *  @brief Makes VideoScopeData for video frames in a background thread.
+ *
+ *  If frames are given to process() more quickly than they can be analysed
+ *  intermediate frames are skipped, so the data always follows the most
+ *  recent frame.
+ */
+class VideoScopes : public Signaller, public ExceptionStore, public boost::noncopyable
+{
+public:
+	VideoScopes ();
+	~VideoScopes ();
+
+	void process (boost::shared_ptr<const PlayerVideo> video);
+	void set_waveform_size (dcp::Size size);
+
+	boost::shared_ptr<const VideoScopeData> data () const;
+
+	/** @return number of frames that were skipped because the thread was busy */
+	int skipped () const {
+		boost::mutex::scoped_lock lm (_mutex);
+		return _skipped;
+	}
+
+	/** Emitted (in the UI thread) when new data are available from data() */
+	boost::signals2::signal<void ()> Finished;
+
+private:
+	void thread ();
+
+	boost::thread* _thread;
+
+	/** mutex to protect everything below */
+	mutable boost::mutex _mutex;
+	boost::condition _summon;
+	/** next frame to analyse, or 0 */
+	boost::shared_ptr<const PlayerVideo> _pending;
+	/** true if the last image should be analysed again (e.g. because the waveform size has changed) */
+	bool _pending_again;
+	/** last XYZ image that we analysed */
+	boost::shared_ptr<dcp::OpenJPEGImage> _image;
+	dcp::Size _waveform_size;
+	boost::shared_ptr<const VideoScopeData> _data;
+	int _skipped;
+	bool _stop;
+};
+
+#endif
@@ -89,6 +89,10 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 		_reels.push_back (ReelWriter (film, p, job, reel_index++, reels.size(), _film->content_summary(p)));
 	}
 
+	BOOST_FOREACH (ReelWriter const & i, _reels) {
+		_last_written.push_back (make_pair (i.last_written_video_frame(), i.last_written_eyes()));
+	}
+
 	/* We can keep track of the current audio and subtitle reels easily because audio
 	   and subs arrive to the Writer in sequence.  This is not so for video.
 	*/
@@ -298,6 +302,50 @@ Writer::have_sequenced_image_at_queue_head ()
 	return false;
 }
 
+/** @return The indices within the DCP, and the eyes, of the frames that each reel
+ *  must have before it can write any more video.  Frames that are already queued
+ *  are not included.
+ */
+list<pair<Frame, Eyes> >
+Writer::awaiting () const
+{
+	boost::mutex::scoped_lock lock (_state_mutex);
+
+	list<pair<Frame, Eyes> > frames;
+
+	for (size_t i = 0; i < _reels.size(); ++i) {
+		/* Use our copy of what each reel has written, as the ReelWriter's own is
+		   changed by our thread without _state_mutex held.
+		*/
+		pair<int, Eyes> const & last = _last_written[i];
+
+		Frame frame = last.first + 1;
+		Eyes eyes = EYES_BOTH;
+		if (_film->three_d ()) {
+			if (last.second == EYES_LEFT) {
+				frame = last.first;
+				eyes = EYES_RIGHT;
+			} else {
+				eyes = EYES_LEFT;
+			}
+		}
+
+		bool queued = false;
+		BOOST_FOREACH (QueueItem const & j, _queue) {
+			if (j.reel == i && j.frame == frame && j.eyes == eyes) {
+				queued = true;
+				break;
+			}
+		}
+
+		if (!queued) {
+			frames.push_back (make_pair (_reels[i].start() + frame, eyes));
+		}
+	}
+
+	return frames;
+}
+
 void
 Writer::thread ()
 try
@@ -350,6 +398,7 @@ try
 			if (qi.type == QueueItem::FULL && qi.encoded) {
 				--_queued_full_in_memory;
 			}
+			_last_written[qi.reel] = make_pair (qi.frame, qi.eyes);
 
 			lock.unlock ();
 
@@ -30,6 +30,7 @@
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
+#include <vector>
 
 namespace dcp {
 	class Data;
@@ -111,6 +112,8 @@ public:
 
 	void set_encoder_threads (int threads);
 
+	std::list<std::pair<Frame, Eyes> > awaiting () const;
+
 private:
 	void thread ();
 	void terminate_thread (bool);
@@ -132,6 +135,11 @@ private:
 	bool _finish;
 	/** queue of things to write to disk */
 	std::list<QueueItem> _queue;
+	/** index within its reel and eyes of the last video frame taken off the queue for each
+	    reel; a copy of what the ReelWriters will have written which, unlike theirs, is
+	    protected by _state_mutex.
+	*/
+	std::vector<std::pair<int, Eyes> > _last_written;
 	/** number of FULL frames whose JPEG200 data is currently held in RAM */
 	int _queued_full_in_memory;
 	/** mutex for thread state */
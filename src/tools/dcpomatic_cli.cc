@@ -66,6 +66,8 @@ help (string n)
 	     << "  -l, --list-servers   just display a list of encoding servers that DCP-o-matic is configured to use; don't encode\n"
 	     << "  -d, --dcp-path       echo DCP's path to stdout on successful completion (implies -n)\n"
 	     << "      --dump           just dump a summary of the film's settings; don't encode\n"
+	     << "      --draft          make a quick, lower-quality DCP for checking (overriding the film's setting)\n"
+	     << "      --draft-half     as --draft, but also throw away half the picture's resolution\n"
 	     << "\n"
 	     << "<FILM> is the film directory.\n";
 }
@@ -79,6 +81,10 @@ print_dump (shared_ptr<Film> film)
 	     << "Output " << film->video_frame_rate() << "fps " << (film->three_d() ? "3D" : "2D") << " " << (film->audio_frame_rate() / 1000) << "kHz\n"
 	     << (film->interop() ? "Inter-Op" : "SMPTE") << " " << (film->encrypted() ? "encrypted" : "unencrypted") << "\n";
 
+	if (film->draft ()) {
+		cout << "Draft" << (film->draft_half_resolution() ? " (half resolution)" : "") << "\n";
+	}
+
 	BOOST_FOREACH (shared_ptr<Content> c, film->content ()) {
 		cout << "\n"
 		     << c->path(0) << "\n"
@@ -188,6 +194,8 @@ main (int argc, char* argv[])
 	optional<int> json_port;
 	bool keep_going = false;
 	bool dump = false;
+	bool draft = false;
+	bool draft_half_resolution = false;
 	optional<boost::filesystem::path> servers;
 	bool list_servers_ = false;
 	bool dcp_path = false;
@@ -208,10 +216,12 @@ main (int argc, char* argv[])
 			{ "dcp-path", no_argument, 0, 'd' },
 			/* Just using A, B, C ... from here on */
 			{ "dump", no_argument, 0, 'A' },
+			{ "draft", no_argument, 0, 'B' },
+			{ "draft-half", no_argument, 0, 'C' },
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "vhfnrt:j:kAs:ld", long_options, &option_index);
+		int c = getopt_long (argc, argv, "vhfnrt:j:kABCs:ld", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -245,6 +255,13 @@ main (int argc, char* argv[])
 		case 'A':
 			dump = true;
 			break;
+		case 'B':
+			draft = true;
+			break;
+		case 'C':
+			draft = true;
+			draft_half_resolution = true;
+			break;
 		case 's':
 			servers = optarg;
 			break;
@@ -312,6 +329,14 @@ main (int argc, char* argv[])
 		exit (EXIT_FAILURE);
 	}
 
+	if (draft) {
+		film->set_draft (true);
+	}
+
+	if (draft_half_resolution) {
+		film->set_draft_half_resolution (true);
+	}
+
 	if (dump) {
 		print_dump (film);
 		exit (EXIT_SUCCESS);
@@ -235,6 +235,8 @@ main (int argc, char* argv[])
 		film->set_use_isdcf_name (use_isdcf_name);
 		film->set_signed (sign);
 
+		ContentList all_content;
+
 		for (int i = optind; i < argc; ++i) {
 			boost::filesystem::path const can = boost::filesystem::canonical (argv[i]);
 			list<shared_ptr<Content> > content;
@@ -250,10 +252,12 @@ main (int argc, char* argv[])
 				if (j->video) {
 					j->video->set_scale (VideoContentScale (content_ratio));
 				}
-				film->examine_and_add_content (j);
+				all_content.push_back (j);
 			}
 		}
 
+		film->examine_and_add_content (all_content);
+
 		JobManager* jm = JobManager::instance ();
 
 		while (jm->work_to_do ()) {
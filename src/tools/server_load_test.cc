@@ -0,0 +1,394 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/tools/server_load_test.cc
+ *  @brief Tool to send frames to one or more encode servers as fast as they will take
+ *  them, and report how they coped.
+ *
+ *  Frames are taken from a film, or made up, and are sent to each server by a
+ *  configurable number of threads.  At the end the tool reports throughput, latency,
+ *  bytes sent and received and errors for each server.
+ */
+
+#include "lib/film.h"
+#include "lib/util.h"
+#include "lib/dcp_video.h"
+#include "lib/exceptions.h"
+#include "lib/file_log.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/image.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/colour_conversion.h"
+#include "lib/encode_server_description.h"
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <getopt.h>
+#include <sys/time.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <exception>
+
+using std::cout;
+using std::cerr;
+using std::string;
+using std::vector;
+using std::list;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::max;
+using boost::shared_ptr;
+using boost::optional;
+using boost::bind;
+using boost::thread;
+using dcp::Data;
+
+/** What we found out about one server */
+struct ServerResult
+{
+	ServerResult ()
+		: errors (0)
+		, bytes_sent (0)
+		, bytes_received (0)
+	{}
+
+	string host;
+	/** time taken for each successful frame, in seconds */
+	vector<double> latencies;
+	int errors;
+	string last_error;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+};
+
+static vector<shared_ptr<PlayerVideo> > frames;
+static int frame_rate = 24;
+static int j2k_bandwidth = 250000000;
+static Resolution resolution = RESOLUTION_2K;
+static int timeout = 30;
+static int frames_to_send = 480;
+static int next_frame = 0;
+static boost::mutex mutex;
+static shared_ptr<FileLog> log_ (new FileLog ("server_load_test.log"));
+
+/** Thread to send frames to a server until there are none left to send */
+static void
+send_frames (ServerResult* result, EncodeServerDescription server)
+{
+	while (true) {
+		int index;
+		{
+			boost::mutex::scoped_lock lm (mutex);
+			if (next_frame >= frames_to_send) {
+				return;
+			}
+			index = next_frame++;
+		}
+
+		DCPVideo video (frames[index % frames.size()], index, frame_rate, j2k_bandwidth, resolution, log_);
+
+		struct timeval start;
+		gettimeofday (&start, 0);
+
+		string error;
+		try {
+			video.encode_remotely (server, timeout);
+		} catch (std::exception& e) {
+			error = e.what ();
+		}
+
+		struct timeval end;
+		gettimeofday (&end, 0);
+
+		boost::mutex::scoped_lock lm (mutex);
+		if (error.empty ()) {
+			result->latencies.push_back (seconds (end) - seconds (start));
+			result->bytes_sent += video.bytes_sent ();
+			result->bytes_received += video.bytes_received ();
+		} else {
+			++result->errors;
+			result->last_error = error;
+		}
+	}
+}
+
+/** Make a frame which is different to all the others that we make, so that
+ *  the servers cannot avoid work by noticing that they have seen it before.
+ */
+static shared_ptr<PlayerVideo>
+synthetic_frame (dcp::Size size, int n, Eyes eyes)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, size, true));
+
+	/* Gradients with some noise on top, which gives the encoder roughly as much
+	   to do as a real picture.
+	*/
+	uint32_t noise = n + 1;
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t* p = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < size.width; ++x) {
+			noise = noise * 1103515245 + 12345;
+			uint8_t const grain = (noise >> 16) & 0x1f;
+			*p++ = ((x + n * 7) & 0xff) ^ grain;
+			*p++ = ((y + n * 13) & 0xff) ^ grain;
+			*p++ = ((x + y + n) & 0xff) ^ grain;
+		}
+	}
+
+	return shared_ptr<PlayerVideo> (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			size,
+			size,
+			eyes,
+			PART_WHOLE,
+			ColourConversion ()
+			)
+		);
+}
+
+static void
+add_film_frame (shared_ptr<PlayerVideo> pvf)
+{
+	frames.push_back (pvf);
+}
+
+static double
+percentile (vector<double> const & sorted, int p)
+{
+	if (sorted.empty ()) {
+		return 0;
+	}
+
+	return sorted[max (0, int (sorted.size() * p / 100.0 + 0.5) - 1)];
+}
+
+static void
+print_result (string host, vector<double> latencies, int errors, uint64_t sent, uint64_t received, double duration)
+{
+	std::sort (latencies.begin(), latencies.end());
+	int const done = latencies.size ();
+
+	cout << setw(24) << std::left << host << std::right
+	     << setw(8) << done
+	     << setw(9) << fixed << setprecision(2) << (done / duration)
+	     << setw(9) << setprecision(3) << percentile (latencies, 50)
+	     << setw(9) << percentile (latencies, 90)
+	     << setw(9) << percentile (latencies, 99)
+	     << setw(9) << (latencies.empty() ? 0 : latencies.back())
+	     << setw(10) << setprecision(1) << (sent / 1e6)
+	     << setw(10) << (received / 1e6)
+	     << setw(7) << errors
+	     << setw(7) << (errors ? errors * 100.0 / (errors + done) : 0) << "%\n";
+}
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION] --server <host> [--server <host> ...]\n"
+	     << "  -h, --help             show this help\n"
+	     << "  -s, --server <host>    server to send frames to; may be given more than once\n"
+	     << "  -f, --film <film>      take frames from this film\n"
+	     << "  -y, --synthetic <type> make up frames; type is 2k, 4k or 3d (default 2k)\n"
+	     << "  -n, --frames <n>       number of frames to send (default 480)\n"
+	     << "  -p, --pool <n>         number of different frames to cycle through (default 16)\n"
+	     << "  -c, --concurrency <n>  number of frames to have in flight to each server at once (default 4)\n"
+	     << "  -b, --bandwidth <n>    J2K bandwidth in Mbit/s for synthetic frames (default 250)\n"
+	     << "  -t, --timeout <n>      network timeout in seconds (default 30)\n"
+	     << "  -m, --min-fps <n>      exit with an error if the total frames per second is lower than this\n";
+}
+
+int
+main (int argc, char* argv[])
+{
+	vector<string> hosts;
+	boost::filesystem::path film_dir;
+	string synthetic = "2k";
+	int pool = 16;
+	int concurrency = 4;
+	optional<double> min_fps;
+
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h'},
+			{ "server", required_argument, 0, 's'},
+			{ "film", required_argument, 0, 'f'},
+			{ "synthetic", required_argument, 0, 'y'},
+			{ "frames", required_argument, 0, 'n'},
+			{ "pool", required_argument, 0, 'p'},
+			{ "concurrency", required_argument, 0, 'c'},
+			{ "bandwidth", required_argument, 0, 'b'},
+			{ "timeout", required_argument, 0, 't'},
+			{ "min-fps", required_argument, 0, 'm'},
+			{ 0, 0, 0, 0 }
+		};
+
+		int option_index = 0;
+		int c = getopt_long (argc, argv, "hs:f:y:n:p:c:b:t:m:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 's':
+			hosts.push_back (optarg);
+			break;
+		case 'f':
+			film_dir = optarg;
+			break;
+		case 'y':
+			synthetic = optarg;
+			break;
+		case 'n':
+			frames_to_send = atoi (optarg);
+			break;
+		case 'p':
+			pool = atoi (optarg);
+			break;
+		case 'c':
+			concurrency = atoi (optarg);
+			break;
+		case 'b':
+			j2k_bandwidth = atoi (optarg) * 1000000;
+			break;
+		case 't':
+			timeout = atoi (optarg);
+			break;
+		case 'm':
+			min_fps = atof (optarg);
+			break;
+		}
+	}
+
+	if (hosts.empty() || pool < 1 || concurrency < 1 || (synthetic != "2k" && synthetic != "4k" && synthetic != "3d")) {
+		help (argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	dcpomatic_setup ();
+
+	try {
+		if (!film_dir.empty ()) {
+			shared_ptr<Film> film (new Film (film_dir));
+			film->read_metadata ();
+			frame_rate = film->video_frame_rate ();
+			j2k_bandwidth = film->j2k_bandwidth ();
+			resolution = film->resolution ();
+
+			shared_ptr<Player> player (new Player (film, film->playlist ()));
+			player->Video.connect (bind (&add_film_frame, _1));
+			while (int (frames.size()) < pool && !player->pass ()) {}
+			if (frames.empty ()) {
+				cerr << "Film " << film_dir.string() << " has no video.\n";
+				exit (EXIT_FAILURE);
+			}
+		} else {
+			dcp::Size size (1998, 1080);
+			if (synthetic == "4k") {
+				size = dcp::Size (3996, 2160);
+				resolution = RESOLUTION_4K;
+			}
+			for (int i = 0; i < pool; ++i) {
+				Eyes eyes = EYES_BOTH;
+				if (synthetic == "3d") {
+					eyes = (i % 2) ? EYES_RIGHT : EYES_LEFT;
+				}
+				frames.push_back (synthetic_frame (size, i, eyes));
+			}
+		}
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		exit (EXIT_FAILURE);
+	}
+
+	cout << "Sending " << frames_to_send << " frames (cycling through " << frames.size() << " different ones) to "
+	     << hosts.size() << " server(s) with " << concurrency << " in flight to each.\n";
+
+	vector<ServerResult> results (hosts.size ());
+	list<thread*> threads;
+
+	struct timeval start;
+	gettimeofday (&start, 0);
+
+	/* These descriptions do not say that the servers have source image caches, so we send
+	   no digests and every frame's image is sent in full whatever the size of the pool.
+	*/
+	for (size_t i = 0; i < hosts.size(); ++i) {
+		results[i].host = hosts[i];
+		for (int j = 0; j < concurrency; ++j) {
+			threads.push_back (new thread (bind (&send_frames, &results[i], EncodeServerDescription (hosts[i], concurrency))));
+		}
+	}
+
+	BOOST_FOREACH (thread* i, threads) {
+		i->join ();
+		delete i;
+	}
+
+	struct timeval end;
+	gettimeofday (&end, 0);
+	double const duration = seconds (end) - seconds (start);
+
+	cout << "\n"
+	     << setw(24) << std::left << "Server" << std::right
+	     << setw(8) << "Frames" << setw(9) << "fps"
+	     << setw(9) << "p50/s" << setw(9) << "p90/s" << setw(9) << "p99/s" << setw(9) << "max/s"
+	     << setw(10) << "Sent/MB" << setw(10) << "Recv/MB"
+	     << setw(7) << "Errors" << setw(8) << "Rate" << "\n";
+
+	vector<double> all_latencies;
+	int all_errors = 0;
+	uint64_t all_sent = 0;
+	uint64_t all_received = 0;
+
+	BOOST_FOREACH (ServerResult const & i, results) {
+		print_result (i.host, i.latencies, i.errors, i.bytes_sent, i.bytes_received, duration);
+		all_latencies.insert (all_latencies.end(), i.latencies.begin(), i.latencies.end());
+		all_errors += i.errors;
+		all_sent += i.bytes_sent;
+		all_received += i.bytes_received;
+	}
+
+	print_result ("Total", all_latencies, all_errors, all_sent, all_received, duration);
+
+	BOOST_FOREACH (ServerResult const & i, results) {
+		if (i.errors) {
+			cout << "Last error from " << i.host << ": " << i.last_error << "\n";
+		}
+	}
+
+	double const fps = all_latencies.size() / duration;
+	cout << "\nTook " << fixed << setprecision(1) << duration << "s.\n";
+
+	if (min_fps && fps < min_fps.get ()) {
+		cerr << "Total of " << fps << " frames per second is less than the required " << min_fps.get() << ".\n";
+		exit (EXIT_FAILURE);
+	}
+
+	return all_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
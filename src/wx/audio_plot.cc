@@ -21,6 +21,7 @@
 #include "audio_plot.h"
 #include "lib/audio_decoder.h"
 #include "lib/audio_analysis.h"
+#include "lib/audio_analysis_pyramid.h"
 #include "lib/compose.hpp"
 #include "wx/wx_util.h"
 #include <wx/graphics.h>
@@ -29,7 +30,6 @@
 
 using std::cout;
 using std::vector;
-using std::list;
 using std::max;
 using std::min;
 using boost::bind;
@@ -89,7 +89,10 @@ AudioPlot::set_analysis (shared_ptr<AudioAnalysis> a)
 {
 	_analysis = a;
 
-	if (!a) {
+	if (a) {
+		_pyramid.reset (new AudioAnalysisPyramid (a));
+	} else {
+		_pyramid.reset ();
 		_message = _("Please wait; audio is being analysed...");
 	}
 
@@ -120,6 +123,7 @@ AudioPlot::set_message (wxString s)
 struct Metrics
 {
 	double db_label_width;
+	int data_width;
 	int height;
 	int y_origin;
 	float x_scale;
@@ -153,6 +157,7 @@ AudioPlot::paint ()
 	metrics.db_label_width += 8;
 
 	int const data_width = GetSize().GetWidth() - metrics.db_label_width;
+	metrics.data_width = data_width;
 	/* Assume all channels have the same number of points */
 	metrics.x_scale = data_width / float (_analysis->points (0));
 	metrics.height = GetSize().GetHeight ();
@@ -218,80 +223,61 @@ AudioPlot::y_for_linear (float p, Metrics const & metrics) const
 void
 AudioPlot::plot_peak (wxGraphicsPath& path, int channel, Metrics const & metrics) const
 {
-	if (_analysis->points (channel) == 0) {
+	int const N = _pyramid->points (channel);
+	if (N == 0) {
 		return;
 	}
 
-	path.MoveToPoint (metrics.db_label_width, y_for_linear (get_point(channel, 0)[AudioPoint::PEAK], metrics));
+	float const gain = pow (10, _gain_correction / 20);
+	float const decay = 0.01f * (1 - log10 (_smoothing) / log10 (max_smoothing));
+
+	path.MoveToPoint (metrics.db_label_width, y_for_linear (_pyramid->get(channel, 0, 1).peak_max * gain, metrics));
 
 	float peak = 0;
-	int const N = _analysis->points(channel);
-	for (int i = 0; i < N; ++i) {
-		float const p = get_point(channel, i)[AudioPoint::PEAK];
-		peak -= 0.01f * (1 - log10 (_smoothing) / log10 (max_smoothing));
+	int const ranges = min (N, max (1, metrics.data_width));
+	for (int i = 0; i < ranges; ++i) {
+		int const from = int64_t (i) * N / ranges;
+		int const to = int64_t (i + 1) * N / ranges;
+		/* Decay the peak by the same amount as it would have decayed over
+		   each point in the range; this is exact when there is one point
+		   per range.
+		*/
+		float const p = _pyramid->get(channel, from, to).peak_max * gain;
+		peak -= decay * (to - from);
 		if (p > peak) {
 			peak = p;
 		} else if (peak < 0) {
 			peak = 0;
 		}
 
-		path.AddLineToPoint (metrics.db_label_width + i * metrics.x_scale, y_for_linear (peak, metrics));
+		path.AddLineToPoint (metrics.db_label_width + from * metrics.x_scale, y_for_linear (peak, metrics));
 	}
 }
 
 void
 AudioPlot::plot_rms (wxGraphicsPath& path, int channel, Metrics const & metrics) const
 {
-	if (_analysis->points (channel) == 0) {
+	int const N = _pyramid->points (channel);
+	if (N == 0) {
 		return;
 	}
 
-	path.MoveToPoint (metrics.db_label_width, y_for_linear (get_point(channel, 0)[AudioPoint::RMS], metrics));
-
-	list<float> smoothing;
-
-	int const N = _analysis->points(channel);
+	float const gain = pow (10, _gain_correction / 20);
 
-	float const first = get_point(channel, 0)[AudioPoint::RMS];
-	float const last = get_point(channel, N - 1)[AudioPoint::RMS];
+	path.MoveToPoint (metrics.db_label_width, y_for_linear (_pyramid->get(channel, 0, 1).rms * gain, metrics));
 
 	int const before = _smoothing / 2;
 	int const after = _smoothing - before;
 
-	/* Pre-load the smoothing list */
-	for (int i = 0; i < before; ++i) {
-		smoothing.push_back (first);
-	}
-	for (int i = 0; i < after; ++i) {
-		if (i < N) {
-			smoothing.push_back (get_point(channel, i)[AudioPoint::RMS]);
-		} else {
-			smoothing.push_back (last);
-		}
-	}
-
-	for (int i = 0; i < N; ++i) {
-
-		int const next_for_window = i + after;
-
-		if (next_for_window < N) {
-			smoothing.push_back (get_point(channel, i)[AudioPoint::RMS]);
-		} else {
-			smoothing.push_back (last);
-		}
-
-		smoothing.pop_front ();
-
-		float p = 0;
-		for (list<float>::const_iterator j = smoothing.begin(); j != smoothing.end(); ++j) {
-			p += pow (*j, 2);
-		}
-
-		if (!smoothing.empty ()) {
-			p = sqrt (p / smoothing.size ());
-		}
-
-		path.AddLineToPoint (metrics.db_label_width + i * metrics.x_scale, y_for_linear (p, metrics));
+	int const ranges = min (N, max (1, metrics.data_width));
+	for (int i = 0; i < ranges; ++i) {
+		int const from = int64_t (i) * N / ranges;
+		int const to = int64_t (i + 1) * N / ranges;
+		/* RMS over the range widened by the smoothing window; for a single point i
+		   the window is the _smoothing points [i + 1 - before, i + 1 + after).
+		*/
+		float const p = _pyramid->rms (channel, from + 1 - before, to + after) * gain;
+		path.AddLineToPoint (metrics.db_label_width + from * metrics.x_scale, y_for_linear (p, metrics));
 	}
 }
 
@@ -309,17 +295,6 @@ AudioPlot::set_gain_correction (double gain)
 	Refresh ();
 }
 
-AudioPoint
-AudioPlot::get_point (int channel, int point) const
-{
-	AudioPoint p = _analysis->get_point (channel, point);
-	for (int i = 0; i < AudioPoint::COUNT; ++i) {
-		p[i] *= pow (10, _gain_correction / 20);
-	}
-
-	return p;
-}
-
 /** @param n Channel index.
  *  @return Colour used by that channel in the plot.
  */
@@ -25,6 +25,7 @@
 #include "lib/audio_analysis.h"
 
 struct Metrics;
+class AudioAnalysisPyramid;
 
 class AudioPlot : public wxPanel
 {
@@ -47,9 +48,10 @@ private:
 	void plot_peak (wxGraphicsPath &, int, Metrics const &) const;
 	void plot_rms (wxGraphicsPath &, int, Metrics const &) const;
 	float y_for_linear (float, Metrics const &) const;
-	AudioPoint get_point (int channel, int point) const;
 
 	boost::shared_ptr<AudioAnalysis> _analysis;
+	/** summary of _analysis so that we can draw it quickly at any size */
+	boost::shared_ptr<AudioAnalysisPyramid> _pyramid;
 	bool _channel_visible[MAX_DCP_AUDIO_CHANNELS];
 	bool _type_visible[AudioPoint::COUNT];
 	int _smoothing;
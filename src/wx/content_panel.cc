@@ -348,9 +348,9 @@ ContentPanel::add_folder_clicked ()
 
 			ic->set_video_frame_rate (frame_rate);
 		}
-
-		_film->examine_and_add_content (i);
 	}
+
+	_film->examine_and_add_content (ContentList (content.begin(), content.end()));
 }
 
 void
@@ -612,11 +612,13 @@ ContentPanel::add_files (list<boost::filesystem::path> paths)
 	/* XXX: check for lots of files here and do something */
 
 	try {
+		ContentList content;
 		BOOST_FOREACH (boost::filesystem::path i, paths) {
 			BOOST_FOREACH (shared_ptr<Content> j, content_factory (_film, i)) {
-				_film->examine_and_add_content (j);
+				content.push_back (j);
 			}
 		}
+		_film->examine_and_add_content (content);
 	} catch (exception& e) {
 		error_dialog (_parent, e.what());
 	}
@@ -395,6 +395,14 @@ DCPPanel::film_changed (int p)
 		checked_set (_three_d, _film->three_d ());
 		setup_dcp_name ();
 		break;
+	case Film::DRAFT:
+		checked_set (_draft, _film->draft ());
+		_draft_half_resolution->Enable (_film->draft ());
+		setup_dcp_name ();
+		break;
+	case Film::DRAFT_HALF_RESOLUTION:
+		checked_set (_draft_half_resolution, _film->draft_half_resolution ());
+		break;
 	case Film::INTEROP:
 		checked_set (_standard, _film->interop() ? 1 : 0);
 		setup_dcp_name ();
@@ -525,6 +533,8 @@ DCPPanel::set_film (shared_ptr<Film> film)
 	film_changed (Film::REEL_TYPE);
 	film_changed (Film::REEL_LENGTH);
 	film_changed (Film::UPLOAD_AFTER_MAKE_DCP);
+	film_changed (Film::DRAFT);
+	film_changed (Film::DRAFT_HALF_RESOLUTION);
 }
 
 void
@@ -557,6 +567,8 @@ DCPPanel::set_general_sensitivity (bool s)
 	_best_frame_rate->Enable (s && _film && _film->best_video_frame_rate () != _film->video_frame_rate ());
 	_resolution->Enable (s);
 	_three_d->Enable (s);
+	_draft->Enable (s);
+	_draft_half_resolution->Enable (s && _film && _film->draft ());
 	_standard->Enable (s);
 }
 
@@ -610,6 +622,26 @@ DCPPanel::three_d_changed ()
 	_film->set_three_d (_three_d->GetValue ());
 }
 
+void
+DCPPanel::draft_changed ()
+{
+	if (!_film) {
+		return;
+	}
+
+	_film->set_draft (_draft->GetValue ());
+}
+
+void
+DCPPanel::draft_half_resolution_changed ()
+{
+	if (!_film) {
+		return;
+	}
+
+	_film->set_draft_half_resolution (_draft_half_resolution->GetValue ());
+}
+
 void
 DCPPanel::config_changed ()
 {
@@ -676,6 +708,14 @@ DCPPanel::make_video_panel ()
 	grid->Add (_three_d, wxGBPosition (r, 0), wxGBSpan (1, 2));
 	++r;
 
+	_draft = new wxCheckBox (panel, wxID_ANY, _("Draft (quicker to make, lower quality)"));
+	grid->Add (_draft, wxGBPosition (r, 0), wxGBSpan (1, 2));
+	++r;
+
+	_draft_half_resolution = new wxCheckBox (panel, wxID_ANY, _("Throw away half the resolution of drafts"));
+	grid->Add (_draft_half_resolution, wxGBPosition (r, 0), wxGBSpan (1, 2));
+	++r;
+
 	{
 		add_label_to_sizer (grid, panel, _("JPEG2000 bandwidth\nfor newly-encoded data"), true, wxGBPosition (r, 0));
 		wxSizer* s = new wxBoxSizer (wxHORIZONTAL);
@@ -695,6 +735,8 @@ DCPPanel::make_video_panel ()
 	_j2k_bandwidth->Bind	(wxEVT_TEXT,          boost::bind (&DCPPanel::j2k_bandwidth_changed, this));
 	_resolution->Bind       (wxEVT_CHOICE,        boost::bind (&DCPPanel::resolution_changed, this));
 	_three_d->Bind	 	(wxEVT_CHECKBOX,      boost::bind (&DCPPanel::three_d_changed, this));
+	_draft->Bind	 	(wxEVT_CHECKBOX,      boost::bind (&DCPPanel::draft_changed, this));
+	_draft_half_resolution->Bind (wxEVT_CHECKBOX, boost::bind (&DCPPanel::draft_half_resolution_changed, this));
 
 	BOOST_FOREACH (Ratio const * i, Ratio::containers()) {
 		_container->Append (std_to_wx(i->container_nickname()));
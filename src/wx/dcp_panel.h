@@ -66,6 +66,8 @@ private:
 	void audio_channels_changed ();
 	void resolution_changed ();
 	void three_d_changed ();
+	void draft_changed ();
+	void draft_half_resolution_changed ();
 	void standard_changed ();
 	void signed_toggled ();
 	void encrypted_toggled ();
@@ -109,6 +111,8 @@ private:
 	wxButton* _show_audio;
 	wxButton* _best_frame_rate;
 	wxCheckBox* _three_d;
+	wxCheckBox* _draft;
+	wxCheckBox* _draft_half_resolution;
 	wxChoice* _resolution;
 	wxChoice* _standard;
 	wxCheckBox* _signed;
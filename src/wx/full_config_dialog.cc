@@ -973,6 +973,15 @@ private:
 			table->Add (s, 1);
 		}
 
+		{
+			add_label_to_sizer (table, _panel, _("Encoded frame cache size"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_j2k_cache_size = new wxSpinCtrl (_panel);
+			s->Add (_j2k_cache_size, 1);
+			add_label_to_sizer (s, _panel, _("GB"), false);
+			table->Add (s, 1);
+		}
+
 		{
 			add_top_aligned_label_to_sizer (table, _panel, _("DCP metadata filename format"));
 			dcp::NameFormat::Map titles;
@@ -1035,6 +1044,8 @@ private:
 		_allow_any_dcp_frame_rate->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::allow_any_dcp_frame_rate_changed, this));
 		_only_servers_encode->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::only_servers_encode_changed, this));
 		_frames_in_memory_multiplier->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
+		_j2k_cache_size->SetRange (0, 10000);
+		_j2k_cache_size->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::j2k_cache_size_changed, this));
 		_dcp_metadata_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_asset_filename_format_changed, this));
 		_log_general->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::log_changed, this));
@@ -1064,6 +1075,7 @@ private:
 		checked_set (_log_debug_encode, config->log_types() & LogEntry::TYPE_DEBUG_ENCODE);
 		checked_set (_log_debug_email, config->log_types() & LogEntry::TYPE_DEBUG_EMAIL);
 		checked_set (_frames_in_memory_multiplier, config->frames_in_memory_multiplier());
+		checked_set (_j2k_cache_size, config->j2k_cache_size());
 #ifdef DCPOMATIC_WINDOWS
 		checked_set (_win32_console, config->win32_console());
 #endif
@@ -1079,6 +1091,11 @@ private:
 		Config::instance()->set_frames_in_memory_multiplier (_frames_in_memory_multiplier->GetValue());
 	}
 
+	void j2k_cache_size_changed ()
+	{
+		Config::instance()->set_j2k_cache_size (_j2k_cache_size->GetValue());
+	}
+
 	void allow_any_dcp_frame_rate_changed ()
 	{
 		Config::instance()->set_allow_any_dcp_frame_rate (_allow_any_dcp_frame_rate->GetValue ());
@@ -1135,6 +1152,7 @@ private:
 
 	wxSpinCtrl* _maximum_j2k_bandwidth;
 	wxSpinCtrl* _frames_in_memory_multiplier;
+	wxSpinCtrl* _j2k_cache_size;
 	wxCheckBox* _allow_any_dcp_frame_rate;
 	wxCheckBox* _only_servers_encode;
 	NameFormatEditor* _dcp_metadata_filename_format;
@@ -55,6 +55,7 @@ VideoWaveformDialog::VideoWaveformDialog (wxWindow* parent, weak_ptr<const Film>
 	_component->Append (wxT ("X"));
 	_component->Append (wxT ("Y"));
 	_component->Append (wxT ("Z"));
+	_component->Append (_("XYZ parade"));
 	add_label_to_sizer (controls, this, _("Component"), true);
 	controls->Add (_component, 1, wxALL, DCPOMATIC_SIZER_X_GAP);
 
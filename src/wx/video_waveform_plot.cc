@@ -22,9 +22,8 @@
 #include "film_viewer.h"
 #include "wx_util.h"
 #include "lib/image.h"
-#include "lib/dcp_video.h"
+#include "lib/video_scopes.h"
 #include <dcp/locale_convert.h>
-#include <dcp/openjpeg_image.h>
 #include <wx/rawbmp.h>
 #include <wx/graphics.h>
 #include <boost/bind.hpp>
@@ -49,11 +48,13 @@ VideoWaveformPlot::VideoWaveformPlot (wxWindow* parent, weak_ptr<const Film> fil
 	, _enabled (false)
 	, _component (0)
 	, _contrast (0)
+	, _scopes (new VideoScopes ())
 {
 #ifndef __WXOSX__
 	SetDoubleBuffered (true);
 #endif
 
+	_scopes->Finished.connect (boost::bind (&VideoWaveformPlot::scopes_finished, this));
 	_viewer_connection = viewer->ImageChanged.connect (boost::bind (&VideoWaveformPlot::set_image, this, _1));
 
 	Bind (wxEVT_PAINT, boost::bind (&VideoWaveformPlot::paint, this));
@@ -83,7 +84,7 @@ VideoWaveformPlot::paint ()
 		return;
 	}
 
-	int const height = _waveform->size().height;
+	int const height = waveform_height ();
 
 	gc->SetPen (wxPen (wxColour (255, 255, 255), 1, wxPENSTYLE_SOLID));
 
@@ -126,9 +127,10 @@ VideoWaveformPlot::paint ()
 		gc->DrawText (std_to_wx (locale_convert<string> (n)), x, y - (label_height / 2));
 	}
 
-	wxImage waveform (_waveform->size().width, height, _waveform->data()[0], true);
+	/* _waveform has one row per pixel but may be narrower than we want to draw it */
+	wxImage waveform (_waveform->size().width, _waveform->size().height, _waveform->data()[0], true);
 	wxBitmap bitmap (waveform);
-	gc->DrawBitmap (bitmap, _x_axis_width, _vertical_margin, _waveform->size().width, height);
+	gc->DrawBitmap (bitmap, _x_axis_width, _vertical_margin, GetSize().GetWidth() - _x_axis_width, height);
 
 	delete gc;
 }
@@ -138,47 +140,21 @@ VideoWaveformPlot::create_waveform ()
 {
 	_waveform.reset ();
 
-	if (!_image) {
+	if (!_data) {
 		return;
 	}
 
-	dcp::Size const image_size = _image->size();
-	int const waveform_height = GetSize().GetHeight() - _vertical_margin * 2;
-	_waveform.reset (new Image (AV_PIX_FMT_RGB24, dcp::Size (image_size.width, waveform_height), true));
-
-	for (int x = 0; x < image_size.width; ++x) {
-
-		/* Work out one vertical `slice' of waveform pixels.  Each value in
-		   strip is the number of samples in image with the corresponding group of
-		   values.
-		*/
-		int strip[waveform_height];
-		memset (strip, 0, waveform_height * sizeof(int));
-
-		int* ip = _image->data (_component) + x;
-		for (int y = 0; y < image_size.height; ++y) {
-			strip[*ip * waveform_height / _pixel_values]++;
-			ip += image_size.width;
-		}
-
-		/* Copy slice into the waveform */
-		uint8_t* wp = _waveform->data()[0] + x * 3;
-		for (int y = waveform_height - 1; y >= 0; --y) {
-			wp[0] = wp[1] = wp[2] = min (255, (strip[y] * 255 / waveform_height) * _contrast);
-			wp += _waveform->stride()[0];
-		}
+	if (_component == 3) {
+		_waveform = _data->render_xyz_parade (_contrast);
+	} else {
+		_waveform = _data->render_waveform (_component, _contrast);
 	}
-
-	_waveform = _waveform->scale (
-		dcp::Size (GetSize().GetWidth() - _x_axis_width, waveform_height),
-		dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, false, false
-		);
 }
 
-static void
-note ()
+int
+VideoWaveformPlot::waveform_height () const
 {
-
+	return GetSize().GetHeight() - _vertical_margin * 2;
 }
 
 void
@@ -188,8 +164,21 @@ VideoWaveformPlot::set_image (weak_ptr<PlayerVideo> image)
 		return;
 	}
 
+	/* Pass on any problem that happened with the last frame */
+	_scopes->rethrow ();
+
 	shared_ptr<PlayerVideo> pv = image.lock ();
-	_image = DCPVideo::convert_to_xyz (pv, boost::bind (&note));
+	if (pv) {
+		_scopes->set_waveform_size (dcp::Size (GetSize().GetWidth() - _x_axis_width, waveform_height ()));
+		_scopes->process (pv);
+	}
+}
+
+/** Called in the UI thread when _scopes has analysed a frame */
+void
+VideoWaveformPlot::scopes_finished ()
+{
+	_data = _scopes->data ();
 	_dirty = true;
 	Refresh ();
 }
@@ -197,6 +186,7 @@ VideoWaveformPlot::set_image (weak_ptr<PlayerVideo> image)
 void
 VideoWaveformPlot::sized (wxSizeEvent &)
 {
+	_scopes->set_waveform_size (dcp::Size (GetSize().GetWidth() - _x_axis_width, waveform_height ()));
 	_dirty = true;
 }
 
@@ -228,7 +218,7 @@ VideoWaveformPlot::set_contrast (int b)
 void
 VideoWaveformPlot::mouse_moved (wxMouseEvent& ev)
 {
-	if (!_image) {
+	if (!_data) {
 		return;
 	}
 
@@ -244,12 +234,12 @@ VideoWaveformPlot::mouse_moved (wxMouseEvent& ev)
 
 	dcp::Size const full = film->frame_size ();
 
-	double const xs = static_cast<double> (full.width) / _waveform->size().width;
+	double const xs = static_cast<double> (full.width) / (GetSize().GetWidth() - _x_axis_width);
 	int const x1 = max (0, min (full.width - 1, int (floor (ev.GetPosition().x - _x_axis_width - 0.5) * xs)));
 	int const x2 = max (0, min (full.width - 1, int (floor (ev.GetPosition().x - _x_axis_width + 0.5) * xs)));
 
-	double const ys = static_cast<double> (_pixel_values) / _waveform->size().height;
-	int const fy = _waveform->size().height - (ev.GetPosition().y - _vertical_margin);
+	double const ys = static_cast<double> (_pixel_values) / waveform_height ();
+	int const fy = waveform_height () - (ev.GetPosition().y - _vertical_margin);
 	int const y1 = max (0, min (_pixel_values - 1, int (floor (fy - 0.5) * ys)));
 	int const y2 = max (0, min (_pixel_values - 1, int (floor (fy + 0.5) * ys)));
 
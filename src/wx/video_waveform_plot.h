@@ -23,14 +23,12 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/signals2.hpp>
 
-namespace dcp {
-	class OpenJPEGImage;
-}
-
 class PlayerVideo;
 class Image;
 class Film;
 class FilmViewer;
+class VideoScopes;
+class VideoScopeData;
 
 class VideoWaveformPlot : public wxPanel
 {
@@ -38,6 +36,7 @@ public:
 	VideoWaveformPlot (wxWindow* parent, boost::weak_ptr<const Film> film, FilmViewer* viewer);
 
 	void set_enabled (bool e);
+	/** Set the component to show: 0 for X, 1 for Y, 2 for Z or 3 for an XYZ parade of all three */
 	void set_component (int c);
 	void set_contrast (int b);
 
@@ -53,10 +52,14 @@ private:
 	void sized (wxSizeEvent &);
 	void create_waveform ();
 	void set_image (boost::weak_ptr<PlayerVideo>);
+	void scopes_finished ();
 	void mouse_moved (wxMouseEvent &);
+	int waveform_height () const;
 
 	boost::weak_ptr<const Film> _film;
-	boost::shared_ptr<dcp::OpenJPEGImage> _image;
+	/** analysis of the images that we are given, done in a separate thread */
+	boost::shared_ptr<VideoScopes> _scopes;
+	boost::shared_ptr<const VideoScopeData> _data;
 	boost::shared_ptr<const Image> _waveform;
 	bool _dirty;
 	bool _enabled;
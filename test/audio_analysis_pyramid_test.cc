@@ -0,0 +1,140 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/audio_analysis_pyramid_test.cc
+ *  @brief Test AudioAnalysisPyramid.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/audio_analysis.h"
+#include "lib/audio_analysis_pyramid.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <cmath>
+
+using std::min;
+using std::max;
+using boost::shared_ptr;
+
+/** Check AudioAnalysisPyramid's summaries against a straightforward walk over the points */
+BOOST_AUTO_TEST_CASE (audio_analysis_pyramid_test)
+{
+	int const channels = 2;
+	/* Not a power of two, so that some levels have a partial entry at the end */
+	int const points = 1237;
+
+	srand (1);
+
+	shared_ptr<AudioAnalysis> analysis (new AudioAnalysis (channels));
+	for (int i = 0; i < channels; ++i) {
+		for (int j = 0; j < points; ++j) {
+			AudioPoint p;
+			p[AudioPoint::PEAK] = float (rand ()) / RAND_MAX;
+			p[AudioPoint::RMS] = float (rand ()) / RAND_MAX;
+			analysis->add_point (i, p);
+		}
+	}
+
+	AudioAnalysisPyramid pyramid (analysis);
+	BOOST_REQUIRE_EQUAL (pyramid.channels(), channels);
+
+	for (int i = 0; i < channels; ++i) {
+		BOOST_REQUIRE_EQUAL (pyramid.points(i), points);
+		BOOST_CHECK_EQUAL (pyramid.levels(i), 12);
+
+		for (int j = 0; j < 2000; ++j) {
+			int const from = rand() % points;
+			int const to = from + 1 + rand() % (points - from);
+
+			float peak_max = 0;
+			float peak_min = 1;
+			double squares = 0;
+			for (int k = from; k < to; ++k) {
+				AudioPoint p = analysis->get_point (i, k);
+				peak_max = max (peak_max, p[AudioPoint::PEAK]);
+				peak_min = min (peak_min, p[AudioPoint::PEAK]);
+				squares += pow (p[AudioPoint::RMS], 2);
+			}
+
+			AudioAnalysisPyramid::Summary s = pyramid.get (i, from, to);
+			BOOST_CHECK_EQUAL (s.peak_max, peak_max);
+			BOOST_CHECK_EQUAL (s.peak_min, peak_min);
+			BOOST_CHECK_CLOSE (s.rms, sqrt (squares / (to - from)), 1e-3);
+		}
+	}
+}
+
+/** Check that AudioAnalysisPyramid::rms extends the first and last points off the ends of the analysis */
+BOOST_AUTO_TEST_CASE (audio_analysis_pyramid_rms_test)
+{
+	shared_ptr<AudioAnalysis> analysis (new AudioAnalysis (1));
+	for (int i = 0; i < 5; ++i) {
+		AudioPoint p;
+		p[AudioPoint::PEAK] = 0;
+		p[AudioPoint::RMS] = i + 1;
+		analysis->add_point (0, p);
+	}
+
+	AudioAnalysisPyramid pyramid (analysis);
+
+	BOOST_CHECK_CLOSE (pyramid.rms (0, -2, 1), 1, 1e-3);
+	BOOST_CHECK_CLOSE (pyramid.rms (0, 4, 8), 5, 1e-3);
+	BOOST_CHECK_CLOSE (pyramid.rms (0, -1, 6), sqrt ((1 + 1 + 4 + 9 + 16 + 25 + 25) / 7.0), 1e-3);
+	BOOST_CHECK_CLOSE (pyramid.rms (0, -4, -2), 1, 1e-3);
+	BOOST_CHECK_CLOSE (pyramid.rms (0, 7, 9), 5, 1e-3);
+}
+
+/** Check AudioAnalysisPyramid::rms over the smoothing windows that AudioPlot uses
+ *  against a straightforward sum, with the ends of the analysis extended.
+ */
+BOOST_AUTO_TEST_CASE (audio_analysis_pyramid_smoothing_test)
+{
+	int const points = 100;
+
+	srand (1);
+
+	shared_ptr<AudioAnalysis> analysis (new AudioAnalysis (1));
+	for (int i = 0; i < points; ++i) {
+		AudioPoint p;
+		p[AudioPoint::PEAK] = 0;
+		p[AudioPoint::RMS] = float (rand ()) / RAND_MAX;
+		analysis->add_point (0, p);
+	}
+
+	AudioAnalysisPyramid pyramid (analysis);
+
+	int const smoothings[] = { 1, 2, 3, 8, 64 };
+	BOOST_FOREACH (int smoothing, smoothings) {
+		int const before = smoothing / 2;
+		int const after = smoothing - before;
+		for (int i = 0; i < points; ++i) {
+			int const from = i + 1 - before;
+			int const to = i + 1 + after;
+			BOOST_REQUIRE_EQUAL (to - from, smoothing);
+
+			double squares = 0;
+			for (int j = from; j < to; ++j) {
+				squares += pow (analysis->get_point(0, max (0, min (points - 1, j)))[AudioPoint::RMS], 2);
+			}
+
+			BOOST_CHECK_CLOSE (pyramid.rms (0, from, to), sqrt (squares / smoothing), 1e-3);
+		}
+	}
+}
@@ -37,7 +37,9 @@
 #include "lib/audio_content.h"
 #include "lib/content_factory.h"
 #include "lib/playlist.h"
+#include "lib/exceptions.h"
 #include "test.h"
+#include <boost/foreach.hpp>
 #include <iostream>
 
 using std::vector;
@@ -93,6 +95,77 @@ BOOST_AUTO_TEST_CASE (audio_analysis_serialisation_test)
 	}
 }
 
+/** Check that optional values survive a round trip through the binary format */
+BOOST_AUTO_TEST_CASE (audio_analysis_serialisation_test2)
+{
+	AudioAnalysis a (2);
+	a.add_point (0, AudioPoint ());
+	vector<float> true_peak;
+	true_peak.push_back (0.5);
+	true_peak.push_back (0.25);
+	a.set_true_peak (true_peak);
+	a.set_loudness_range (6.5);
+	a.set_analysis_gain (-4);
+	a.write ("build/test/audio_analysis_serialisation_test2");
+
+	AudioAnalysis b ("build/test/audio_analysis_serialisation_test2");
+	BOOST_REQUIRE_EQUAL (b.channels(), 2);
+	BOOST_CHECK_EQUAL (b.points(0), 1);
+	BOOST_CHECK_EQUAL (b.points(1), 0);
+	BOOST_REQUIRE_EQUAL (b.true_peak().size(), 2);
+	BOOST_CHECK_EQUAL (b.true_peak()[0], 0.5);
+	BOOST_CHECK_EQUAL (b.true_peak()[1], 0.25);
+	BOOST_CHECK (!b.integrated_loudness());
+	BOOST_CHECK_EQUAL (b.loudness_range().get_value_or(0), 6.5);
+	BOOST_CHECK_EQUAL (b.analysis_gain().get_value_or(0), -4);
+}
+
+/** Check that a truncated binary analysis gives OldFormatError, so that it will be re-run */
+BOOST_AUTO_TEST_CASE (audio_analysis_truncated_test)
+{
+	AudioAnalysis a (2);
+	for (int i = 0; i < 64; ++i) {
+		a.add_point (0, AudioPoint ());
+		a.add_point (1, AudioPoint ());
+	}
+	a.write ("build/test/audio_analysis_truncated_test");
+	BOOST_CHECK (!boost::filesystem::exists ("build/test/audio_analysis_truncated_test.tmp"));
+
+	uintmax_t const size = boost::filesystem::file_size ("build/test/audio_analysis_truncated_test");
+	/* Cut it off in the header, and in the point data */
+	uintmax_t const cuts[] = { 20, size - 4 };
+	BOOST_FOREACH (uintmax_t i, cuts) {
+		boost::filesystem::resize_file ("build/test/audio_analysis_truncated_test", i);
+		BOOST_CHECK_THROW (AudioAnalysis ("build/test/audio_analysis_truncated_test"), OldFormatError);
+	}
+}
+
+/** Check that we can still read analyses written in the old XML format */
+BOOST_AUTO_TEST_CASE (audio_analysis_xml_test)
+{
+	FILE* f = fopen ("build/test/audio_analysis_xml_test", "w");
+	BOOST_REQUIRE (f);
+	fprintf (
+		f,
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<AudioAnalysis><Version>2</Version>"
+		"<Channel><Point><Peak>0.5</Peak><RMS>0.25</RMS></Point><Point><Peak>0.75</Peak><RMS>0.5</RMS></Point></Channel>"
+		"<SamplePeak Time=\"96000\">0.75</SamplePeak>"
+		"<IntegratedLoudness>-23</IntegratedLoudness>"
+		"</AudioAnalysis>\n"
+		);
+	fclose (f);
+
+	AudioAnalysis a ("build/test/audio_analysis_xml_test");
+	BOOST_REQUIRE_EQUAL (a.channels(), 1);
+	BOOST_REQUIRE_EQUAL (a.points(0), 2);
+	BOOST_CHECK_EQUAL (a.get_point(0, 1)[AudioPoint::PEAK], 0.75);
+	BOOST_CHECK_EQUAL (a.get_point(0, 1)[AudioPoint::RMS], 0.5);
+	BOOST_REQUIRE_EQUAL (a.sample_peak().size(), 1);
+	BOOST_CHECK_EQUAL (a.sample_peak()[0].time.get(), 96000);
+	BOOST_CHECK_EQUAL (a.integrated_loudness().get_value_or(0), -23);
+}
+
 static void
 finished ()
 {
@@ -196,3 +269,59 @@ BOOST_AUTO_TEST_CASE (analyse_audio_test4)
 	JobManager::instance()->analyse_audio (film, playlist, c, boost::bind (&finished));
 	BOOST_CHECK (!wait_for_jobs ());
 }
+
+/** Check that an analysis put together from analyses of each piece of content in a playlist
+ *  is close to one made by analysing the whole playlist at once.
+ */
+BOOST_AUTO_TEST_CASE (analyse_audio_compose_test)
+{
+	shared_ptr<Film> film = new_test_film ("analyse_audio_compose_test");
+	film->set_container (Ratio::from_id ("185"));
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("TST"));
+	film->set_name ("analyse_audio_compose_test");
+	film->set_sequence (false);
+	shared_ptr<Content> A = content_factory(film, "test/data/staircase.wav").front();
+	film->examine_and_add_content (A);
+	shared_ptr<Content> B = content_factory(film, "test/data/sine_440.wav").front();
+	film->examine_and_add_content (B);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	/* Trim the start of A, and leave a gap between A and B */
+	A->set_trim_start (ContentTime::from_seconds (0.5));
+	B->set_position (A->end() + DCPTime::from_seconds (1));
+
+	shared_ptr<AnalyseAudioJob> job (new AnalyseAudioJob (film, film->playlist ()));
+	JobManager::instance()->add (job);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	/* There should be analyses of each piece of content as well as the playlist */
+	shared_ptr<Playlist> just_A (new Playlist);
+	just_A->set_sequence (false);
+	just_A->add (A);
+	BOOST_CHECK (boost::filesystem::exists (film->audio_analysis_path (just_A)));
+
+	AudioAnalysis composed (film->audio_analysis_path (film->playlist ()));
+
+	boost::filesystem::path const direct_path = "build/test/analyse_audio_compose_test/direct_analysis";
+	shared_ptr<AnalyseAudioJob> direct_job (new AnalyseAudioJob (film, film->playlist ()));
+	direct_job->analyse_playlist (film->playlist (), direct_path);
+	AudioAnalysis direct (direct_path);
+
+	BOOST_REQUIRE_EQUAL (composed.channels(), direct.channels());
+	for (int i = 0; i < direct.channels(); ++i) {
+		BOOST_REQUIRE_EQUAL (composed.points(i), direct.points(i));
+		for (int j = 0; j < direct.points(i); ++j) {
+			BOOST_CHECK_SMALL (composed.get_point(i, j)[AudioPoint::PEAK] - direct.get_point(i, j)[AudioPoint::PEAK], 0.1f);
+			BOOST_CHECK_SMALL (composed.get_point(i, j)[AudioPoint::RMS] - direct.get_point(i, j)[AudioPoint::RMS], 0.1f);
+		}
+
+		AudioAnalysis::PeakTime const composed_peak = composed.sample_peak().at(i);
+		AudioAnalysis::PeakTime const direct_peak = direct.sample_peak().at(i);
+		BOOST_CHECK_SMALL (composed_peak.peak - direct_peak.peak, 1e-3f);
+		BOOST_CHECK_SMALL (composed_peak.time.seconds() - direct_peak.time.seconds(), 1.0 / 24);
+	}
+
+	if (composed.integrated_loudness() && direct.integrated_loudness()) {
+		BOOST_CHECK_SMALL (composed.integrated_loudness().get() - direct.integrated_loudness().get(), 1.0f);
+	}
+}
@@ -303,3 +303,25 @@ BOOST_AUTO_TEST_CASE (audio_buffers_accumulate_frames)
 		}
 	}
 }
+
+/** Check that channels are aligned and do not overlap, including in buffers which
+ *  have been recycled from the pool.
+ */
+BOOST_AUTO_TEST_CASE (audio_buffers_alignment)
+{
+	for (int i = 0; i < 4; ++i) {
+		AudioBuffers buffers (7, 1001 + i);
+		for (int j = 0; j < buffers.channels(); ++j) {
+			BOOST_CHECK_EQUAL (reinterpret_cast<uintptr_t> (buffers.data(j)) % 64, 0);
+			for (int k = 0; k < buffers.frames(); ++k) {
+				buffers.data(j)[k] = j;
+			}
+		}
+
+		for (int j = 0; j < buffers.channels(); ++j) {
+			for (int k = 0; k < buffers.frames(); ++k) {
+				BOOST_REQUIRE_EQUAL (buffers.data(j)[k], j);
+			}
+		}
+	}
+}
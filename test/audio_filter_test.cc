@@ -26,7 +26,10 @@
 #include <boost/test/unit_test.hpp>
 #include "lib/audio_filter.h"
 #include "lib/audio_buffers.h"
+#include <boost/foreach.hpp>
+#include <cmath>
 
+using std::vector;
 using boost::shared_ptr;
 
 static void
@@ -105,3 +108,43 @@ BOOST_AUTO_TEST_CASE (audio_filter_impulse_input_test)
 		}
 	}
 }
+
+/** Check that the FFT implementation gives the same results as direct convolution */
+BOOST_AUTO_TEST_CASE (audio_filter_fft_test)
+{
+	int const channels = 6;
+	int const block_size = 1920;
+	int const num_blocks = 250;
+
+	BandPassAudioFilter direct (0.01, 150.0 / 48000, 1900.0 / 48000);
+	BandPassAudioFilter fft (0.01, 150.0 / 48000, 1900.0 / 48000);
+	fft.set_use_fft (true);
+
+	vector<shared_ptr<AudioBuffers> > input;
+	srand (1);
+	for (int i = 0; i < num_blocks; ++i) {
+		/* Vary the block size a little so that blocks do not line up with the FFT size */
+		shared_ptr<AudioBuffers> in (new AudioBuffers (channels, block_size + (i % 7) * 13));
+		for (int j = 0; j < channels; ++j) {
+			for (int k = 0; k < in->frames(); ++k) {
+				in->data(j)[k] = (float (rand ()) / RAND_MAX) * 2 - 1;
+			}
+		}
+		input.push_back (in);
+	}
+
+	vector<shared_ptr<AudioBuffers> > direct_out;
+	vector<shared_ptr<AudioBuffers> > fft_out;
+	BOOST_FOREACH (shared_ptr<AudioBuffers> i, input) {
+		direct_out.push_back (direct.run (i));
+		fft_out.push_back (fft.run (i));
+	}
+
+	for (size_t i = 0; i < input.size(); ++i) {
+		for (int j = 0; j < channels; ++j) {
+			for (int k = 0; k < input[i]->frames(); ++k) {
+				BOOST_REQUIRE (fabs (direct_out[i]->data(j)[k] - fft_out[i]->data(j)[k]) < 1e-5);
+			}
+		}
+	}
+}
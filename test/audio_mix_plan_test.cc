@@ -0,0 +1,71 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/audio_mix_plan_test.cc
+ *  @brief Test AudioMixPlan.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/audio_mix_plan.h"
+#include "lib/audio_mapping.h"
+#include "lib/audio_buffers.h"
+#include <boost/test/unit_test.hpp>
+
+using boost::shared_ptr;
+
+/** Check an AudioMixPlan against a straightforward mix of every input into every output */
+BOOST_AUTO_TEST_CASE (audio_mix_plan_test)
+{
+	int const inputs = 32;
+	int const outputs = 16;
+
+	AudioMapping mapping (inputs, outputs);
+	srand (1);
+	for (int i = 0; i < inputs; ++i) {
+		for (int j = 0; j < outputs; ++j) {
+			/* Leave most of the map empty, and one output completely unmapped */
+			if (j != 7 && (rand() % 4) == 0) {
+				mapping.set (i, j, float (rand ()) / RAND_MAX);
+			}
+		}
+	}
+
+	/* Long enough for more than one block, with a partial block at the end */
+	shared_ptr<AudioBuffers> in (new AudioBuffers (inputs, 9133));
+	for (int i = 0; i < inputs; ++i) {
+		for (int j = 0; j < in->frames(); ++j) {
+			in->data(i)[j] = (float (rand ()) / RAND_MAX) * 2 - 1;
+		}
+	}
+
+	shared_ptr<AudioBuffers> out = AudioMixPlan(mapping, outputs).run (in);
+	BOOST_REQUIRE_EQUAL (out->channels(), outputs);
+	BOOST_REQUIRE_EQUAL (out->frames(), in->frames());
+
+	for (int i = 0; i < outputs; ++i) {
+		for (int j = 0; j < in->frames(); ++j) {
+			float check = 0;
+			for (int k = 0; k < inputs; ++k) {
+				check += in->data(k)[j] * mapping.get (k, i);
+			}
+			BOOST_REQUIRE_SMALL (out->data(i)[j] - check, 1e-5f);
+		}
+	}
+}
@@ -36,6 +36,9 @@
 #include "lib/j2k_image_proxy.h"
 #include "lib/encode_server_description.h"
 #include "lib/file_log.h"
+#include "lib/dcpomatic_socket.h"
+#include "lib/exceptions.h"
+#include "lib/config.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/thread.hpp>
 
@@ -318,3 +321,143 @@ BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 	delete server_thread;
 	delete server;
 }
+
+/** Send the same frame to a server twice; the second time the server should already
+ *  have the source image in its cache so we should not send it again, and the result
+ *  should be the same.
+ */
+BOOST_AUTO_TEST_CASE (client_server_test_image_cache)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	uint8_t* p = image->data()[0];
+
+	for (int y = 0; y < 1080; ++y) {
+		uint8_t* q = p;
+		for (int x = 0; x < 1998; ++x) {
+			*q++ = x % 256;
+			*q++ = y % 256;
+			*q++ = (x + y) % 256;
+		}
+		p += image->stride()[0];
+	}
+
+	shared_ptr<FileLog> log (new FileLog ("build/test/client_server_test_image_cache.log"));
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (1998, 1080),
+			dcp::Size (1998, 1080),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion ()
+			)
+		);
+
+	shared_ptr<DCPVideo> frame (
+		new DCPVideo (
+			pvf,
+			0,
+			24,
+			200000000,
+			RESOLUTION_2K,
+			log
+			)
+		);
+
+	Data locally_encoded = frame->encode_locally (boost::bind (&Log::dcp_log, log.get(), _1, _2));
+
+	EncodeServer* server = new EncodeServer (log, true, 2);
+
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	/* "localhost" rather than "127.0.0.1" here fails on docker; go figure */
+	EncodeServerDescription description ("127.0.0.1", 2);
+	description.set_image_cache (true);
+
+	uint64_t const image_bytes = uint64_t (image->line_size()[0]) * image->size().height;
+
+	/* First time: the image must be sent */
+	do_remote_encode (frame, description, locally_encoded);
+	BOOST_CHECK (frame->bytes_sent() >= image_bytes);
+
+	/* Second time: only the request should be sent */
+	do_remote_encode (frame, description, locally_encoded);
+	BOOST_CHECK (frame->bytes_sent() < image_bytes / 100);
+
+	/* If we don't think the server has a cache we send no digest, so the image must be sent again */
+	description.set_image_cache (false);
+	do_remote_encode (frame, description, locally_encoded);
+	BOOST_CHECK (frame->bytes_sent() >= image_bytes);
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+}
+
+/** Fill a server's queue with connections that never send anything, then check that it
+ *  tells us that it is busy rather than just dropping our request.
+ */
+BOOST_AUTO_TEST_CASE (client_server_test_busy)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (64, 64), true));
+	image->make_black ();
+
+	shared_ptr<FileLog> log (new FileLog ("build/test/client_server_test_busy.log"));
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (64, 64),
+			dcp::Size (64, 64),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion ()
+			)
+		);
+
+	shared_ptr<DCPVideo> frame (new DCPVideo (pvf, 0, 24, 200000000, RESOLUTION_2K, log));
+
+	EncodeServer* server = new EncodeServer (log, true, 1);
+
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	/* With one encoding thread the server has two I/O threads, which will each take one of
+	   these connections and wait for it to send a request, and room for four more to wait.
+	*/
+	boost::asio::ip::tcp::endpoint endpoint (boost::asio::ip::address::from_string ("127.0.0.1"), ENCODE_FRAME_PORT);
+	list<shared_ptr<Socket> > idle;
+	for (int i = 0; i < 6; ++i) {
+		shared_ptr<Socket> socket (new Socket);
+		socket->connect (endpoint);
+		idle.push_back (socket);
+	}
+
+	dcpomatic_sleep (1);
+
+	BOOST_CHECK_THROW (frame->encode_remotely (EncodeServerDescription ("127.0.0.1", 1)), ServerBusyError);
+
+	/* Hang up so that the server can get on with things */
+	idle.clear ();
+	dcpomatic_sleep (1);
+
+	/* Now it should take our frame */
+	Data locally_encoded = frame->encode_locally (boost::bind (&Log::dcp_log, log.get(), _1, _2));
+	do_remote_encode (frame, EncodeServerDescription ("127.0.0.1", 1), locally_encoded);
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+}
@@ -0,0 +1,204 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/constant_frame_test.cc
+ *  @brief Test the keys which identify frames known to be constant (black or still images)
+ *  and J2KEncoder's table of encoded constant frames.
+ *  @ingroup specific
+ */
+
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/image_content.h"
+#include "lib/video_content.h"
+#include "lib/player.h"
+#include "lib/player_video.h"
+#include "lib/dcp_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/j2k_encoder.h"
+#include "lib/writer.h"
+#include "lib/transcode_job.h"
+#include "lib/ratio.h"
+#include "lib/dcp_content_type.h"
+#include "test.h"
+#include <dcp/raw_convert.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+using boost::optional;
+using dcp::Data;
+
+static void
+store (vector<shared_ptr<PlayerVideo> >* videos, shared_ptr<PlayerVideo> pv, DCPTime)
+{
+	videos->push_back (pv);
+}
+
+static shared_ptr<PlayerVideo>
+constant_frame_test_video (dcp::Size size, Eyes eyes, optional<string> constant)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, size, true));
+	image->make_black ();
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			size,
+			size,
+			eyes,
+			PART_WHOLE,
+			ColourConversion ()
+			)
+		);
+
+	if (constant) {
+		pv->set_constant (constant.get ());
+	}
+
+	return pv;
+}
+
+static shared_ptr<DCPVideo>
+constant_frame_test_dcp_video (shared_ptr<const PlayerVideo> pv, int bandwidth = 100000000, Resolution resolution = RESOLUTION_2K)
+{
+	return shared_ptr<DCPVideo> (new DCPVideo (pv, 0, 24, bandwidth, resolution, shared_ptr<Log> ()));
+}
+
+/** Black frames from the Player should all share one constant key, and the frames of a
+ *  still image should share another.
+ */
+BOOST_AUTO_TEST_CASE (constant_frame_player_test)
+{
+	shared_ptr<Film> film = new_test_film ("constant_frame_player_test");
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("FTR"));
+	film->set_container (Ratio::from_id ("185"));
+	shared_ptr<ImageContent> content (new ImageContent (film, "test/data/simple_testcard_640x480.png"));
+	film->examine_and_add_content (content);
+	wait_for_jobs ();
+
+	content->video->set_scale (VideoContentScale (Ratio::from_id ("185")));
+	content->video->set_length (3);
+	content->set_position (DCPTime::from_frames (2, film->video_frame_rate ()));
+
+	vector<shared_ptr<PlayerVideo> > videos;
+	shared_ptr<Player> player (new Player (film, film->playlist ()));
+	player->Video.connect (bind (&store, &videos, _1, _2));
+	while (!player->pass ()) {}
+
+	/* 2 frames of black then 3 of the still image */
+	BOOST_REQUIRE_EQUAL (videos.size(), 5);
+
+	vector<string> keys;
+	BOOST_FOREACH (shared_ptr<PlayerVideo> i, videos) {
+		optional<string> k = constant_frame_test_dcp_video(i)->constant_key ();
+		BOOST_REQUIRE (k);
+		keys.push_back (k.get ());
+	}
+
+	BOOST_CHECK_EQUAL (keys[0], keys[1]);
+	BOOST_CHECK_EQUAL (keys[2], keys[3]);
+	BOOST_CHECK_EQUAL (keys[3], keys[4]);
+	BOOST_CHECK (keys[0] != keys[2]);
+}
+
+/** Constant keys must differ if anything about the encode differs */
+BOOST_AUTO_TEST_CASE (constant_frame_key_test)
+{
+	dcp::Size const size (1998, 1080);
+	shared_ptr<PlayerVideo> black = constant_frame_test_video (size, EYES_BOTH, string ("black"));
+	string const key = constant_frame_test_dcp_video(black)->constant_key().get ();
+
+	/* Same input and parameters */
+	BOOST_CHECK_EQUAL (constant_frame_test_dcp_video(constant_frame_test_video(size, EYES_BOTH, string("black")))->constant_key().get(), key);
+
+	/* Different input */
+	BOOST_CHECK (constant_frame_test_dcp_video(constant_frame_test_video(size, EYES_BOTH, string("still")))->constant_key().get() != key);
+
+	/* Different size */
+	BOOST_CHECK (constant_frame_test_dcp_video(constant_frame_test_video(dcp::Size(2048, 858), EYES_BOTH, string("black")))->constant_key().get() != key);
+
+	/* Different bandwidth */
+	BOOST_CHECK (constant_frame_test_dcp_video(black, 200000000)->constant_key().get() != key);
+
+	/* Different resolution */
+	BOOST_CHECK (constant_frame_test_dcp_video(black, 100000000, RESOLUTION_4K)->constant_key().get() != key);
+
+	/* Different eyes */
+	string const left = constant_frame_test_dcp_video(constant_frame_test_video(size, EYES_LEFT, string("black")))->constant_key().get();
+	string const right = constant_frame_test_dcp_video(constant_frame_test_video(size, EYES_RIGHT, string("black")))->constant_key().get();
+	BOOST_CHECK (left != key);
+	BOOST_CHECK (right != key);
+	BOOST_CHECK (left != right);
+
+	/* No key if the input is not known to be constant */
+	BOOST_CHECK (!constant_frame_test_dcp_video(constant_frame_test_video(size, EYES_BOTH, optional<string>()))->constant_key());
+}
+
+/** J2KEncoder should hand back what it was given for a constant frame, and stop
+ *  remembering new ones once it has CONSTANT_FRAMES_MAX of them.
+ */
+BOOST_AUTO_TEST_CASE (constant_frame_table_test)
+{
+	shared_ptr<Film> film = new_test_film ("constant_frame_table_test");
+	film->set_dcp_content_type (DCPContentType::from_isdcf_name ("FTR"));
+	film->set_container (Ratio::from_id ("185"));
+	shared_ptr<ImageContent> content (new ImageContent (film, "test/data/simple_testcard_640x480.png"));
+	film->examine_and_add_content (content);
+	wait_for_jobs ();
+
+	shared_ptr<Job> job (new TranscodeJob (film));
+	shared_ptr<Writer> writer (new Writer (film, job));
+	shared_ptr<J2KEncoder> encoder (new J2KEncoder (film, writer));
+
+	dcp::Size const size (1998, 1080);
+
+	/* Frames which are not known to be constant are never remembered */
+	shared_ptr<DCPVideo> varying = constant_frame_test_dcp_video (constant_frame_test_video (size, EYES_BOTH, optional<string> ()));
+	encoder->add_constant_frame (varying, Data (16));
+	BOOST_CHECK (!encoder->constant_frame (varying));
+	BOOST_CHECK (encoder->_constant_frames.empty ());
+
+	for (int i = 0; i < CONSTANT_FRAMES_MAX + 4; ++i) {
+		shared_ptr<DCPVideo> vf = constant_frame_test_dcp_video (constant_frame_test_video (size, EYES_BOTH, dcp::raw_convert<string> (i)));
+		BOOST_CHECK (!encoder->constant_frame (vf));
+		encoder->add_constant_frame (vf, Data (i + 1));
+		optional<Data> back = encoder->constant_frame (vf);
+		if (i < CONSTANT_FRAMES_MAX) {
+			BOOST_REQUIRE (back);
+			BOOST_CHECK_EQUAL (back->size(), i + 1);
+		} else {
+			BOOST_CHECK (!back);
+		}
+	}
+
+	BOOST_CHECK_EQUAL (encoder->_constant_frames.size(), CONSTANT_FRAMES_MAX);
+
+	/* The first ones are still there */
+	optional<Data> first = encoder->constant_frame (constant_frame_test_dcp_video (constant_frame_test_video (size, EYES_BOTH, string ("0"))));
+	BOOST_REQUIRE (first);
+	BOOST_CHECK_EQUAL (first->size(), 1);
+}
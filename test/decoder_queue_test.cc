@@ -0,0 +1,218 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/decoder_queue_test.cc
+ *  @brief Test DecoderQueue class.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/decoder_queue.h"
+#include "lib/decoder.h"
+#include "lib/decoder_factory.h"
+#include "lib/film.h"
+#include "lib/ratio.h"
+#include "lib/content_factory.h"
+#include "lib/video_content.h"
+#include "lib/audio_buffers.h"
+#include "lib/exceptions.h"
+#include "lib/compose.hpp"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+
+using std::list;
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+using boost::bind;
+
+static bool
+record_video (list<string>* events, int piece, ContentVideo video)
+{
+	events->push_back (String::compose ("V %1 %2 %3", piece, video.frame, static_cast<int> (video.eyes)));
+	return true;
+}
+
+static Frame
+record_audio (list<string>* events, int piece, AudioStreamPtr, ContentAudio audio)
+{
+	events->push_back (String::compose ("A %1 %2 %3", piece, audio.frame, audio.audio->frames()));
+	return audio.audio->frames ();
+}
+
+static void
+record_text_subtitle_start (list<string>* events, int piece, ContentTextSubtitle subtitle)
+{
+	events->push_back (String::compose ("T %1 %2 %3", piece, to_string (subtitle.from()), subtitle.subs.size()));
+}
+
+static void
+record_subtitle_stop (list<string>* events, int piece, ContentTime time)
+{
+	events->push_back (String::compose ("S %1 %2", piece, to_string (time)));
+}
+
+static bool
+video_taken (ContentVideo)
+{
+	return true;
+}
+
+static Frame
+audio_accepted (AudioStreamPtr, ContentAudio audio)
+{
+	return audio.audio->frames ();
+}
+
+/** Play all of a film's content through DecoderQueues, always passing the one
+ *  whose position is earliest as Player does, and return what was emitted.
+ */
+static list<string>
+play (shared_ptr<Film> film, bool threaded)
+{
+	list<string> events;
+	vector<shared_ptr<DecoderQueue> > queues;
+
+	BOOST_FOREACH (shared_ptr<Content> i, film->content ()) {
+		int const n = queues.size ();
+		shared_ptr<DecoderQueue> q (
+			new DecoderQueue (decoder_factory (i, film->log(), false), threaded, bind (&video_taken, _1), bind (&audio_accepted, _1, _2))
+			);
+		q->Video.connect (bind (&record_video, &events, n, _1));
+		q->Audio.connect (bind (&record_audio, &events, n, _1, _2));
+		q->TextSubtitleStart.connect (bind (&record_text_subtitle_start, &events, n, _1));
+		q->SubtitleStop.connect (bind (&record_subtitle_stop, &events, n, _1));
+		queues.push_back (q);
+	}
+
+	vector<bool> done (queues.size(), false);
+
+	while (true) {
+		int earliest = -1;
+		ContentTime earliest_position;
+		for (size_t i = 0; i < queues.size(); ++i) {
+			if (done[i]) {
+				continue;
+			}
+			ContentTime const p = queues[i]->position ();
+			if (earliest == -1 || p < earliest_position) {
+				earliest = i;
+				earliest_position = p;
+			}
+		}
+
+		if (earliest == -1) {
+			break;
+		}
+
+		done[earliest] = queues[earliest]->pass ();
+	}
+
+	return events;
+}
+
+/** Check that running decoders in their own threads does not change what is emitted
+ *  from a film with separate video, audio and subtitle content, or the order in which
+ *  it comes out.
+ */
+BOOST_AUTO_TEST_CASE (decoder_queue_threaded_test)
+{
+	shared_ptr<Film> film = new_test_film ("decoder_queue_threaded_test");
+	film->set_container (Ratio::from_id ("185"));
+	shared_ptr<Content> video = content_factory(film, "test/data/flat_red.png").front ();
+	film->examine_and_add_content (video);
+	shared_ptr<Content> audio = content_factory(film, "test/data/staircase.wav").front ();
+	film->examine_and_add_content (audio);
+	shared_ptr<Content> subtitle = content_factory(film, "test/data/subrip2.srt").front ();
+	film->examine_and_add_content (subtitle);
+	BOOST_REQUIRE (!wait_for_jobs ());
+	video->video->set_length (48);
+
+	list<string> serial = play (film, false);
+	list<string> threaded = play (film, true);
+
+	BOOST_REQUIRE (!serial.empty ());
+	BOOST_CHECK_EQUAL (serial.size(), threaded.size());
+	BOOST_CHECK (serial == threaded);
+
+	/* Check that all three kinds of data were seen */
+	bool seen_video = false;
+	bool seen_audio = false;
+	bool seen_subtitle = false;
+	BOOST_FOREACH (string const & i, serial) {
+		seen_video = seen_video || i[0] == 'V';
+		seen_audio = seen_audio || i[0] == 'A';
+		seen_subtitle = seen_subtitle || i[0] == 'T';
+	}
+	BOOST_CHECK (seen_video);
+	BOOST_CHECK (seen_audio);
+	BOOST_CHECK (seen_subtitle);
+}
+
+/** A Decoder which makes no data and throws on a given pass */
+class ThrowingDecoder : public Decoder
+{
+public:
+	explicit ThrowingDecoder (int throw_on)
+		: passes (0)
+		, _throw_on (throw_on)
+	{}
+
+	bool pass ()
+	{
+		int const p = passes++;
+		if (p == _throw_on) {
+			throw DecodeError ("ThrowingDecoder");
+		}
+		return false;
+	}
+
+	ContentTime position () const
+	{
+		return ContentTime::from_frames (passes, 24);
+	}
+
+	int passes;
+
+private:
+	int _throw_on;
+};
+
+/** Check that an exception thrown by a threaded decoder comes out of the DecoderQueue's
+ *  pass() for the pass that threw, and not before.
+ */
+BOOST_AUTO_TEST_CASE (decoder_queue_exception_test)
+{
+	shared_ptr<ThrowingDecoder> decoder (new ThrowingDecoder (3));
+	DecoderQueue queue (decoder, true, bind (&video_taken, _1), bind (&audio_accepted, _1, _2));
+
+	for (int i = 0; i < 3; ++i) {
+		BOOST_CHECK (queue.position() == ContentTime::from_frames (i, 24));
+		BOOST_CHECK_NO_THROW (queue.pass ());
+	}
+
+	/* Once position() has returned the pass that threw has been made, but we should
+	   only hear about the exception when that pass is emitted.
+	*/
+	BOOST_CHECK (queue.position() == ContentTime::from_frames (3, 24));
+	BOOST_CHECK_EQUAL (decoder->passes, 4);
+	BOOST_CHECK_THROW (queue.pass (), std::runtime_error);
+}
@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/draft_test.cc
+ *  @brief Check that draft settings are kept apart from full-quality ones and survive a
+ *  round trip through the film metadata.
+ *  @ingroup specific
+ */
+
+#include "lib/film.h"
+#include "lib/image.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "test.h"
+#include <boost/test/unit_test.hpp>
+
+using std::string;
+using boost::shared_ptr;
+using boost::optional;
+
+static shared_ptr<DCPVideo>
+draft_test_frame (bool draft, bool half_resolution)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (64, 64), true));
+	image->make_black ();
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (64, 64),
+			dcp::Size (64, 64),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion ()
+			)
+		);
+
+	pv->set_constant ("black");
+
+	return shared_ptr<DCPVideo> (new DCPVideo (pv, 0, 24, 100000000, RESOLUTION_2K, shared_ptr<Log> (), draft, half_resolution));
+}
+
+/** Film::video_identifier must differ between full, draft and draft half-resolution, so that
+ *  frames from one are never picked up when resuming an encode of another.
+ */
+BOOST_AUTO_TEST_CASE (draft_video_identifier_test)
+{
+	shared_ptr<Film> film = new_test_film ("draft_video_identifier_test");
+
+	string const full = film->video_identifier ();
+	film->set_draft (true);
+	string const draft = film->video_identifier ();
+	film->set_draft_half_resolution (true);
+	string const half = film->video_identifier ();
+
+	BOOST_CHECK (full != draft);
+	BOOST_CHECK (full != half);
+	BOOST_CHECK (draft != half);
+
+	/* Half-resolution means nothing without draft */
+	film->set_draft (false);
+	BOOST_CHECK_EQUAL (film->video_identifier(), full);
+}
+
+/** DCPVideo's digest (used by the J2K frame cache) and constant key (used by J2KEncoder's
+ *  table of constant frames) must differ between full, draft and draft half-resolution.
+ */
+BOOST_AUTO_TEST_CASE (draft_digest_test)
+{
+	shared_ptr<DCPVideo> full = draft_test_frame (false, false);
+	shared_ptr<DCPVideo> draft = draft_test_frame (true, false);
+	shared_ptr<DCPVideo> half = draft_test_frame (true, true);
+
+	BOOST_CHECK (full->digest() != draft->digest());
+	BOOST_CHECK (full->digest() != half->digest());
+	BOOST_CHECK (draft->digest() != half->digest());
+
+	BOOST_REQUIRE (full->constant_key());
+	BOOST_REQUIRE (draft->constant_key());
+	BOOST_REQUIRE (half->constant_key());
+
+	BOOST_CHECK (full->constant_key().get() != draft->constant_key().get());
+	BOOST_CHECK (full->constant_key().get() != half->constant_key().get());
+	BOOST_CHECK (draft->constant_key().get() != half->constant_key().get());
+
+	/* ...but the same settings must give the same answers */
+	BOOST_CHECK_EQUAL (half->digest(), draft_test_frame(true, true)->digest());
+	BOOST_CHECK_EQUAL (half->constant_key().get(), draft_test_frame(true, true)->constant_key().get());
+}
+
+/** <Draft> and <DraftHalfResolution> must survive a write and read of the film metadata */
+BOOST_AUTO_TEST_CASE (draft_metadata_test)
+{
+	shared_ptr<Film> film = new_test_film ("draft_metadata_test");
+	boost::filesystem::path dir = test_film_dir ("draft_metadata_test");
+
+	film->set_draft (true);
+	film->set_draft_half_resolution (true);
+	film->write_metadata ();
+
+	shared_ptr<Film> g (new Film (dir));
+	g->read_metadata ();
+	BOOST_CHECK (g->draft ());
+	BOOST_CHECK (g->draft_half_resolution ());
+
+	g->set_draft_half_resolution (false);
+	g->write_metadata ();
+
+	shared_ptr<Film> h (new Film (dir));
+	h->read_metadata ();
+	BOOST_CHECK (h->draft ());
+	BOOST_CHECK (!h->draft_half_resolution ());
+
+	h->set_draft (false);
+	h->write_metadata ();
+
+	shared_ptr<Film> i (new Film (dir));
+	i->read_metadata ();
+	BOOST_CHECK (!i->draft ());
+	BOOST_CHECK (!i->draft_half_resolution ());
+}
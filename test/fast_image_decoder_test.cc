@@ -0,0 +1,268 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/fast_image_decoder_test.cc
+ *  @brief Test FastImageDecoder class with some DPX and TIFF data made up in memory.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/fast_image_decoder.h"
+#include "lib/image.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <cstring>
+
+using std::vector;
+using boost::shared_ptr;
+
+static void
+put_16 (vector<uint8_t>& data, size_t offset, uint16_t v, bool big_endian)
+{
+	if (big_endian) {
+		data[offset] = v >> 8;
+		data[offset + 1] = v & 0xff;
+	} else {
+		data[offset] = v & 0xff;
+		data[offset + 1] = v >> 8;
+	}
+}
+
+static void
+put_32 (vector<uint8_t>& data, size_t offset, uint32_t v, bool big_endian)
+{
+	if (big_endian) {
+		put_16 (data, offset, v >> 16, true);
+		put_16 (data, offset + 2, v & 0xffff, true);
+	} else {
+		put_16 (data, offset, v & 0xffff, false);
+		put_16 (data, offset + 2, v >> 16, false);
+	}
+}
+
+static uint16_t
+pixel (shared_ptr<Image> image, int x, int y, int c)
+{
+	return reinterpret_cast<uint16_t*> (image->data()[0] + y * image->stride()[0])[x * 3 + c];
+}
+
+static vector<uint8_t>
+dpx_header (int width, int height, int bit_depth, int packing, bool big_endian)
+{
+	vector<uint8_t> data (2048, 0);
+	memcpy (&data[0], big_endian ? "SDPX" : "XPDS", 4);
+	put_32 (data, 4, 2048, big_endian);
+	put_16 (data, 770, 1, big_endian);
+	put_32 (data, 772, width, big_endian);
+	put_32 (data, 776, height, big_endian);
+	data[800] = 50;
+	/* Linear */
+	data[801] = 2;
+	data[803] = bit_depth;
+	put_16 (data, 804, packing, big_endian);
+	put_32 (data, 808, 2048, big_endian);
+	return data;
+}
+
+BOOST_AUTO_TEST_CASE (fast_image_decoder_dpx_10_test)
+{
+	int const width = 5;
+	int const height = 3;
+	vector<uint8_t> data = dpx_header (width, height, 10, 1, true);
+	data.resize (2048 + width * height * 4);
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint32_t const r = (x * 100 + y) & 0x3ff;
+			uint32_t const g = 1023 - r;
+			uint32_t const b = (x * 7 + y * 300) & 0x3ff;
+			put_32 (data, 2048 + (y * width + x) * 4, (r << 22) | (g << 12) | (b << 2), true);
+		}
+	}
+
+	FastImageDecoder decoder (&data[0], data.size());
+	BOOST_REQUIRE (decoder.ok ());
+	BOOST_CHECK (decoder.size().get() == dcp::Size (width, height));
+
+	shared_ptr<Image> image = decoder.decode ();
+	BOOST_REQUIRE (image);
+	BOOST_CHECK_EQUAL (image->pixel_format(), AV_PIX_FMT_RGB48LE);
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint32_t const r = (x * 100 + y) & 0x3ff;
+			BOOST_CHECK_EQUAL (pixel (image, x, y, 0), (r << 6) | (r >> 4));
+			BOOST_CHECK_EQUAL (pixel (image, x, y, 1) >> 6, 1023 - r);
+			BOOST_CHECK_EQUAL (pixel (image, x, y, 2) >> 6, (x * 7 + y * 300) & 0x3ff);
+		}
+	}
+
+	/* 10-bit max should become 16-bit max */
+	put_32 (data, 2048, 0xffffffff, true);
+	image = FastImageDecoder (&data[0], data.size()).decode ();
+	BOOST_CHECK_EQUAL (pixel (image, 0, 0, 0), 0xffff);
+}
+
+BOOST_AUTO_TEST_CASE (fast_image_decoder_dpx_16_test)
+{
+	int const width = 4;
+	int const height = 2;
+	vector<uint8_t> data = dpx_header (width, height, 16, 0, false);
+	data.resize (2048 + width * height * 6);
+
+	for (int i = 0; i < width * height * 3; ++i) {
+		put_16 (data, 2048 + i * 2, i * 1000, false);
+	}
+
+	shared_ptr<Image> image = FastImageDecoder (&data[0], data.size()).decode ();
+	BOOST_REQUIRE (image);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				BOOST_CHECK_EQUAL (pixel (image, x, y, c), uint16_t (((y * width + x) * 3 + c) * 1000));
+			}
+		}
+	}
+
+	/* Truncated data is left to ImageMagick */
+	data.resize (data.size() - 1);
+	BOOST_CHECK (!FastImageDecoder (&data[0], data.size()).ok ());
+}
+
+/** DPXs whose transfer characteristic is printing density or logarithmic must be left to
+ *  MagickImageProxy, which treats them specially; others can be decoded here.
+ */
+BOOST_AUTO_TEST_CASE (fast_image_decoder_dpx_transfer_test)
+{
+	int const width = 4;
+	int const height = 2;
+	vector<uint8_t> data = dpx_header (width, height, 16, 0, true);
+	data.resize (2048 + width * height * 6);
+
+	/* User-defined, linear, unspecified video */
+	data[801] = 0;
+	BOOST_CHECK (FastImageDecoder (&data[0], data.size()).ok ());
+	data[801] = 2;
+	BOOST_CHECK (FastImageDecoder (&data[0], data.size()).ok ());
+	data[801] = 4;
+	BOOST_CHECK (FastImageDecoder (&data[0], data.size()).ok ());
+
+	/* Printing density */
+	data[801] = 1;
+	BOOST_CHECK (!FastImageDecoder (&data[0], data.size()).ok ());
+
+	/* Logarithmic */
+	data[801] = 3;
+	BOOST_CHECK (!FastImageDecoder (&data[0], data.size()).ok ());
+}
+
+/** Make a TIFF with 8 IFD entries; the image data is in strips of rows_per_strip
+ *  rows directly after the strip offset array.
+ */
+static vector<uint8_t>
+tiff (int width, int height, int bits, int rows_per_strip, int compression, bool big_endian)
+{
+	int const entries = 8;
+	int const strips = (height + rows_per_strip - 1) / rows_per_strip;
+	size_t const offsets = 8 + 2 + entries * 12 + 4;
+	size_t const bits_array = offsets + strips * 4;
+	size_t const image_data = bits_array + 6;
+	int const stride = width * 3 * bits / 8;
+
+	vector<uint8_t> data (image_data + stride * height, 0);
+	memcpy (&data[0], big_endian ? "MM\0*" : "II*\0", 4);
+	put_32 (data, 4, 8, big_endian);
+	put_16 (data, 8, entries, big_endian);
+
+	uint16_t const tags[entries] = { 256, 257, 258, 259, 262, 273, 277, 278 };
+	uint16_t const types[entries] = { 3, 3, 3, 3, 3, 4, 3, 3 };
+	uint32_t const counts[entries] = { 1, 1, 3, 1, 1, uint32_t (strips), 1, 1 };
+	uint32_t const values[entries] = { uint32_t (width), uint32_t (height), uint32_t (bits_array), uint32_t (compression), 2, uint32_t (strips == 1 ? image_data : offsets), 3, uint32_t (rows_per_strip) };
+
+	for (int i = 0; i < entries; ++i) {
+		size_t const e = 10 + i * 12;
+		put_16 (data, e, tags[i], big_endian);
+		put_16 (data, e + 2, types[i], big_endian);
+		put_32 (data, e + 4, counts[i], big_endian);
+		if (types[i] == 3 && counts[i] == 1) {
+			put_16 (data, e + 8, values[i], big_endian);
+		} else {
+			put_32 (data, e + 8, values[i], big_endian);
+		}
+	}
+
+	for (int i = 0; i < strips; ++i) {
+		put_32 (data, offsets + i * 4, image_data + i * rows_per_strip * stride, big_endian);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		put_16 (data, bits_array + i * 2, bits, big_endian);
+	}
+
+	return data;
+}
+
+BOOST_AUTO_TEST_CASE (fast_image_decoder_tiff_test)
+{
+	int const width = 7;
+	int const height = 5;
+
+	/* 8-bit, little-endian, several strips */
+	vector<uint8_t> data = tiff (width, height, 8, 2, 1, false);
+	size_t const start = data.size() - width * height * 3;
+	for (int i = 0; i < width * height * 3; ++i) {
+		data[start + i] = i;
+	}
+
+	FastImageDecoder decoder (&data[0], data.size());
+	BOOST_REQUIRE (decoder.ok ());
+	shared_ptr<Image> image = decoder.decode ();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				int const v = (y * width + x) * 3 + c;
+				BOOST_CHECK_EQUAL (pixel (image, x, y, c), (v << 8) | v);
+			}
+		}
+	}
+
+	/* 16-bit, big-endian, one strip */
+	data = tiff (width, height, 16, height, 1, true);
+	size_t const start16 = data.size() - width * height * 6;
+	for (int i = 0; i < width * height * 3; ++i) {
+		put_16 (data, start16 + i * 2, i * 601, true);
+	}
+
+	image = FastImageDecoder (&data[0], data.size()).decode ();
+	BOOST_REQUIRE (image);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				BOOST_CHECK_EQUAL (pixel (image, x, y, c), uint16_t (((y * width + x) * 3 + c) * 601));
+			}
+		}
+	}
+
+	/* Compressed TIFFs are not handled, but we can still get their size */
+	data = tiff (width, height, 8, height, 5, false);
+	FastImageDecoder compressed (&data[0], data.size());
+	BOOST_CHECK (!compressed.ok ());
+	BOOST_CHECK (compressed.size().get() == dcp::Size (width, height));
+	BOOST_CHECK (!compressed.decode ());
+}
@@ -110,3 +110,78 @@ BOOST_AUTO_TEST_CASE (file_group_test)
 	BOOST_CHECK_EQUAL (fg.read (test, 256), 256);
 	BOOST_CHECK_EQUAL (memcmp (data + total_length - 1077, test, 256), 0);
 }
+
+/** Check that reads and seeks give the right data when the FileGroup's buffer
+ *  is smaller than the files, and that the I/O counters are updated.
+ */
+BOOST_AUTO_TEST_CASE (file_group_buffer_test)
+{
+	int const total_length = 65536;
+	uint8_t data[total_length];
+	for (int i = 0; i < total_length; ++i) {
+		data[i] = rand() & 0xff;
+	}
+
+	vector<boost::filesystem::path> name;
+	boost::filesystem::create_directories ("build/test/file_group_buffer_test");
+	name.push_back ("build/test/file_group_buffer_test/A");
+	name.push_back ("build/test/file_group_buffer_test/B");
+
+	FILE* f = fopen (name[0].string().c_str(), "wb");
+	fwrite (data, 1, 40000, f);
+	fclose (f);
+	f = fopen (name[1].string().c_str(), "wb");
+	fwrite (data + 40000, 1, total_length - 40000, f);
+	fclose (f);
+
+	FileGroup fg (name);
+	fg.set_buffer_size (1000);
+	BOOST_CHECK_EQUAL (fg.length(), total_length);
+
+	uint8_t test[total_length];
+
+	/* Lots of small reads which span buffer refills and the file boundary */
+	int pos = 0;
+	fg.seek (39000, SEEK_SET);
+	pos = 39000;
+	for (int i = 0; i < 100; ++i) {
+		BOOST_REQUIRE_EQUAL (fg.read (test, 37), 37);
+		BOOST_REQUIRE_EQUAL (memcmp (data + pos, test, 37), 0);
+		pos += 37;
+	}
+
+	/* Seek backwards within the buffered data */
+	BOOST_CHECK_EQUAL (fg.seek (-20, SEEK_CUR), pos - 20);
+	pos -= 20;
+	BOOST_CHECK_EQUAL (fg.read (test, 10), 10);
+	BOOST_CHECK_EQUAL (memcmp (data + pos, test, 10), 0);
+	pos += 10;
+
+	/* A read bigger than the buffer */
+	BOOST_CHECK_EQUAL (fg.read (test, 5000), 5000);
+	BOOST_CHECK_EQUAL (memcmp (data + pos, test, 5000), 0);
+
+	/* Random access */
+	for (int i = 0; i < 200; ++i) {
+		int const p = rand() % (total_length - 300);
+		BOOST_REQUIRE_EQUAL (fg.seek (p, SEEK_SET), p);
+		BOOST_REQUIRE_EQUAL (fg.read (test, 300), 300);
+		BOOST_REQUIRE_EQUAL (memcmp (data + p, test, 300), 0);
+	}
+
+	BOOST_CHECK (fg.bytes_read() > 0);
+	BOOST_CHECK (fg.read_time() >= 0);
+
+	/* A read bigger than the buffer which crosses the file boundary, then a seek
+	   to just after the end of where it would have been if it had all come from
+	   the second file.
+	*/
+	FileGroup fg2 (name);
+	fg2.set_buffer_size (1000);
+	BOOST_REQUIRE_EQUAL (fg2.seek (39000, SEEK_SET), 39000);
+	BOOST_REQUIRE_EQUAL (fg2.read (test, 2000), 2000);
+	BOOST_REQUIRE_EQUAL (memcmp (data + 39000, test, 2000), 0);
+	BOOST_REQUIRE_EQUAL (fg2.seek (42000, SEEK_SET), 42000);
+	BOOST_REQUIRE_EQUAL (fg2.read (test, 100), 100);
+	BOOST_CHECK_EQUAL (memcmp (data + 42000, test, 100), 0);
+}
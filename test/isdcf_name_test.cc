@@ -171,4 +171,10 @@ BOOST_AUTO_TEST_CASE (isdcf_name_test)
 	mapping.set (0, dcp::VI, 1.0);
 	sound->audio->set_mapping (mapping);
 	BOOST_CHECK_EQUAL (film->isdcf_name(false), "LikeShouting_XSN-2_F-133_DE-fr_US-R_71_4K_DI_20140704_PP_SMPTE_OV");
+
+	/* Draft DCPs */
+	film->set_draft (true);
+	BOOST_CHECK_EQUAL (film->isdcf_name(false), "LikeShouting_XSN-2-Draft_F-133_DE-fr_US-R_71_4K_DI_20140704_PP_SMPTE_OV");
+	film->set_use_isdcf_name (false);
+	BOOST_CHECK_EQUAL (film->dcp_name(false), "LIKESHOUTING_Draft");
 }
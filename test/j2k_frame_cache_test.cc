@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/j2k_frame_cache_test.cc
+ *  @brief Test J2KFrameCache.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/j2k_frame_cache.h"
+#include "lib/digester.h"
+#include <boost/test/unit_test.hpp>
+
+using std::string;
+using boost::optional;
+using dcp::Data;
+
+static string
+digest (int n)
+{
+	Digester d;
+	d.add (n);
+	return d.get ();
+}
+
+static Data
+frame (int n)
+{
+	Data d (100);
+	memset (d.data().get(), n, d.size());
+	return d;
+}
+
+static bool
+same (Data a, Data b)
+{
+	return a.size() == b.size() && memcmp (a.data().get(), b.data().get(), a.size()) == 0;
+}
+
+/** Check that frames come back out of the cache as they went in, that the least-recently-used
+ *  are evicted when the cache gets too big, and that the cache is found again by a new J2KFrameCache.
+ */
+BOOST_AUTO_TEST_CASE (j2k_frame_cache_test)
+{
+	boost::filesystem::path const dir = "build/test/j2k_frame_cache_test";
+	boost::filesystem::remove_all (dir);
+
+	{
+		J2KFrameCache cache (dir, 1000);
+		BOOST_CHECK_EQUAL (cache.size(), 0);
+		BOOST_CHECK (!cache.get (digest (0)));
+
+		for (int i = 0; i < 10; ++i) {
+			cache.put (digest (i), frame (i));
+		}
+		BOOST_CHECK_EQUAL (cache.size(), 1000);
+
+		/* Putting the same thing again should not change anything */
+		cache.put (digest (3), frame (3));
+		BOOST_CHECK_EQUAL (cache.size(), 1000);
+
+		for (int i = 0; i < 10; ++i) {
+			optional<Data> d = cache.get (digest (i));
+			BOOST_REQUIRE (d);
+			BOOST_CHECK (same (*d, frame (i)));
+		}
+
+		/* Use 0 so that 1 is the oldest, then overflow the cache */
+		cache.get (digest (0));
+		cache.put (digest (10), frame (10));
+
+		/* That should have evicted 1 and 2 to get down to 900 bytes */
+		BOOST_CHECK_EQUAL (cache.size(), 900);
+		BOOST_CHECK (cache.get (digest (0)));
+		BOOST_CHECK (!cache.get (digest (1)));
+		BOOST_CHECK (!cache.get (digest (2)));
+		BOOST_CHECK (cache.get (digest (3)));
+		BOOST_CHECK (cache.get (digest (10)));
+	}
+
+	J2KFrameCache cache (dir, 1000);
+	BOOST_CHECK_EQUAL (cache.size(), 900);
+	optional<Data> d = cache.get (digest (10));
+	BOOST_REQUIRE (d);
+	BOOST_CHECK (same (*d, frame (10)));
+	BOOST_CHECK (!cache.get (digest (1)));
+}
@@ -0,0 +1,149 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/rgb_to_xyz_test.cc
+ *  @brief Test RGBToXYZ.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/rgb_to_xyz.h"
+#include "lib/image.h"
+#include "lib/colour_conversion.h"
+#include <dcp/rgb_xyz.h>
+#include <dcp/openjpeg_image.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+
+static void
+note (dcp::NoteType, string)
+{
+
+}
+
+/** Check that RGBToXYZ gives exactly the same answers as dcp::rgb_to_xyz for all our presets */
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_test)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, dcp::Size (640, 480), true));
+
+	uint32_t noise = 42;
+	for (int y = 0; y < 480; ++y) {
+		uint16_t* p = reinterpret_cast<uint16_t*> (image->data()[0] + y * image->stride()[0]);
+		for (int x = 0; x < 640 * 3; ++x) {
+			noise = noise * 1103515245 + 12345;
+			*p++ = noise >> 16;
+		}
+	}
+
+	BOOST_FOREACH (PresetColourConversion const & i, PresetColourConversion::all ()) {
+		shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (
+			image->data()[0], image->size(), image->stride()[0], i.conversion, boost::optional<dcp::NoteHandler> ()
+			);
+
+		shared_ptr<dcp::OpenJPEGImage> check = RGBToXYZ::get(i.conversion)->convert (image, boost::bind (&note, _1, _2));
+
+		/* Ask again to make sure the cached tables are OK */
+		shared_ptr<dcp::OpenJPEGImage> check2 = RGBToXYZ::get(i.conversion)->convert (image, boost::bind (&note, _1, _2));
+
+		for (int c = 0; c < 3; ++c) {
+			BOOST_REQUIRE_EQUAL (memcmp (ref->data(c), check->data(c), 640 * 480 * sizeof (int)), 0);
+			BOOST_REQUIRE_EQUAL (memcmp (ref->data(c), check2->data(c), 640 * 480 * sizeof (int)), 0);
+		}
+	}
+}
+
+/** Check that RGBToXYZ gives the same answers as dcp::rgb_to_xyz when it splits images into bands
+ *  and gives them to a pool of threads, including when the height is not a multiple of the number
+ *  of bands and when there are more bands than rows.
+ */
+BOOST_AUTO_TEST_CASE (rgb_to_xyz_threads_test)
+{
+	boost::asio::io_service service;
+	boost::shared_ptr<boost::asio::io_service::work> work (new boost::asio::io_service::work (service));
+	boost::thread_group pool;
+	for (int i = 0; i < 3; ++i) {
+		pool.create_thread (boost::bind (&boost::asio::io_service::run, &service));
+	}
+
+	ColourConversion const conversion = PresetColourConversion::all().front().conversion;
+
+	vector<int> heights;
+	heights.push_back (480);
+	heights.push_back (481);
+	heights.push_back (127);
+	heights.push_back (5);
+
+	vector<int> threads;
+	threads.push_back (2);
+	threads.push_back (3);
+	threads.push_back (7);
+
+	uint32_t noise = 42;
+
+	BOOST_FOREACH (int height, heights) {
+		shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, dcp::Size (640, height), true));
+
+		for (int y = 0; y < height; ++y) {
+			uint16_t* p = reinterpret_cast<uint16_t*> (image->data()[0] + y * image->stride()[0]);
+			for (int x = 0; x < 640 * 3; ++x) {
+				noise = noise * 1103515245 + 12345;
+				*p++ = noise >> 16;
+			}
+		}
+
+		shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (
+			image->data()[0], image->size(), image->stride()[0], conversion, boost::optional<dcp::NoteHandler> ()
+			);
+
+		BOOST_FOREACH (int t, threads) {
+			shared_ptr<dcp::OpenJPEGImage> check = RGBToXYZ::get(conversion)->convert (image, boost::bind (&note, _1, _2), t, &service);
+			/* Without a pool everything should be done in this thread */
+			shared_ptr<dcp::OpenJPEGImage> check2 = RGBToXYZ::get(conversion)->convert (image, boost::bind (&note, _1, _2), t);
+
+			for (int c = 0; c < 3; ++c) {
+				BOOST_REQUIRE_EQUAL (memcmp (ref->data(c), check->data(c), 640 * height * sizeof (int)), 0);
+				BOOST_REQUIRE_EQUAL (memcmp (ref->data(c), check2->data(c), 640 * height * sizeof (int)), 0);
+			}
+		}
+	}
+
+	/* A pool with no threads: the caller must do all the bands itself rather than wait forever */
+	boost::asio::io_service empty_service;
+	boost::asio::io_service::work empty_work (empty_service);
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, dcp::Size (640, 100), true));
+	image->make_black ();
+	shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (
+		image->data()[0], image->size(), image->stride()[0], conversion, boost::optional<dcp::NoteHandler> ()
+		);
+	shared_ptr<dcp::OpenJPEGImage> check = RGBToXYZ::get(conversion)->convert (image, boost::bind (&note, _1, _2), 4, &empty_service);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE_EQUAL (memcmp (ref->data(c), check->data(c), 640 * 100 * sizeof (int)), 0);
+	}
+
+	work.reset ();
+	pool.join_all ();
+	service.stop ();
+}
@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2017 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/video_scopes_test.cc
+ *  @brief Test VideoScopeData.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/video_scopes.h"
+#include <dcp/openjpeg_image.h>
+#include <boost/test/unit_test.hpp>
+
+using std::min;
+using std::max;
+using std::vector;
+using boost::shared_ptr;
+
+/** Check VideoScopeData against a straightforward column-by-column analysis */
+BOOST_AUTO_TEST_CASE (video_scopes_test)
+{
+	/* Width not a multiple of 4 so that the end of each row is handled specially */
+	dcp::Size const size (203, 77);
+	shared_ptr<dcp::OpenJPEGImage> image (new dcp::OpenJPEGImage (size));
+
+	srand (1);
+	for (int c = 0; c < 3; ++c) {
+		int* p = image->data (c);
+		for (int i = 0; i < size.width * size.height; ++i) {
+			/* Include some values outside the valid range */
+			p[i] = rand() % (VIDEO_SCOPES_VALUES + 64) - 32;
+		}
+	}
+
+	dcp::Size const waveform_size (150, 91);
+	VideoScopeData data (image, waveform_size);
+	BOOST_REQUIRE (data.waveform_size() == waveform_size);
+
+	vector<uint32_t> waveform (waveform_size.width * waveform_size.height);
+	vector<uint32_t> histogram (VIDEO_SCOPES_VALUES);
+	vector<uint32_t> vectorscope (VIDEO_SCOPES_VECTORSCOPE_SIZE * VIDEO_SCOPES_VECTORSCOPE_SIZE);
+
+	for (int c = 0; c < 3; ++c) {
+		std::fill (waveform.begin(), waveform.end(), 0);
+		std::fill (histogram.begin(), histogram.end(), 0);
+
+		for (int x = 0; x < size.width; ++x) {
+			int const column = x * waveform_size.width / size.width;
+			for (int y = 0; y < size.height; ++y) {
+				int const v = min (VIDEO_SCOPES_VALUES - 1, max (0, image->data(c)[y * size.width + x]));
+				++waveform[(v * waveform_size.height / VIDEO_SCOPES_VALUES) * waveform_size.width + column];
+				++histogram[v];
+			}
+		}
+
+		for (int x = 0; x < waveform_size.width; ++x) {
+			for (int y = 0; y < waveform_size.height; ++y) {
+				BOOST_REQUIRE_EQUAL (data.waveform (c, x, y), waveform[y * waveform_size.width + x]);
+			}
+		}
+
+		for (int i = 0; i < VIDEO_SCOPES_VALUES; ++i) {
+			BOOST_REQUIRE_EQUAL (data.histogram (c, i), histogram[i]);
+		}
+	}
+
+	for (int i = 0; i < size.width * size.height; ++i) {
+		int v[3];
+		for (int c = 0; c < 3; ++c) {
+			v[c] = min (VIDEO_SCOPES_VALUES - 1, max (0, image->data(c)[i]));
+		}
+		int const u = (v[0] - v[1] + VIDEO_SCOPES_VALUES) * VIDEO_SCOPES_VECTORSCOPE_SIZE / (VIDEO_SCOPES_VALUES * 2);
+		int const w = (v[2] - v[1] + VIDEO_SCOPES_VALUES) * VIDEO_SCOPES_VECTORSCOPE_SIZE / (VIDEO_SCOPES_VALUES * 2);
+		++vectorscope[w * VIDEO_SCOPES_VECTORSCOPE_SIZE + u];
+	}
+
+	for (int u = 0; u < VIDEO_SCOPES_VECTORSCOPE_SIZE; ++u) {
+		for (int w = 0; w < VIDEO_SCOPES_VECTORSCOPE_SIZE; ++w) {
+			BOOST_REQUIRE_EQUAL (data.vectorscope (u, w), vectorscope[w * VIDEO_SCOPES_VECTORSCOPE_SIZE + u]);
+		}
+	}
+}